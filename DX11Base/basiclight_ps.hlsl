@@ -1,9 +1,9 @@
 
 Texture2D g_Texture : register( t0 );
-Texture2D g_ShadowMap : register(t1);
 
 SamplerState g_SamplerState : register( s0 );
-SamplerState g_ShadowMapSamler : register(s1);
+
+#include "shadow.hlsli"
 
 struct LIGHT
 {
@@ -45,7 +45,8 @@ struct PixelOut
 PixelOut main(	in float2 inTexCoord	            : TEXCOORD0,
 				in float4 inDiffuse	                : COLOR0,
 				in float4 inPosition	            : SV_POSITION,
-                in float4 outPositionInversePortal  : POSITION0)
+                in float4 outPositionInversePortal  : POSITION0,
+                in float4 inWorldPosition           : TEXCOORD1)
 {
     // portal clipping
     if(outPositionInversePortal.z < 0)
@@ -56,5 +57,6 @@ PixelOut main(	in float2 inTexCoord	            : TEXCOORD0,
     
     pixel.color = g_Texture.Sample(g_SamplerState, inTexCoord);
     pixel.color *= inDiffuse;
+    pixel.color.rgb *= lerp(SHADOW_DARKNESS, 1, ShadowFactor(inWorldPosition));
     return pixel;
 }
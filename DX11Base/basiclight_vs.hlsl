@@ -37,7 +37,8 @@ void main(in float4 inPosition                  : POSITION0,
 			out float2 outTexCoord              : TEXCOORD0,
 			out float4 outDiffuse               : COLOR0,
 			out float4 outPosition              : SV_POSITION,
-            out float4 outPositionInversePortal : POSITION0)
+            out float4 outPositionInversePortal : POSITION0,
+            out float4 outWorldPosition         : TEXCOORD1)
 {
 	matrix wvp;
 	wvp = mul(World, View);
@@ -55,6 +56,9 @@ void main(in float4 inPosition                  : POSITION0,
         outPositionInversePortal = float4(0, 0, 1, 0);
     }
     
+    // the pixel shader picks the shadow cascade from it
+    outWorldPosition = mul(inPosition, World);
+
     // other stuff
 	outTexCoord = inTexCoord;
     outDiffuse = inDiffuse;
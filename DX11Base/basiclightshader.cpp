@@ -64,6 +64,7 @@ void BasicLightShader::Init()
 			buffer,
 			fsize,
 			&m_vertexLayout);
+		CreatePackedVertexLayout(buffer, fsize);
 
 		delete[] buffer;
 	}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "shader.h"
+#include "shadowcache.h"
 
 
 class BasicLightShader : public Shader
@@ -17,14 +18,21 @@ public:
 		deviceContext->IASetInputLayout(m_vertexLayout);
 		
 		// set constant buffers
-		deviceContext->VSSetConstantBuffers(0, 1, &m_worldBuffer);
-		deviceContext->VSSetConstantBuffers(1, 1, &m_viewBuffer);
-		deviceContext->VSSetConstantBuffers(2, 1, &m_projectionBuffer);
-		deviceContext->VSSetConstantBuffers(3, 1, &m_portalBuffer);
-
-		deviceContext->PSSetConstantBuffers(0, 1, &m_lightBuffer);
-		deviceContext->PSSetConstantBuffers(1, 1, &m_materialBuffer);
-		deviceContext->PSSetConstantBuffers(2, 1, &m_cameraPosBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 0, m_worldBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 1, m_viewBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 2, m_projectionBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 3, m_portalBuffer);
+
+		ConstantRing::Bind(ShaderStage::Pixel, 0, m_lightBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 1, m_materialBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 2, m_cameraPosBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 3, ShadowCache::GetConstantBuffer());
+
+		// shadow map of the directional light
+		ID3D11ShaderResourceView* shadowMap = ShadowCache::GetShadowMap();
+		ID3D11SamplerState* shadowSampler = ShadowCache::GetSampler();
+		deviceContext->PSSetShaderResources(1, 1, &shadowMap);
+		deviceContext->PSSetSamplers(1, 1, &shadowSampler);
 	}
 
 	void SetPortalInverseWorldMatrix(bool enableClip, dx::XMMATRIX *inverseWorld = nullptr)
@@ -38,54 +46,54 @@ public:
 
 		buffer.enableClip = enableClip;
 
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_portalBuffer, 0, NULL, &buffer, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_portalBuffer, &buffer, sizeof(buffer));
 	}
 
 	void SetWorldMatrix(dx::XMMATRIX *WorldMatrix) override
 	{
 		dx::XMMATRIX world = *WorldMatrix;
 		world = dx::XMMatrixTranspose(world);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_worldBuffer, 0, NULL, &world, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_worldBuffer, &world, sizeof(world));
 	}
 
 	void SetViewMatrix(dx::XMMATRIX *ViewMatrix) override
 	{
 		dx::XMMATRIX view = *ViewMatrix;
 		view = dx::XMMatrixTranspose(view);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_viewBuffer, 0, NULL, &view, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_viewBuffer, &view, sizeof(view));
 	}
 
 	void SetProjectionMatrix(dx::XMMATRIX *ProjectionMatrix) override
 	{
 		dx::XMMATRIX projection = *ProjectionMatrix;
 		projection = dx::XMMatrixTranspose(projection);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_projectionBuffer, 0, NULL, &projection, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_projectionBuffer, &projection, sizeof(projection));
 	}
 
 	void SetMaterial(MATERIAL Material) override
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_materialBuffer, 0, NULL, &Material, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_materialBuffer, &Material, sizeof(Material));
 	}
 
 	void SetDirectionalLight(DirectionalLight* Light) override
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_lightBuffer, 0, NULL, Light, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_lightBuffer, Light, sizeof(*Light));
 	}
 
 	void SetCameraPosition(dx::XMFLOAT3* cameraPosition) override
 	{
 		dx::XMFLOAT4 cam = dx::XMFLOAT4(cameraPosition->x, cameraPosition->y, cameraPosition->z, 1);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_cameraPosBuffer, 0, NULL, &cam, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_cameraPosBuffer, &cam, sizeof(cam));
 	}
 
 	void SetTexture(ID3D11ShaderResourceView* texture) override
 	{
-		CRenderer::GetDeviceContext()->PSSetShaderResources(0, 1, &texture);
+		CRenderer::SetShaderResource(ShaderStage::Pixel, 0, texture);
 	}
 
 	void SetSamplerState(ID3D11SamplerState* sampler) override
 	{
-		CRenderer::GetDeviceContext()->PSSetSamplers(0, 1, &sampler);
+		CRenderer::SetSampler(0, sampler);
 	}
 
 private:
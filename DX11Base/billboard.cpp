@@ -121,8 +121,7 @@ void Billboard::Draw(Pass pass)
 	CRenderer::GetDeviceContext()->Unmap(m_vertexBuffer, 0);
 	
 	// get the inverse of camera matrix to always face towards the camera
-	auto camera = CManager::GetActiveScene()->GetMainCamera();
-	dx::XMMATRIX view = camera->GetViewMatrix();
+	dx::XMMATRIX view = CManager::GetViewMatrix();
 	
 	// get the inverse view matrix
 	//D3DXMatrixInverse(&invView, NULL, &view);
@@ -32,7 +32,14 @@ void Camera::Uninit()
 void Camera::Update()
 {
 	GameObject::Update();
+}
+
+void Camera::UpdateMatrices()
+{
+	SetViewMatrix();
+	SetProjectionMatix();
 
+	// the frustum is built from the matrices the frame is drawn with, not the ones of the frame before
 	FrustumCulling::ConstructFrustum(m_farClip, GetProjectionMatrix(), GetViewMatrix());
 }
 
@@ -42,8 +49,15 @@ void Camera::Draw(Pass pass)
 
 	if (Debug::cameraNum == 0)
 	{
-		SetViewMatrix();
-		SetProjectionMatix();
+		// view, projection
+		dx::XMMATRIX view = GetViewMatrix();
+		dx::XMMATRIX projection = GetProjectionMatrix();
+		auto shaders = CRenderer::GetShaders();
+		for (auto shader : shaders)
+		{
+			shader->SetViewMatrix(&view);
+			shader->SetProjectionMatrix(&projection);
+		}
 		SetCameraPositionBuffers();
 	}
 	else if (Debug::cameraNum == 1 || Debug::cameraNum == 2)
@@ -63,15 +77,9 @@ void Camera::Draw(Pass pass)
 
 void Camera::SetProjectionMatix()
 {
+	// calculate the projection matrix
 	dx::XMMATRIX projection = dx::XMMatrixPerspectiveFovLH(1.0F, (float)SCREEN_WIDTH / SCREEN_HEIGHT, m_nearClip, m_farClip);
 
-	// calculate and set the projection matrix for each shader
-	auto shaders = CRenderer::GetShaders();
-	for (auto shader : shaders)
-	{
-		shader->SetProjectionMatrix(&projection);
-	}
-
 	// load the projection matrix to member variable
 	dx::XMStoreFloat4x4(&m_mProjection, projection);
 }
@@ -11,6 +11,10 @@ public:
 	virtual void Update() override;
 	virtual void Draw(Pass pass) override;
 
+	// builds the view, projection and frustum of this frame, called once on the main thread before the passes are culled and recorded,
+	// Draw only uploads them since passes may be recorded on several threads at once
+	void UpdateMatrices();
+
 	dx::XMMATRIX GetViewMatrix() const { return dx::XMLoadFloat4x4(&m_mView); }
 	dx::XMMATRIX GetProjectionMatrix() const { return dx::XMLoadFloat4x4(&m_mProjection); }
 	dx::XMMATRIX CalculateObliqueMatrix(dx::XMVECTOR clipPlane) const;
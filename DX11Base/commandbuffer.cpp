@@ -0,0 +1,124 @@
+#include <string.h>
+#include "commandbuffer.h"
+
+// commands start on pointer aligned offsets so the payloads can be read in place
+#define COMMAND_ALIGNMENT 8
+
+
+template <typename T>
+T* CommandBuffer::Allocate(CommandType type, uint32_t extraSize)
+{
+	uint32_t size = (uint32_t)(sizeof(CommandHeader) + sizeof(T) + extraSize);
+	size = (size + COMMAND_ALIGNMENT - 1) & ~(COMMAND_ALIGNMENT - 1);
+
+	size_t offset = m_data.size();
+	m_data.resize(offset + size);
+
+	CommandHeader* header = reinterpret_cast<CommandHeader*>(m_data.data() + offset);
+	header->type = type;
+	header->size = size;
+	++m_commandNum;
+
+	return reinterpret_cast<T*>(header + 1);
+}
+
+void CommandBuffer::Clear()
+{
+	// keeps the memory, the next pass records into it again
+	m_data.clear();
+	m_commandNum = 0;
+	m_drawNum = 0;
+}
+
+const CommandHeader* CommandBuffer::Next(const CommandHeader* header) const
+{
+	const uint8_t* next = reinterpret_cast<const uint8_t*>(header) + header->size;
+	return next < m_data.data() + m_data.size() ? reinterpret_cast<const CommandHeader*>(next) : nullptr;
+}
+
+void CommandBuffer::BindShader(Shader* shader)
+{
+	Allocate<BindShaderCommand>(CommandType::BindShader)->shader = shader;
+}
+
+void CommandBuffer::SetRasterizerState(uint8_t state)
+{
+	Allocate<SetRasterizerStateCommand>(CommandType::SetRasterizerState)->state = state;
+}
+
+void CommandBuffer::SetDepthStencilState(uint8_t number, uint8_t ref)
+{
+	*Allocate<SetDepthStencilStateCommand>(CommandType::SetDepthStencilState) = { number, ref };
+}
+
+void CommandBuffer::UpdateConstantBuffer(ID3D11Buffer* buffer, const void* data, uint32_t size)
+{
+	// constant buffers are multiples of 16 bytes and updated as a whole, so smaller values are padded with zeros
+	UpdateConstantBufferCommand* command = Allocate<UpdateConstantBufferCommand>(CommandType::UpdateConstantBuffer, (size + 15) & ~15u);
+	command->buffer = buffer;
+	command->size = size;
+	memcpy(command + 1, data, size);
+}
+
+void CommandBuffer::SetShaderResource(ShaderStage stage, uint8_t slot, ID3D11ShaderResourceView* view)
+{
+	*Allocate<SetShaderResourceCommand>(CommandType::SetShaderResource) = { view, stage, slot };
+}
+
+void CommandBuffer::SetSampler(uint8_t slot, ID3D11SamplerState* sampler)
+{
+	*Allocate<SetSamplerCommand>(CommandType::SetSampler) = { sampler, slot };
+}
+
+void CommandBuffer::SetVertexBuffer(ID3D11Buffer* buffer, uint32_t stride, VertexFormat format)
+{
+	*Allocate<SetVertexBufferCommand>(CommandType::SetVertexBuffer) = { buffer, stride, format };
+}
+
+void CommandBuffer::SetIndexBuffer(ID3D11Buffer* buffer, IndexFormat format)
+{
+	*Allocate<SetIndexBufferCommand>(CommandType::SetIndexBuffer) = { buffer, format };
+}
+
+void CommandBuffer::SetTopology(PrimitiveTopology topology)
+{
+	Allocate<SetTopologyCommand>(CommandType::SetTopology)->topology = topology;
+}
+
+void CommandBuffer::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+	*Allocate<DrawCommand>(CommandType::Draw) = { vertexCount, startVertex };
+	++m_drawNum;
+}
+
+void CommandBuffer::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	*Allocate<DrawIndexedCommand>(CommandType::DrawIndexed) = { indexCount, startIndex, baseVertex };
+	++m_drawNum;
+}
+
+void CommandBuffer::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	*Allocate<DrawIndexedInstancedCommand>(CommandType::DrawIndexedInstanced) = { indexCount, instanceCount, startIndex, baseVertex, startInstance };
+	++m_drawNum;
+}
+
+void CommandBuffer::CopyTextureRegion(ID3D11Texture2D* destination, ID3D11Texture2D* source, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+{
+	*Allocate<CopyTextureRegionCommand>(CommandType::CopyTextureRegion) = { destination, source, left, top, right, bottom };
+}
+
+void CommandBuffer::CopyResource(ID3D11Texture2D* destination, ID3D11Texture2D* source)
+{
+	*Allocate<CopyResourceCommand>(CommandType::CopyResource) = { destination, source };
+}
+
+void CommandBuffer::WriteInstances(InstancingShader* shader, const void* worlds, uint32_t count)
+{
+	// the matrices are copied, the batcher fills its array again for the next group
+	uint32_t size = count * 16 * sizeof(float);
+	WriteInstancesCommand* command = Allocate<WriteInstancesCommand>(CommandType::WriteInstances, size);
+	command->shader = shader;
+	command->count = count;
+	memcpy(command + 1, worlds, size);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// only pointers to these are recorded, so the command buffer and the null backend dont need the d3d headers
+struct ID3D11Buffer;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11Texture2D;
+class Shader;
+class InstancingShader;
+
+
+enum class CommandType : uint8_t
+{
+	BindShader, SetRasterizerState, SetDepthStencilState, UpdateConstantBuffer, SetShaderResource, SetSampler,
+	SetVertexBuffer, SetIndexBuffer, SetTopology, Draw, DrawIndexed, DrawIndexedInstanced, CopyTextureRegion, CopyResource, WriteInstances, Num
+};
+
+enum class ShaderStage : uint8_t { Vertex, Pixel };
+enum class IndexFormat : uint8_t { UInt16, UInt32 };
+enum class VertexFormat : uint8_t { Standard, Packed };	// VERTEX_3D and VERTEX_3D_PACKED
+enum class PrimitiveTopology : uint8_t { TriangleList, TriangleStrip, LineList };
+
+// every command starts with this header, the payload of the type follows it
+struct CommandHeader
+{
+	CommandType type;
+	uint32_t size;					// of the whole command including the header
+};
+
+struct BindShaderCommand { Shader* shader; };
+struct SetRasterizerStateCommand { uint8_t state; };
+struct SetDepthStencilStateCommand { uint8_t number, ref; };
+struct UpdateConstantBufferCommand { ID3D11Buffer* buffer; uint32_t size; };	// the data follows the command
+struct SetShaderResourceCommand { ID3D11ShaderResourceView* view; ShaderStage stage; uint8_t slot; };
+struct SetSamplerCommand { ID3D11SamplerState* sampler; uint8_t slot; };
+struct SetVertexBufferCommand { ID3D11Buffer* buffer; uint32_t stride; VertexFormat format; };
+struct SetIndexBufferCommand { ID3D11Buffer* buffer; IndexFormat format; };
+struct SetTopologyCommand { PrimitiveTopology topology; };
+struct DrawCommand { uint32_t vertexCount, startVertex; };
+struct DrawIndexedCommand { uint32_t indexCount, startIndex; int32_t baseVertex; };
+struct DrawIndexedInstancedCommand { uint32_t indexCount, instanceCount, startIndex; int32_t baseVertex; uint32_t startInstance; };
+struct CopyTextureRegionCommand { ID3D11Texture2D* destination; ID3D11Texture2D* source; uint32_t left, top, right, bottom; };
+struct CopyResourceCommand { ID3D11Texture2D* destination; ID3D11Texture2D* source; };
+struct WriteInstancesCommand { InstancingShader* shader; uint32_t count; };	// the world matrices follow the command, 16 floats each
+
+// typed render commands packed into one block of memory, recorded by the game and translated by a backend,
+// the buffer can be executed any number of times until it is cleared
+class CommandBuffer
+{
+public:
+	void Clear();
+
+	void BindShader(Shader* shader);
+	void SetRasterizerState(uint8_t state);
+	void SetDepthStencilState(uint8_t number, uint8_t ref);
+	void UpdateConstantBuffer(ID3D11Buffer* buffer, const void* data, uint32_t size);
+	void SetShaderResource(ShaderStage stage, uint8_t slot, ID3D11ShaderResourceView* view);
+	void SetSampler(uint8_t slot, ID3D11SamplerState* sampler);
+	void SetVertexBuffer(ID3D11Buffer* buffer, uint32_t stride, VertexFormat format = VertexFormat::Standard);
+	void SetIndexBuffer(ID3D11Buffer* buffer, IndexFormat format);
+	void SetTopology(PrimitiveTopology topology);
+	void Draw(uint32_t vertexCount, uint32_t startVertex);
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+	void CopyTextureRegion(ID3D11Texture2D* destination, ID3D11Texture2D* source, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom);
+	void CopyResource(ID3D11Texture2D* destination, ID3D11Texture2D* source);
+	void WriteInstances(InstancingShader* shader, const void* worlds, uint32_t count);
+
+	// walk the recorded commands, First returns nullptr for an empty buffer and Next after the last command
+	const CommandHeader* First() const { return m_data.empty() ? nullptr : reinterpret_cast<const CommandHeader*>(m_data.data()); }
+	const CommandHeader* Next(const CommandHeader* header) const;
+
+	template <typename T>
+	static const T& GetPayload(const CommandHeader* header) { return *reinterpret_cast<const T*>(header + 1); }
+	static const void* GetConstantData(const CommandHeader* header) { return &GetPayload<UpdateConstantBufferCommand>(header) + 1; }
+	static const void* GetInstanceData(const CommandHeader* header) { return &GetPayload<WriteInstancesCommand>(header) + 1; }
+
+	bool IsEmpty() const { return m_data.empty(); }
+	size_t GetSize() const { return m_data.size(); }
+	uint32_t GetCommandNum() const { return m_commandNum; }
+	uint32_t GetDrawNum() const { return m_drawNum; }
+
+private:
+	std::vector<uint8_t> m_data;
+	uint32_t m_commandNum = 0;
+	uint32_t m_drawNum = 0;
+
+	template <typename T>
+	T* Allocate(CommandType type, uint32_t extraSize = 0);
+};
@@ -0,0 +1,226 @@
+#include "pch.h"
+#include <d3d11_1.h>
+#include "constantring.h"
+#include "renderer.h"
+#include "statecache.h"
+
+// batches start at the beginning again when less than this is left, so a batch never ends after a few writes
+#define WRAP_THRESHOLD (64 * 1024)
+
+
+ID3D11DeviceContext1* ConstantRing::m_context = nullptr;
+ID3D11Buffer* ConstantRing::m_ring = nullptr;
+uint8_t* ConstantRing::m_mapped = nullptr;
+UINT ConstantRing::m_head = 0;
+std::unordered_map<ID3D11Buffer*, ConstantRing::Allocation> ConstantRing::m_allocations;
+ID3D11Buffer* ConstantRing::m_bound[2][SLOT_NUM] = {};
+std::vector<uint8_t> ConstantRing::m_padded;
+UINT ConstantRing::m_uploadBytes = 0;
+UINT ConstantRing::m_mapNum = 0;
+UINT ConstantRing::m_lastUploadBytes = 0;
+UINT ConstantRing::m_lastMapNum = 0;
+UINT ConstantRing::m_wrapNum = 0;
+
+
+void ConstantRing::Init()
+{
+	// offsets into constant buffers and mapping them without overwriting came with d3d 11.1, older runtimes and drivers keep updating every buffer
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (FAILED(CRenderer::GetDevice()->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+		return;
+	if (!options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+		return;
+	if (FAILED(CRenderer::GetDeviceContext()->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&m_context)))
+		return;
+
+	D3D11_BUFFER_DESC bd;
+	ZeroMemory(&bd, sizeof(bd));
+	bd.ByteWidth = RING_SIZE;
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	if (FAILED(CRenderer::GetDevice()->CreateBuffer(&bd, NULL, &m_ring)))
+	{
+		SAFE_RELEASE(m_context);
+		return;
+	}
+
+	// the first map discards
+	m_head = RING_SIZE;
+}
+
+void ConstantRing::Uninit()
+{
+	SAFE_RELEASE(m_ring);
+	SAFE_RELEASE(m_context);
+	m_allocations.clear();
+}
+
+void ConstantRing::BeginUpload()
+{
+	if (RING_SIZE - m_head < WRAP_THRESHOLD)
+	{
+		Wrap();
+		return;
+	}
+
+	// nothing the gpu may still read is written, everything goes behind the head
+	Map(D3D11_MAP_WRITE_NO_OVERWRITE);
+}
+
+UINT ConstantRing::Write(const void* data, UINT size)
+{
+	assert(m_mapped && CanWrite(size));
+
+	UINT offset = m_head;
+	memcpy(m_mapped + offset, data, size);
+	m_head += Align(size);
+	m_uploadBytes += size;
+
+	return offset;
+}
+
+void ConstantRing::EndUpload()
+{
+	if (!m_mapped)
+		return;
+
+	m_context->Unmap(m_ring, 0);
+	m_mapped = nullptr;
+}
+
+void ConstantRing::Assign(ID3D11Buffer* buffer, UINT offset, const void* data, UINT size)
+{
+	Allocation& allocation = m_allocations[buffer];
+	allocation.offset = offset;
+	allocation.constantNum = Align(size) / 16;
+	allocation.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+
+	Rebind(buffer);
+}
+
+void ConstantRing::Bind(ShaderStage stage, UINT slot, ID3D11Buffer* buffer)
+{
+	auto deviceContext = CRenderer::GetDeviceContext();
+	if (slot < SLOT_NUM)
+		m_bound[(int)stage][slot] = buffer;
+
+	auto it = m_ring ? m_allocations.find(buffer) : m_allocations.end();
+	if (it == m_allocations.end())
+	{
+		if (stage == ShaderStage::Vertex)
+			deviceContext->VSSetConstantBuffers(slot, 1, &buffer);
+		else
+			deviceContext->PSSetConstantBuffers(slot, 1, &buffer);
+		return;
+	}
+
+	UINT first = it->second.offset / 16;
+	UINT num = it->second.constantNum;
+	if (stage == ShaderStage::Vertex)
+		m_context->VSSetConstantBuffers1(slot, 1, &m_ring, &first, &num);
+	else
+		m_context->PSSetConstantBuffers1(slot, 1, &m_ring, &first, &num);
+}
+
+void ConstantRing::Update(ID3D11Buffer* buffer, const void* data, UINT size)
+{
+	// wrapping here would discard what the batch being replayed wrote, the buffer itself is updated instead
+	if (m_ring && CanWrite(size) && Map(D3D11_MAP_WRITE_NO_OVERWRITE))
+	{
+		UINT offset = Write(data, size);
+		EndUpload();
+		Assign(buffer, offset, data, size);
+		return;
+	}
+
+	m_allocations.erase(buffer);
+	UpdateBuffer(buffer, data, size);
+	Rebind(buffer);
+}
+
+void ConstantRing::EndFrame()
+{
+	m_lastUploadBytes = m_uploadBytes;
+	m_lastMapNum = m_mapNum;
+	m_uploadBytes = 0;
+	m_mapNum = 0;
+}
+
+void ConstantRing::Wrap()
+{
+	// discarding hands out fresh memory, the contents the buffers are still bound to are written again at the start
+	if (!Map(D3D11_MAP_WRITE_DISCARD))
+		return;
+	m_head = 0;
+	++m_wrapNum;
+
+	for (auto& pair : m_allocations)
+	{
+		pair.second.offset = Write(pair.second.data.data(), (UINT)pair.second.data.size());
+		Rebind(pair.first);
+	}
+}
+
+bool ConstantRing::Map(D3D11_MAP mapType)
+{
+	D3D11_MAPPED_SUBRESOURCE msr;
+	if (FAILED(m_context->Map(m_ring, 0, mapType, 0, &msr)) || !msr.pData)
+	{
+		Disable();
+		return false;
+	}
+
+	m_mapped = (uint8_t*)msr.pData;
+	++m_mapNum;
+	return true;
+}
+
+void ConstantRing::Disable()
+{
+	m_mapped = nullptr;
+	SAFE_RELEASE(m_ring);
+
+	// the buffers get the contents they were pointing at and are bound again as themselves,
+	// the copies of the state cache were compared against the ring and dont tell what the buffers hold
+	for (auto& pair : m_allocations)
+		UpdateBuffer(pair.first, pair.second.data.data(), (UINT)pair.second.data.size());
+	StateCache::InvalidateConstantBuffers();
+
+	std::vector<ID3D11Buffer*> buffers;
+	for (auto& pair : m_allocations)
+		buffers.push_back(pair.first);
+	m_allocations.clear();
+
+	for (ID3D11Buffer* buffer : buffers)
+		Rebind(buffer);
+}
+
+void ConstantRing::UpdateBuffer(ID3D11Buffer* buffer, const void* data, UINT size)
+{
+	D3D11_BUFFER_DESC bd;
+	buffer->GetDesc(&bd);
+
+	const void* source = data;
+	if (size < bd.ByteWidth)
+	{
+		m_padded.assign(bd.ByteWidth, 0);
+		memcpy(m_padded.data(), data, size);
+		source = m_padded.data();
+	}
+
+	CRenderer::GetDeviceContext()->UpdateSubresource(buffer, 0, NULL, source, 0, 0);
+}
+
+void ConstantRing::Rebind(ID3D11Buffer* buffer)
+{
+	for (int stage = 0; stage < 2; ++stage)
+	{
+		for (int slot = 0; slot < SLOT_NUM; ++slot)
+		{
+			if (m_bound[stage][slot] == buffer)
+				Bind((ShaderStage)stage, slot, buffer);
+		}
+	}
+}
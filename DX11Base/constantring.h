@@ -0,0 +1,71 @@
+#pragma once
+
+#include <unordered_map>
+#include "commandbuffer.h"
+
+struct ID3D11DeviceContext1;
+
+
+// one big dynamic buffer the constants of a frame are written into one after another, each shader constant buffer is bound as
+// a window into it at the offset of its latest contents, needs constant buffer offsetting of d3d 11.1 and falls back to
+// updating the constant buffers themselves without it
+static class ConstantRing
+{
+public:
+	static void Init();
+	static void Uninit();
+	static bool IsEnabled() { return m_ring != nullptr; }
+
+	// writes of one batch go into a single map, CanWrite tells when the batch has to end so the ring can wrap,
+	// the ring is turned off when it cannot be mapped and nothing is written
+	static void BeginUpload();
+	static bool CanWrite(UINT size) { return m_head + Align(size) <= RING_SIZE; }
+	static UINT Write(const void* data, UINT size);
+	static void EndUpload();
+
+	// the constant buffer reads the data written at that offset from now on
+	static void Assign(ID3D11Buffer* buffer, UINT offset, const void* data, UINT size);
+
+	// binds a shader constant buffer, as a window into the ring if its contents are there
+	static void Bind(ShaderStage stage, UINT slot, ID3D11Buffer* buffer);
+
+	// uploads outside of a batch, for constants set while a shader is being bound
+	static void Update(ID3D11Buffer* buffer, const void* data, UINT size);
+
+	static void EndFrame();
+	static UINT GetUploadBytes() { return m_lastUploadBytes; }
+	static UINT GetMapNum() { return m_lastMapNum; }
+	static UINT GetWrapNum() { return m_wrapNum; }
+
+private:
+	static const UINT RING_SIZE = 4 * 1024 * 1024;
+	static const UINT ALIGNMENT = 256;			// offsets and sizes are counted in blocks of 16 constants
+	static const int SLOT_NUM = 16;
+
+	struct Allocation
+	{
+		UINT offset;
+		UINT constantNum;
+		std::vector<uint8_t> data;				// written again at the start when the ring wraps
+	};
+
+	static ID3D11DeviceContext1* m_context;
+	static ID3D11Buffer* m_ring;
+	static uint8_t* m_mapped;
+	static UINT m_head;
+	static std::unordered_map<ID3D11Buffer*, Allocation> m_allocations;
+	static ID3D11Buffer* m_bound[2][SLOT_NUM];
+	static std::vector<uint8_t> m_padded;
+
+	static UINT m_uploadBytes, m_mapNum, m_lastUploadBytes, m_lastMapNum, m_wrapNum;
+
+	static UINT Align(UINT size) { return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1); }
+	// false when the ring could not be mapped, it is turned off then
+	static bool Map(D3D11_MAP mapType);
+	// puts the contents the buffers point at in the ring back into the buffers and updates them directly from then on
+	static void Disable();
+	static void Wrap();
+	static void Rebind(ID3D11Buffer* buffer);
+	// updates the whole buffer, the data is padded with zeros up to its size
+	static void UpdateBuffer(ID3D11Buffer* buffer, const void* data, UINT size);
+};
@@ -9,6 +9,7 @@
 #include "main.h"
 #include "stage.h"
 #include "debug.h"
+#include "lodselector.h"
 
 
 void Cube::Awake()
@@ -17,16 +18,19 @@ void Cube::Awake()
 
 	// init player stuff
 	m_shader = CRenderer::GetShader<BasicLightShader>();
+	m_instancingShader = CRenderer::GetShader<InstancingShader>();
 
 	ModelManager::GetModel(MODEL_CUBE, m_model);
+	SetLocalBounds(m_model->GetBoundsCenter(), m_model->GetBoundsExtents());
 
 	SetPosition(0.0F, 1.2F, 10.0F);
 	SetRotation(0, 0, 0);
 	m_scale = dx::XMFLOAT3(0.15F, 0.15F, 0.15F);
 
-	m_entrancePortal = PortalType::None;
+	SetPassMask(PassBit(Pass::Default) | PassBit(Pass::Portal), PassBit(Pass::Lightmap));
+
+	m_entrancePortal = PORTAL_NONE;
 	m_isGrounded = true;
-	m_enableFrustumCulling = false;
 	m_velocity = { 0,0,0 };
 
 	m_obb.Init((GameObject*)this, 11.0f, 11.0f, 11.0f, 0, 0, 0);
@@ -150,7 +154,7 @@ void Cube::PortalFunneling()
 
 void Cube::Draw(Pass pass)
 {
-	if (!(pass == Pass::Default || pass == Pass::PortalBlue || pass == Pass::PortalOrange))
+	if (!(pass == Pass::Default || pass == Pass::Portal))
 		return;
 
 	GameObject::Draw(pass);
@@ -165,15 +169,11 @@ void Cube::Draw(Pass pass)
 	mat.Specular = { 1,1,1,1 };
 	m_shader->SetMaterial(mat);
 
-	if (pass == Pass::PortalBlue)
-	{
-		m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(PortalType::Blue));
-		m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(PortalType::Blue));
-	}
-	else if (pass == Pass::PortalOrange)
+	if (pass == Pass::Portal)
 	{
-		m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(PortalType::Orange));
-		m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(PortalType::Orange));
+		int portal = PortalManager::GetRenderingPortal();
+		m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(portal));
+		m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(portal));
 	}
 
 	// set the stencil forcefully to 0 to prevent portal backface rendering over the cube
@@ -181,15 +181,15 @@ void Cube::Draw(Pass pass)
 		CRenderer::SetDepthStencilState(4, 0);
 
 	// draw the model
-	CRenderer::DrawModel(m_shader, m_model);
+	CRenderer::DrawModel(m_shader, m_model, true, LodSelector::Select(*m_model, world));
 
 	// draw the cloned model
 	if (auto linked = PortalManager::GetLinkedPortal(m_entrancePortal))
 	{
-		m_shader->SetPortalInverseWorldMatrix(Debug::portalClipping, &dx::XMMatrixInverse(nullptr, linked->GetWorldMatrix()));
+		m_shader->SetPortalInverseWorldMatrix(Debug::portalClipping, &linked->GetInverseWorldMatrix());
 		dx::XMMATRIX world = linked->GetLinkedPortal()->GetClonedOrientationMatrix(GetWorldMatrix());
 		m_shader->SetWorldMatrix(&world);
-		CRenderer::DrawModel(m_shader, m_model);
+		CRenderer::DrawModel(m_shader, m_model, true, LodSelector::Select(*m_model, world));
 
 		m_shader->SetPortalInverseWorldMatrix(false);
 	}
@@ -199,6 +199,43 @@ void Cube::Draw(Pass pass)
 		CRenderer::SetDepthStencilState(6, 0);
 }
 
+bool Cube::DrawInstance(Pass pass, InstanceKey& key, dx::XMFLOAT4X4& world)
+{
+	// the clone needs portal clipping and the collider its own draw, those cubes are drawn one by one
+	if (!(pass == Pass::Default || pass == Pass::Portal) || Debug::displayCollider || PortalManager::GetLinkedPortal(m_entrancePortal))
+		return false;
+
+	GameObject::Draw(pass);
+
+	dx::XMMATRIX worldMatrix = GetWorldMatrix();
+	key = { m_model.get(), (uint32_t)LodSelector::Select(*m_model, worldMatrix) };
+	dx::XMStoreFloat4x4(&world, worldMatrix);
+	return true;
+}
+
+void Cube::DrawInstanced(Pass pass, const InstanceKey& key, UINT instanceCount)
+{
+	MATERIAL mat = {};
+	mat.Diffuse = { 1,1,1,1 };
+	mat.Specular = { 1,1,1,1 };
+	m_instancingShader->SetMaterial(mat);
+
+	if (pass == Pass::Portal)
+	{
+		int portal = PortalManager::GetRenderingPortal();
+		m_instancingShader->SetViewMatrix(&PortalManager::GetViewMatrix(portal));
+		m_instancingShader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(portal));
+	}
+
+	if (pass == Pass::Default)
+		CRenderer::SetDepthStencilState(4, 0);
+
+	CRenderer::DrawModelInstanced(m_instancingShader, m_model, instanceCount, (int)key.lod);
+
+	if (pass == Pass::Default)
+		CRenderer::SetDepthStencilState(6, 0);
+}
+
 void Cube::Draw(const std::shared_ptr<Shader>& shader, Pass pass)
 {
 	if (!(pass == Pass::Lightmap))
@@ -238,13 +275,6 @@ void Cube::Swap()
 		dx::XMVECTOR vel = dx::XMLoadFloat3(&adjustedVel);
 		dx::XMStoreFloat3(&m_velocity, portal->GetClonedVelocity(vel));
 
-		if (portal->GetType() == PortalType::Blue)
-		{
-			SetEntrancePortal(PortalType::Orange);
-		}
-		else
-		{
-			SetEntrancePortal(PortalType::Blue);
-		}
+		SetEntrancePortal(LinkedPortalSlot(portal->GetSlot()));
 	}
 }
@@ -2,6 +2,7 @@
 
 #include "gameObject.h"
 #include "basiclightshader.h"
+#include "instancingshader.h"
 #include "collision.h"
 #include "portaltraveler.h"
 #include "grabbable.h"
@@ -19,12 +20,18 @@ public:
 	void Update() override;
 	void Draw(Pass pass) override;
 	void Draw(const std::shared_ptr<Shader>& shader, Pass pass) override;
+	bool DrawInstance(Pass pass, InstanceKey& key, dx::XMFLOAT4X4& world) override;
+	void DrawInstanced(Pass pass, const InstanceKey& key, UINT instanceCount) override;
 
 	void Swap() override;
 	dx::XMVECTOR GetTravelerPosition() const override { return GetPosition(); }
 
+	// the clone is drawn at the other portal while traveling, which the bounds dont cover
+	bool IsCullable() const override { return GameObject::IsCullable() && m_entrancePortal == PORTAL_NONE; }
+
 private:
 	std::shared_ptr<BasicLightShader> m_shader;
+	std::shared_ptr<InstancingShader> m_instancingShader;
 	std::shared_ptr<Model> m_model;
 	bool m_isGrounded;
 
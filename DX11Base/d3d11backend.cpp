@@ -0,0 +1,227 @@
+#include "pch.h"
+#include "d3d11backend.h"
+#include "commandbuffer.h"
+#include "renderer.h"
+#include "shader.h"
+#include "instancingshader.h"
+#include "statecache.h"
+#include "constantring.h"
+
+
+// constant updates the state cache dropped, nothing was written to the ring for them
+#define CONSTANTS_FILTERED UINT_MAX
+
+
+void D3D11Backend::Execute(const CommandBuffer& commandBuffer)
+{
+	if (!ConstantRing::IsEnabled())
+	{
+		for (const CommandHeader* header = commandBuffer.First(); header; header = commandBuffer.Next(header))
+			Replay(header);
+		return;
+	}
+
+	// the constants of as many commands as fit into the ring are written in one map, then those commands are replayed
+	const CommandHeader* header = commandBuffer.First();
+	while (header)
+	{
+		// the rest goes without the ring when it was turned off because it could not be mapped
+		const CommandHeader* end = UploadConstants(commandBuffer, header);
+		if (!ConstantRing::IsEnabled())
+			end = nullptr;
+		for (; header != end; header = commandBuffer.Next(header))
+			Replay(header);
+	}
+}
+
+const CommandHeader* D3D11Backend::UploadConstants(const CommandBuffer& commandBuffer, const CommandHeader* header)
+{
+	m_constantOffsets.clear();
+	m_nextConstantOffset = 0;
+
+	ConstantRing::BeginUpload();
+	if (!ConstantRing::IsEnabled())
+		return header;
+
+	for (; header; header = commandBuffer.Next(header))
+	{
+		if (header->type != CommandType::UpdateConstantBuffer)
+			continue;
+
+		const UpdateConstantBufferCommand& command = CommandBuffer::GetPayload<UpdateConstantBufferCommand>(header);
+		UINT size = (command.size + 15) & ~15u;
+		if (!ConstantRing::CanWrite(size))
+			break;
+
+		const void* data = CommandBuffer::GetConstantData(header);
+		m_constantOffsets.push_back(StateCache::UpdateConstantBuffer(command.buffer, data, command.size) ? ConstantRing::Write(data, size) : CONSTANTS_FILTERED);
+	}
+	ConstantRing::EndUpload();
+
+	return header;
+}
+
+void D3D11Backend::Replay(const CommandHeader* header)
+{
+	auto deviceContext = CRenderer::GetDeviceContext();
+	static const D3D11_PRIMITIVE_TOPOLOGY topologies[] = { D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, D3D11_PRIMITIVE_TOPOLOGY_LINELIST };
+
+	switch (header->type)
+	{
+	case CommandType::BindShader:
+	{
+		Shader* shader = CommandBuffer::GetPayload<BindShaderCommand>(header).shader;
+		if (!StateCache::BindShader(shader))
+			break;
+
+		deviceContext->VSSetShader(shader->m_vertexShader, NULL, 0);
+		deviceContext->PSSetShader(shader->m_pixelShader, NULL, 0);
+		shader->UpdateConstantBuffers();
+		StateCache::InvalidateShaderResources();
+
+		// the shader sets its standard layout
+		m_shader = shader;
+		if (m_vertexFormat == VertexFormat::Packed)
+			ApplyInputLayout();
+		break;
+	}
+	case CommandType::SetRasterizerState:
+	{
+		uint8_t state = CommandBuffer::GetPayload<SetRasterizerStateCommand>(header).state;
+		if (StateCache::SetRasterizerState(state))
+			CRenderer::ApplyRasterizerState((RasterizerState)state);
+		break;
+	}
+	case CommandType::SetDepthStencilState:
+	{
+		const SetDepthStencilStateCommand& command = CommandBuffer::GetPayload<SetDepthStencilStateCommand>(header);
+		if (StateCache::SetDepthStencilState(command.number, command.ref))
+			CRenderer::ApplyDepthStencilState(command.number, command.ref);
+		break;
+	}
+	case CommandType::UpdateConstantBuffer:
+	{
+		const UpdateConstantBufferCommand& command = CommandBuffer::GetPayload<UpdateConstantBufferCommand>(header);
+		const void* data = CommandBuffer::GetConstantData(header);
+		if (ConstantRing::IsEnabled())
+		{
+			// already written by the upload, the buffer only has to point at it
+			UINT offset = m_constantOffsets[m_nextConstantOffset++];
+			if (offset != CONSTANTS_FILTERED)
+				ConstantRing::Assign(command.buffer, offset, data, (command.size + 15) & ~15u);
+		}
+		else if (StateCache::UpdateConstantBuffer(command.buffer, data, command.size))
+			deviceContext->UpdateSubresource(command.buffer, 0, NULL, data, 0, 0);
+		break;
+	}
+	case CommandType::SetShaderResource:
+	{
+		const SetShaderResourceCommand& command = CommandBuffer::GetPayload<SetShaderResourceCommand>(header);
+		if (!StateCache::SetShaderResource(command.stage, command.slot, command.view))
+			break;
+
+		if (command.stage == ShaderStage::Vertex)
+			deviceContext->VSSetShaderResources(command.slot, 1, &command.view);
+		else
+			deviceContext->PSSetShaderResources(command.slot, 1, &command.view);
+		break;
+	}
+	case CommandType::SetSampler:
+	{
+		const SetSamplerCommand& command = CommandBuffer::GetPayload<SetSamplerCommand>(header);
+		if (StateCache::SetSampler(command.slot, command.sampler))
+			deviceContext->PSSetSamplers(command.slot, 1, &command.sampler);
+		break;
+	}
+	case CommandType::SetVertexBuffer:
+	{
+		const SetVertexBufferCommand& command = CommandBuffer::GetPayload<SetVertexBufferCommand>(header);
+		if (!StateCache::SetVertexBuffer(command.buffer, command.stride, command.format))
+			break;
+
+		if (command.format == VertexFormat::Packed)
+		{
+			// packed vertices have no diffuse, every vertex reads the same white from a second stream without stride
+			ID3D11Buffer* buffers[2] = { command.buffer, CRenderer::m_whiteVertexBuffer };
+			UINT strides[2] = { command.stride, 0 };
+			UINT offsets[2] = { 0, 0 };
+			deviceContext->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+		}
+		else
+		{
+			UINT offset = 0;
+			deviceContext->IASetVertexBuffers(0, 1, &command.buffer, &command.stride, &offset);
+		}
+
+		if (command.format != m_vertexFormat)
+		{
+			m_vertexFormat = command.format;
+			ApplyInputLayout();
+		}
+		break;
+	}
+	case CommandType::SetIndexBuffer:
+	{
+		const SetIndexBufferCommand& command = CommandBuffer::GetPayload<SetIndexBufferCommand>(header);
+		if (StateCache::SetIndexBuffer(command.buffer, command.format))
+			deviceContext->IASetIndexBuffer(command.buffer, command.format == IndexFormat::UInt16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, 0);
+		break;
+	}
+	case CommandType::SetTopology:
+		deviceContext->IASetPrimitiveTopology(topologies[(int)CommandBuffer::GetPayload<SetTopologyCommand>(header).topology]);
+		break;
+	case CommandType::Draw:
+	{
+		const DrawCommand& command = CommandBuffer::GetPayload<DrawCommand>(header);
+		deviceContext->Draw(command.vertexCount, command.startVertex);
+		break;
+	}
+	case CommandType::DrawIndexed:
+	{
+		const DrawIndexedCommand& command = CommandBuffer::GetPayload<DrawIndexedCommand>(header);
+		deviceContext->DrawIndexed(command.indexCount, command.startIndex, command.baseVertex);
+		break;
+	}
+	case CommandType::DrawIndexedInstanced:
+	{
+		const DrawIndexedInstancedCommand& command = CommandBuffer::GetPayload<DrawIndexedInstancedCommand>(header);
+		deviceContext->DrawIndexedInstanced(command.indexCount, command.instanceCount, command.startIndex, command.baseVertex, command.startInstance);
+		break;
+	}
+	case CommandType::CopyTextureRegion:
+	{
+		const CopyTextureRegionCommand& command = CommandBuffer::GetPayload<CopyTextureRegionCommand>(header);
+		D3D11_BOX box = { command.left, command.top, 0, command.right, command.bottom, 1 };
+		deviceContext->CopySubresourceRegion(command.destination, 0, command.left, command.top, 0, command.source, 0, &box);
+		break;
+	}
+	case CommandType::CopyResource:
+	{
+		const CopyResourceCommand& command = CommandBuffer::GetPayload<CopyResourceCommand>(header);
+		deviceContext->CopyResource(command.destination, command.source);
+		break;
+	}
+	case CommandType::WriteInstances:
+	{
+		const WriteInstancesCommand& command = CommandBuffer::GetPayload<WriteInstancesCommand>(header);
+		command.shader->UploadInstances((const dx::XMFLOAT4X4*)CommandBuffer::GetInstanceData(header), command.count);
+		break;
+	}
+	default:
+		assert(false && "unknown command");
+		break;
+	}
+}
+
+void D3D11Backend::ApplyInputLayout()
+{
+	if (!m_shader)
+		return;
+
+	// shaders that never draw static meshes only have the standard layout
+	ID3D11InputLayout* layout = m_shader->m_vertexLayout;
+	if (m_vertexFormat == VertexFormat::Packed && m_shader->m_packedVertexLayout)
+		layout = m_shader->m_packedVertexLayout;
+
+	CRenderer::GetDeviceContext()->IASetInputLayout(layout);
+}
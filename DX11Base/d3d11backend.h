@@ -0,0 +1,27 @@
+#pragma once
+
+#include "renderbackend.h"
+#include "commandbuffer.h"
+
+
+// replays the commands on the immediate context of the renderer, changes to the state already bound are dropped by the state cache
+class D3D11Backend : public RenderBackend
+{
+public:
+	void Execute(const CommandBuffer& commandBuffer) override;
+	const char* GetName() const override { return "D3D11"; }
+
+private:
+	// where the constants of each update in the current batch were written into the constant ring
+	std::vector<UINT> m_constantOffsets;
+	size_t m_nextConstantOffset = 0;
+
+	// the input layout depends on the bound shader and on the format of the bound vertex buffer
+	Shader* m_shader = nullptr;
+	VertexFormat m_vertexFormat = VertexFormat::Standard;
+
+	void ApplyInputLayout();
+
+	const CommandHeader* UploadConstants(const CommandBuffer& commandBuffer, const CommandHeader* header);
+	void Replay(const CommandHeader* header);
+};
@@ -5,6 +5,18 @@
 #include "input.h"
 #include "player.h"
 #include "portalmanager.h"
+#include "portalvisibility.h"
+#include "framebudget.h"
+#include "rendertexturepool.h"
+#include "framegraph.h"
+#include "nullbackend.h"
+#include "statecache.h"
+#include "constantring.h"
+#include "instancebatcher.h"
+#include "meshoptimizer.h"
+#include "lodselector.h"
+#include "geometrypool.h"
+#include "shadowcache.h"
 #include "scenetitle.h"
 
 
@@ -28,7 +40,7 @@ void Debug::Draw()
 	// generic window
 	const char* technique = PortalManager::GetPortalTechnique() == PortalTechnique::Stencil ? "Stencil" : "RenderTexture";
 
-	ImGui::SetNextWindowSize(ImVec2(300, 215));
+	ImGui::SetNextWindowSize(ImVec2(300, 655));
 	ImGui::Begin("Debug");
 	ImGui::Text("Pause Update: P Key");
 	ImGui::Spacing();
@@ -37,6 +49,90 @@ void Debug::Draw()
 	ImGui::Spacing();
 
 	ImGui::Text("recursion count: %i", PortalManager::GetRecursionNum());
+	ImGui::Text("visible depth: blue %i, orange %i", PortalVisibility::GetVisibleDepth(0), PortalVisibility::GetVisibleDepth(1));
+	ImGui::Text("portal passes %i/%i, screens %.2f/%.2f", PortalVisibility::GetUsedPasses(), PortalVisibility::GetPassBudget(), PortalVisibility::GetUsedPixels(), PortalVisibility::GetPixelBudget());
+	ImGui::Text("portal pairs: %i", PortalManager::GetPairNum());
+	ImGui::SameLine();
+	if (ImGui::Button("+"))
+		PortalManager::SetPairNum(PortalManager::GetPairNum() + 1);
+	ImGui::SameLine();
+	if (ImGui::Button("-"))
+		PortalManager::SetPairNum(PortalManager::GetPairNum() - 1);
+	ImGui::Text("shooting pair %i: Tab Key", PortalManager::GetShootPair());
+	ImGui::Spacing();
+
+	bool frameBudget = FrameBudget::IsEnabled();
+	if (ImGui::Checkbox("frame budget", &frameBudget))
+		FrameBudget::Enable(frameBudget);
+	ImGui::Text("cpu %.2fms (update + draw) gpu %.2fms", FrameBudget::GetCpuFrameTime(), FrameBudget::GetGpuFrameTime());
+	ImGui::Text("depth %i, texture scale %.3f", FrameBudget::GetRecursionDepth(), FrameBudget::GetResolutionScale());
+	ImGui::Text("reprojected levels: %i", PortalManager::GetReprojectionLevels());
+	ImGui::SameLine();
+	if (ImGui::Button("+##reprojection"))
+		PortalManager::SetReprojectionLevels(PortalManager::GetReprojectionLevels() + 1);
+	ImGui::SameLine();
+	if (ImGui::Button("-##reprojection"))
+		PortalManager::SetReprojectionLevels(PortalManager::GetReprojectionLevels() - 1);
+	float falloff = PortalManager::GetLevelFalloff();
+	if (ImGui::SliderFloat("level falloff", &falloff, 0.1f, 1.0f))
+		PortalManager::SetLevelFalloff(falloff);
+	ImGui::Text("render targets %i/%i, %.1fMB", RenderTexturePool::GetLeasedNum(), RenderTexturePool::GetTextureNum(), RenderTexturePool::GetMemorySize() / (1024.0f * 1024.0f));
+	ImGui::Text("passes %i run, %i culled, %i redundant clears", (int)FrameGraph::GetExecutionOrder().size(), FrameGraph::GetCulledNum(), FrameGraph::GetRedundantClearNum());
+	if (ImGui::TreeNode("target lifetimes"))
+	{
+		for (const TargetLifetime& lifetime : FrameGraph::GetLifetimes())
+			ImGui::Text("target %i: passes %i-%i", lifetime.target, lifetime.firstUse, lifetime.lastUse);
+		ImGui::TreePop();
+	}
+	ImGui::Text("commands %u, draws %u, submits %u, %.1fKB", CRenderer::GetCommandNum(), CRenderer::GetDrawNum(), CRenderer::GetSubmitNum(), CRenderer::GetCommandBytes() / 1024.0f);
+
+	// nothing reaches the gpu with the null backend, only the cost of recording and walking the commands is left
+	bool nullBackend = !CRenderer::IsD3D11Backend();
+	if (ImGui::Checkbox("null backend", &nullBackend))
+		CRenderer::SetBackend(nullBackend ? std::make_shared<NullBackend>() : nullptr);
+
+	StateStats stateStats = StateCache::GetFrameStats();
+	ImGui::Text("state changes %u issued, %u filtered", stateStats.issued, stateStats.filtered);
+	if (ConstantRing::IsEnabled())
+		ImGui::Text("constants %.1fKB in %u maps, %u wraps", ConstantRing::GetUploadBytes() / 1024.0f, ConstantRing::GetMapNum(), ConstantRing::GetWrapNum());
+	else
+		ImGui::Text("constants: no buffer offsets, updating each buffer");
+
+	bool instancing = InstanceBatcher::IsEnabled();
+	if (ImGui::Checkbox("instancing", &instancing))
+		InstanceBatcher::Enable(instancing);
+	ImGui::SameLine();
+	ImGui::Text("%i objects in %i draws", InstanceBatcher::GetInstanceNum(), InstanceBatcher::GetGroupNum());
+
+	bool parallelRecording = CManager::IsParallelRecording();
+	if (ImGui::Checkbox("parallel recording", &parallelRecording))
+		CManager::EnableParallelRecording(parallelRecording);
+	ImGui::SameLine();
+	ImGui::Text("%i passes on workers", CManager::GetParallelPassNum());
+	ImGui::Text("geometry pool: %i meshes, %u vertices", GeometryPool::GetAllocationNum(), GeometryPool::GetVertexNum());
+	ImGui::Text("mesh acmr %.2f -> %.2f, atvr %.2f -> %.2f", MeshOptimizer::GetACMR(false), MeshOptimizer::GetACMR(true), MeshOptimizer::GetATVR(false), MeshOptimizer::GetATVR(true));
+
+	bool lod = LodSelector::IsEnabled();
+	if (ImGui::Checkbox("lod", &lod))
+		LodSelector::Enable(lod);
+	ImGui::SameLine();
+	ImGui::Text("models per level %i/%i/%i/%i", LodSelector::GetSelectedNum(0), LodSelector::GetSelectedNum(1), LodSelector::GetSelectedNum(2), LodSelector::GetSelectedNum(3));
+
+	bool shadowCache = ShadowCache::IsEnabled();
+	if (ImGui::Checkbox("cache static shadows", &shadowCache))
+		ShadowCache::Enable(shadowCache);
+	ImGui::SameLine();
+	ImGui::Text("%i/%i cascades drawn, %i total", ShadowCache::GetStaticRenderedNum(), LightManager::CASCADE_NUM, ShadowCache::GetStaticRenderNum());
+	if (ImGui::TreeNode("state changes per pass"))
+	{
+		const std::vector<StateStats>& passStats = StateCache::GetPassStats();
+		for (int i = 0; i < (int)passStats.size(); ++i)
+		{
+			if (passStats[i].issued + passStats[i].filtered > 0)
+				ImGui::Text("pass %i: %u issued, %u filtered", i, passStats[i].issued, passStats[i].filtered);
+		}
+		ImGui::TreePop();
+	}
 	if (ImGui::Button("Increase"))
 		PortalManager::SetRecursionNum(PortalManager::GetRecursionNum() + 1);
 	if (ImGui::Button("Decrease"))
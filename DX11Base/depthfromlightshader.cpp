@@ -55,6 +55,7 @@ void DepthFromLightShader::Init()
 			buffer,
 			fsize,
 			&m_vertexLayout);
+		CreatePackedVertexLayout(buffer, fsize);
 
 		delete[] buffer;
 	}
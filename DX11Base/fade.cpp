@@ -9,6 +9,7 @@ void Fade::Awake()
 	GameObject::Awake();
 
 	m_shader = CRenderer::GetShader<UIShader>();
+	SetPassMask(PassBit(Pass::UI), PASS_MASK_NONE);
 	m_alpha = 0;
 	m_isFadingIn = m_isFadingOut = false;
 
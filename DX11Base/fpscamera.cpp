@@ -99,15 +99,9 @@ void FPSCamera::SetViewMatrix()
 		up = dx::XMLoadFloat3(&target->virtualUp);
 	}
 
-	// calculate and set the view matrix for each shader
+	// calculate the view matrix
 	view = dx::XMMatrixLookToLH(eye, forward, up);
 
-	auto shaders = CRenderer::GetShaders();
-	for (auto shader : shaders)
-	{
-		shader->SetViewMatrix(&view);
-	}
-
 	// load the view matrix back to member variable
 	dx::XMStoreFloat4x4(&m_mView, view);
 }
@@ -0,0 +1,156 @@
+#include "pch.h"
+#include <algorithm>
+#include "main.h"
+#include "renderer.h"
+#include "framebudget.h"
+
+#define ADJUST_INTERVAL 20				// frames between two quality changes, gives the timings time to settle
+#define SCALE_STEP 0.125f
+#define SMOOTHING 0.1f
+
+
+ID3D11Query* FrameBudget::m_disjointQuery[QUERY_LATENCY] = {};
+ID3D11Query* FrameBudget::m_beginQuery[QUERY_LATENCY] = {};
+ID3D11Query* FrameBudget::m_endQuery[QUERY_LATENCY] = {};
+int FrameBudget::m_frame = 0;
+LARGE_INTEGER FrameBudget::m_cpuFrequency;
+LARGE_INTEGER FrameBudget::m_cpuBegin;
+
+bool FrameBudget::m_enabled = true;
+float FrameBudget::m_targetFrameTime = 1000.0f / FPS * 0.85f;
+float FrameBudget::m_cpuFrameTime = 0.0f;
+float FrameBudget::m_gpuFrameTime = 0.0f;
+int FrameBudget::m_framesSinceChange = 0;
+
+int FrameBudget::m_depth = 0;
+int FrameBudget::m_minDepth = 1;
+int FrameBudget::m_maxDepth = 0;
+float FrameBudget::m_scale = 1.0f;
+float FrameBudget::m_minScale = 0.5f;
+float FrameBudget::m_maxScale = 1.0f;
+
+
+void FrameBudget::Init()
+{
+	auto device = CRenderer::GetDevice();
+
+	D3D11_QUERY_DESC desc = {};
+	for (int i = 0; i < QUERY_LATENCY; ++i)
+	{
+		desc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+		device->CreateQuery(&desc, &m_disjointQuery[i]);
+
+		desc.Query = D3D11_QUERY_TIMESTAMP;
+		device->CreateQuery(&desc, &m_beginQuery[i]);
+		device->CreateQuery(&desc, &m_endQuery[i]);
+	}
+
+	QueryPerformanceFrequency(&m_cpuFrequency);
+	m_frame = 0;
+}
+
+void FrameBudget::Uninit()
+{
+	for (int i = 0; i < QUERY_LATENCY; ++i)
+	{
+		SAFE_RELEASE(m_disjointQuery[i]);
+		SAFE_RELEASE(m_beginQuery[i]);
+		SAFE_RELEASE(m_endQuery[i]);
+	}
+}
+
+void FrameBudget::BeginUpdate()
+{
+	QueryPerformanceCounter(&m_cpuBegin);
+}
+
+void FrameBudget::BeginFrame()
+{
+	auto deviceContext = CRenderer::GetDeviceContext();
+	int index = m_frame % QUERY_LATENCY;
+
+	// the queries of this slot were issued QUERY_LATENCY frames ago
+	if (m_frame >= QUERY_LATENCY)
+		ReadGpuTime(index);
+
+	deviceContext->Begin(m_disjointQuery[index]);
+	deviceContext->End(m_beginQuery[index]);
+}
+
+void FrameBudget::EndFrame()
+{
+	auto deviceContext = CRenderer::GetDeviceContext();
+	int index = m_frame % QUERY_LATENCY;
+
+	deviceContext->End(m_endQuery[index]);
+	deviceContext->End(m_disjointQuery[index]);
+	++m_frame;
+
+	// cpu time of the update and the draw without waiting for present
+	LARGE_INTEGER cpuEnd;
+	QueryPerformanceCounter(&cpuEnd);
+	float cpuTime = (float)(cpuEnd.QuadPart - m_cpuBegin.QuadPart) * 1000.0f / (float)m_cpuFrequency.QuadPart;
+	m_cpuFrameTime += (cpuTime - m_cpuFrameTime) * SMOOTHING;
+
+	AdjustQuality();
+}
+
+void FrameBudget::SetMaxRecursionDepth(int depth)
+{
+	m_maxDepth = depth;
+	m_depth = depth;
+	m_scale = m_maxScale;
+	m_framesSinceChange = 0;
+}
+
+void FrameBudget::ReadGpuTime(int index)
+{
+	auto deviceContext = CRenderer::GetDeviceContext();
+
+	// dont stall if the gpu is further behind, just skip this sample
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	if (deviceContext->GetData(m_disjointQuery[index], &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK || disjoint.Disjoint)
+		return;
+
+	UINT64 begin, end;
+	if (deviceContext->GetData(m_beginQuery[index], &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+		deviceContext->GetData(m_endQuery[index], &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return;
+
+	float gpuTime = (float)(end - begin) * 1000.0f / (float)disjoint.Frequency;
+	m_gpuFrameTime += (gpuTime - m_gpuFrameTime) * SMOOTHING;
+}
+
+void FrameBudget::AdjustQuality()
+{
+	if (!m_enabled || ++m_framesSinceChange < ADJUST_INTERVAL)
+		return;
+
+	float frameTime = std::max(m_cpuFrameTime, m_gpuFrameTime);
+	int minDepth = std::min(m_minDepth, m_maxDepth);
+
+	if (frameTime > m_targetFrameTime)
+	{
+		// over budget, drop the deepest recursion first since every level is a full scene
+		if (m_depth > minDepth)
+			m_depth--;
+		else if (m_scale > m_minScale)
+			m_scale = std::max(m_minScale, m_scale - SCALE_STEP);
+		else
+			return;
+	}
+	else if (frameTime < m_targetFrameTime * 0.7f)
+	{
+		// plenty of headroom, restore the resolution before going deeper
+		if (m_scale < m_maxScale)
+			m_scale = std::min(m_maxScale, m_scale + SCALE_STEP);
+		else if (m_depth < m_maxDepth)
+			m_depth++;
+		else
+			return;
+	}
+	else
+		return;
+
+	m_framesSinceChange = 0;
+}
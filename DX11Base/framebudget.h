@@ -0,0 +1,54 @@
+#pragma once
+
+
+// measures the recent frame cost and trades portal recursion depth and render texture resolution for frame time
+static class FrameBudget
+{
+public:
+	static void Init();
+	static void Uninit();
+
+	// the cpu time runs from the start of the update to the end of the frame, so visibility and cascade fitting count too
+	static void BeginUpdate();
+
+	// wrap everything rendered in a frame, called by the manager
+	static void BeginFrame();
+	static void EndFrame();
+
+	static void Enable(bool enable) { m_enabled = enable; }
+	static bool IsEnabled() { return m_enabled; }
+
+	// bounds the controller stays within, the max depth is the depth the render passes were built for
+	static void SetTargetFrameTime(float milliseconds) { m_targetFrameTime = milliseconds; }
+	static void SetMaxRecursionDepth(int depth);
+	static void SetMinRecursionDepth(int depth) { m_minDepth = depth; }
+	static void SetResolutionScaleRange(float minScale, float maxScale) { m_minScale = minScale; m_maxScale = maxScale; }
+
+	// current quality, full quality when the controller is disabled
+	static int GetRecursionDepth() { return m_enabled ? m_depth : m_maxDepth; }
+	static float GetResolutionScale() { return m_enabled ? m_scale : 1.0f; }
+
+	// smoothed frame times in milliseconds, the cpu time covers the update and the draw
+	static float GetCpuFrameTime() { return m_cpuFrameTime; }
+	static float GetGpuFrameTime() { return m_gpuFrameTime; }
+
+private:
+	static const int QUERY_LATENCY = 3;						// frames to wait before reading the gpu timestamps back
+
+	static ID3D11Query* m_disjointQuery[QUERY_LATENCY];
+	static ID3D11Query* m_beginQuery[QUERY_LATENCY];
+	static ID3D11Query* m_endQuery[QUERY_LATENCY];
+	static int m_frame;
+	static LARGE_INTEGER m_cpuFrequency, m_cpuBegin;
+
+	static bool m_enabled;
+	static float m_targetFrameTime;
+	static float m_cpuFrameTime, m_gpuFrameTime;
+	static int m_framesSinceChange;
+
+	static int m_depth, m_minDepth, m_maxDepth;
+	static float m_scale, m_minScale, m_maxScale;
+
+	static void ReadGpuTime(int index);
+	static void AdjustQuality();
+};
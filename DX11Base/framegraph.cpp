@@ -0,0 +1,107 @@
+#include "pch.h"
+#include <algorithm>
+#include <numeric>
+#include "framegraph.h"
+
+// the back buffer is the output of the frame, everything else only lives for as long as a pass reads it
+#define BACK_BUFFER_ID 1
+
+
+std::vector<CompiledPass> FrameGraph::m_executionOrder;
+std::vector<TargetLifetime> FrameGraph::m_lifetimes;
+int FrameGraph::m_culledNum = 0;
+int FrameGraph::m_redundantClearNum = 0;
+
+
+void FrameGraph::Compile(const std::vector<RenderPass>& renderPasses)
+{
+	m_executionOrder.clear();
+	m_lifetimes.clear();
+	m_culledNum = 0;
+	m_redundantClearNum = 0;
+
+	// order by priority, passes of the same priority keep the order they were added in
+	std::vector<int> order(renderPasses.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return renderPasses[a].priority < renderPasses[b].priority; });
+
+	// walk back from the output, a pass is needed when a later pass reads one of its targets before it gets cleared,
+	// drawing without a clear keeps what was in the target so the passes before it stay needed as well
+	bool needed[TARGET_NUM] = {};
+	needed[BACK_BUFFER_ID] = true;
+
+	std::vector<bool> keep(renderPasses.size(), false);
+	for (auto it = order.rbegin(); it != order.rend(); ++it)
+	{
+		const RenderPass& renderPass = renderPasses[*it];
+		if (renderPass.skip)
+			continue;
+
+		// passes that only write depth are kept, the graph doesnt know who reads it
+		bool used = renderPass.targetOutput.empty();
+		for (uint8_t target : renderPass.targetOutput)
+			used |= needed[target];
+
+		if (!used)
+			continue;
+
+		keep[*it] = true;
+		if (renderPass.clearRTV)
+			for (uint8_t target : renderPass.targetOutput)
+				needed[target] = false;
+		for (uint8_t target : renderPass.targetInput)
+			needed[target] = true;
+	}
+
+	// work out the clears and how long every target holds content
+	bool written[TARGET_NUM] = {};
+	int firstUse[TARGET_NUM], lastUse[TARGET_NUM];
+	std::fill(std::begin(firstUse), std::end(firstUse), -1);
+	std::fill(std::begin(lastUse), std::end(lastUse), -1);
+
+	for (int i : order)
+	{
+		const RenderPass& renderPass = renderPasses[i];
+		if (!keep[i])
+		{
+			++m_culledNum;
+			continue;
+		}
+
+		CompiledPass compiled = { i, false, renderPass.clearDepth, renderPass.clearStencil };
+		bool loads = false;
+		for (uint8_t target : renderPass.targetOutput)
+		{
+			if (!written[target])
+			{
+				compiled.clearRTV = true;
+				m_redundantClearNum += renderPass.clearRTV ? 1 : 0;
+			}
+			else if (renderPass.clearRTV)
+				compiled.clearRTV = true;
+			else
+				loads = true;
+		}
+
+		// the clear is done for every target of the pass, a pass mixing cleared and kept targets has to be split
+		assert(!(compiled.clearRTV && loads));
+
+		int position = (int)m_executionOrder.size();
+		for (uint8_t target : renderPass.targetOutput)
+		{
+			written[target] = true;
+			if (firstUse[target] < 0)
+				firstUse[target] = position;
+			lastUse[target] = position;
+		}
+		for (uint8_t target : renderPass.targetInput)
+			lastUse[target] = std::max(lastUse[target], position);
+
+		m_executionOrder.push_back(compiled);
+	}
+
+	// the back buffer lives for the whole frame, only the transient targets get an interval
+	for (int target = 0; target < TARGET_NUM; ++target)
+		if (target != BACK_BUFFER_ID && firstUse[target] >= 0)
+			m_lifetimes.push_back({ (uint8_t)target, firstUse[target], lastUse[target] });
+}
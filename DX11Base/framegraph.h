@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pass.h"
+
+
+// a declared render pass the frame graph decided to run, with the clears it worked out
+struct CompiledPass
+{
+	int index;						// into the render passes of the manager
+	bool clearRTV;
+	bool clearDepth, clearStencil;
+};
+
+// the range of the execution order a transient target holds content in, from the pass writing it first to the last pass reading or writing it
+struct TargetLifetime
+{
+	uint8_t target;
+	int firstUse, lastUse;
+};
+
+// turns the declared render passes into what runs this frame, the passes are ordered by priority,
+// culled when they are skipped or nothing reads what they write, and each target is cleared by the first pass writing it
+static class FrameGraph
+{
+public:
+	// called by the manager once a frame before drawing, after the owners of the passes updated them
+	static void Compile(const std::vector<RenderPass>& renderPasses);
+	static const std::vector<CompiledPass>& GetExecutionOrder() { return m_executionOrder; }
+
+	// stats of the last compile
+	static int GetCulledNum() { return m_culledNum; }
+	static int GetRedundantClearNum() { return m_redundantClearNum; }	// declared clears of targets nothing wrote to before
+	static const std::vector<TargetLifetime>& GetLifetimes() { return m_lifetimes; }
+
+private:
+	static const int TARGET_NUM = 256;
+
+	static std::vector<CompiledPass> m_executionOrder;
+	static std::vector<TargetLifetime> m_lifetimes;
+	static int m_culledNum, m_redundantClearNum;
+};
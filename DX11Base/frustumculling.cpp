@@ -1,12 +1,39 @@
 #include "pch.h"
+#include <float.h>
 #include "frustumculling.h"
 
 
-dx::XMFLOAT4 FrustumCulling::m_planes[6];
+Frustum FrustumCulling::m_frustum;
+
+
+void BoundingBoxList::Add(const dx::XMFLOAT3& center, const dx::XMFLOAT3& extents)
+{
+	// grow by 4 so the culling loop never reads past the end, padded boxes are ignored
+	if (centerX.size() <= count)
+	{
+		size_t size = count + 4;
+		centerX.resize(size, 0.0f); centerY.resize(size, 0.0f); centerZ.resize(size, 0.0f);
+		extentX.resize(size, 0.0f); extentY.resize(size, 0.0f); extentZ.resize(size, 0.0f);
+	}
+
+	centerX[count] = center.x;
+	centerY[count] = center.y;
+	centerZ[count] = center.z;
+	extentX[count] = extents.x;
+	extentY[count] = extents.y;
+	extentZ[count] = extents.z;
+	++count;
+}
 
 
 void FrustumCulling::ConstructFrustum(float screenDepth, const dx::XMMATRIX& projectionMatrix, const dx::XMMATRIX& viewMatrix)
 {
+	ConstructFrustum(m_frustum, screenDepth, projectionMatrix, viewMatrix);
+}
+
+void FrustumCulling::ConstructFrustum(Frustum& frustum, float screenDepth, const dx::XMMATRIX& projectionMatrix, const dx::XMMATRIX& viewMatrix)
+{
+	dx::XMFLOAT4* planes = frustum.planes;
 	float zMinimum, r;
 	dx::XMMATRIX matrix;
 	dx::XMFLOAT4X4 fMatrix;
@@ -28,48 +55,105 @@ void FrustumCulling::ConstructFrustum(float screenDepth, const dx::XMMATRIX& pro
 	dx::XMStoreFloat4x4(&fMatrix, matrix);
 
 	// calculate near plane of frustum
-	m_planes[0].x = fMatrix._14 + fMatrix._13;
-	m_planes[0].y = fMatrix._24 + fMatrix._23;
-	m_planes[0].z = fMatrix._34 + fMatrix._33;
-	m_planes[0].w = fMatrix._44 + fMatrix._43;
+	planes[0].x = fMatrix._14 + fMatrix._13;
+	planes[0].y = fMatrix._24 + fMatrix._23;
+	planes[0].z = fMatrix._34 + fMatrix._33;
+	planes[0].w = fMatrix._44 + fMatrix._43;
 	
 	// calculate far plane of frustum
-	m_planes[1].x = fMatrix._14 - fMatrix._13;
-	m_planes[1].y = fMatrix._24 - fMatrix._23;
-	m_planes[1].z = fMatrix._34 - fMatrix._33;
-	m_planes[1].w = fMatrix._44 - fMatrix._43;
+	planes[1].x = fMatrix._14 - fMatrix._13;
+	planes[1].y = fMatrix._24 - fMatrix._23;
+	planes[1].z = fMatrix._34 - fMatrix._33;
+	planes[1].w = fMatrix._44 - fMatrix._43;
 
 	// calculate left plane of frustum
-	m_planes[2].x = fMatrix._14 + fMatrix._11;
-	m_planes[2].y = fMatrix._24 + fMatrix._21;
-	m_planes[2].z = fMatrix._34 + fMatrix._31;
-	m_planes[2].w = fMatrix._44 + fMatrix._41;
+	planes[2].x = fMatrix._14 + fMatrix._11;
+	planes[2].y = fMatrix._24 + fMatrix._21;
+	planes[2].z = fMatrix._34 + fMatrix._31;
+	planes[2].w = fMatrix._44 + fMatrix._41;
 
 	// calculate right plane of frustum
-	m_planes[3].x = fMatrix._14 - fMatrix._11;
-	m_planes[3].y = fMatrix._24 - fMatrix._21;
-	m_planes[3].z = fMatrix._34 - fMatrix._31;
-	m_planes[3].w = fMatrix._44 - fMatrix._41;
+	planes[3].x = fMatrix._14 - fMatrix._11;
+	planes[3].y = fMatrix._24 - fMatrix._21;
+	planes[3].z = fMatrix._34 - fMatrix._31;
+	planes[3].w = fMatrix._44 - fMatrix._41;
 
 	// calculate top plane of frustum
-	m_planes[4].x = fMatrix._14 - fMatrix._12;
-	m_planes[4].y = fMatrix._24 - fMatrix._22;
-	m_planes[4].z = fMatrix._34 - fMatrix._32;
-	m_planes[4].w = fMatrix._44 - fMatrix._42;
+	planes[4].x = fMatrix._14 - fMatrix._12;
+	planes[4].y = fMatrix._24 - fMatrix._22;
+	planes[4].z = fMatrix._34 - fMatrix._32;
+	planes[4].w = fMatrix._44 - fMatrix._42;
 
 	// calculate bottom plane of frustum
-	m_planes[5].x = fMatrix._14 + fMatrix._12;
-	m_planes[5].y = fMatrix._24 + fMatrix._22;
-	m_planes[5].z = fMatrix._34 + fMatrix._32;
-	m_planes[5].w = fMatrix._44 + fMatrix._42;
+	planes[5].x = fMatrix._14 + fMatrix._12;
+	planes[5].y = fMatrix._24 + fMatrix._22;
+	planes[5].z = fMatrix._34 + fMatrix._32;
+	planes[5].w = fMatrix._44 + fMatrix._42;
 
 	// normalize the planes
 	for (int i = 0; i < 6; ++i)
 	{
-		dx::XMVECTOR temp = dx::XMLoadFloat4(&m_planes[i]);
+		dx::XMVECTOR temp = dx::XMLoadFloat4(&planes[i]);
 		temp = dx::XMPlaneNormalize(temp);
-		dx::XMStoreFloat4(&m_planes[i], temp);
+		dx::XMStoreFloat4(&planes[i], temp);
+	}
+}
+
+void FrustumCulling::ConstructFrustum(Frustum& frustum, const dx::XMMATRIX& viewProjectionMatrix, const ScreenRect& rect)
+{
+	dx::XMMATRIX transposed = dx::XMMatrixTranspose(viewProjectionMatrix);
+	dx::XMVECTOR x = transposed.r[0];
+	dx::XMVECTOR y = transposed.r[1];
+	dx::XMVECTOR z = transposed.r[2];
+	dx::XMVECTOR w = transposed.r[3];
+
+	// near and far plane straight from the matrix so the oblique near plane of portals is used
+	dx::XMVECTOR planes[6];
+	planes[0] = z;
+	planes[1] = dx::XMVectorSubtract(w, z);
+
+	// side planes go through the edges of the rectangle
+	planes[2] = dx::XMVectorSubtract(x, dx::XMVectorScale(w, rect.minX));
+	planes[3] = dx::XMVectorSubtract(dx::XMVectorScale(w, rect.maxX), x);
+	planes[4] = dx::XMVectorSubtract(dx::XMVectorScale(w, rect.maxY), y);
+	planes[5] = dx::XMVectorSubtract(y, dx::XMVectorScale(w, rect.minY));
+
+	for (int i = 0; i < 6; ++i)
+		dx::XMStoreFloat4(&frustum.planes[i], dx::XMPlaneNormalize(planes[i]));
+}
+
+ScreenRect FrustumCulling::ProjectBox(const dx::XMFLOAT3& center, const dx::XMFLOAT3& extents, const dx::XMMATRIX& worldViewProjectionMatrix)
+{
+	ScreenRect rect = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+	int behindCount = 0;
+
+	for (int i = 0; i < 8; ++i)
+	{
+		dx::XMVECTOR corner = dx::XMVectorSet(
+			center.x + (i & 1 ? extents.x : -extents.x),
+			center.y + (i & 2 ? extents.y : -extents.y),
+			center.z + (i & 4 ? extents.z : -extents.z), 1.0f);
+
+		dx::XMFLOAT4 clip;
+		dx::XMStoreFloat4(&clip, dx::XMVector4Transform(corner, worldViewProjectionMatrix));
+		if (clip.w <= 0.0001f)
+		{
+			++behindCount;
+			continue;
+		}
+
+		float x = clip.x / clip.w, y = clip.y / clip.w;
+		rect.minX = std::min(rect.minX, x); rect.minY = std::min(rect.minY, y);
+		rect.maxX = std::max(rect.maxX, x); rect.maxY = std::max(rect.maxY, y);
 	}
+
+	if (behindCount == 8)
+		return ScreenRect::Empty();
+	if (behindCount > 0)
+		return ScreenRect::FullScreen();
+
+	rect.Intersect(ScreenRect::FullScreen());
+	return rect;
 }
 
 bool FrustumCulling::CheckPoint(dx::XMVECTOR position)
@@ -78,7 +162,7 @@ bool FrustumCulling::CheckPoint(dx::XMVECTOR position)
 	for (int i = 0; i < 6; ++i)
 	{
 		dx::XMVECTOR plane;
-		plane = dx::XMLoadFloat4(&m_planes[i]);
+		plane = dx::XMLoadFloat4(&m_frustum.planes[i]);
 
 		if (dx::XMVectorGetX(dx::XMPlaneDotCoord(plane, position)) < 0.0F)
 		{
@@ -95,7 +179,7 @@ bool FrustumCulling::CheckSphere(dx::XMVECTOR position, float radius)
 	for (int i = 0; i < 6; ++i)
 	{
 		dx::XMVECTOR plane;
-		plane = dx::XMLoadFloat4(&m_planes[i]);
+		plane = dx::XMLoadFloat4(&m_frustum.planes[i]);
 
 		if (dx::XMVectorGetX(dx::XMPlaneDotCoord(plane, position)) < -radius)
 		{
@@ -105,3 +189,56 @@ bool FrustumCulling::CheckSphere(dx::XMVECTOR position, float radius)
 
 	return true;
 }
+
+void FrustumCulling::CullBoxes(const Frustum& frustum, const BoundingBoxList& boxes, std::vector<uint32_t>& visibleMask)
+{
+	visibleMask.assign((boxes.count + 31) / 32, 0);
+
+	// splat the planes once, the absolute normal is used for the projected box radius
+	dx::XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	dx::XMVECTOR absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = dx::XMVectorReplicate(frustum.planes[p].x);
+		planeY[p] = dx::XMVectorReplicate(frustum.planes[p].y);
+		planeZ[p] = dx::XMVectorReplicate(frustum.planes[p].z);
+		planeW[p] = dx::XMVectorReplicate(frustum.planes[p].w);
+		absX[p] = dx::XMVectorAbs(planeX[p]);
+		absY[p] = dx::XMVectorAbs(planeY[p]);
+		absZ[p] = dx::XMVectorAbs(planeZ[p]);
+	}
+
+	for (size_t i = 0; i < boxes.count; i += 4)
+	{
+		dx::XMVECTOR cx = dx::XMLoadFloat4((const dx::XMFLOAT4*)&boxes.centerX[i]);
+		dx::XMVECTOR cy = dx::XMLoadFloat4((const dx::XMFLOAT4*)&boxes.centerY[i]);
+		dx::XMVECTOR cz = dx::XMLoadFloat4((const dx::XMFLOAT4*)&boxes.centerZ[i]);
+		dx::XMVECTOR ex = dx::XMLoadFloat4((const dx::XMFLOAT4*)&boxes.extentX[i]);
+		dx::XMVECTOR ey = dx::XMLoadFloat4((const dx::XMFLOAT4*)&boxes.extentY[i]);
+		dx::XMVECTOR ez = dx::XMLoadFloat4((const dx::XMFLOAT4*)&boxes.extentZ[i]);
+
+		// the box is outside if it is completely behind any of the planes
+		dx::XMVECTOR inside = dx::XMVectorTrueInt();
+		for (int p = 0; p < 6; ++p)
+		{
+			dx::XMVECTOR distance = dx::XMVectorMultiplyAdd(cx, planeX[p], planeW[p]);
+			distance = dx::XMVectorMultiplyAdd(cy, planeY[p], distance);
+			distance = dx::XMVectorMultiplyAdd(cz, planeZ[p], distance);
+
+			dx::XMVECTOR radius = dx::XMVectorMultiply(ex, absX[p]);
+			radius = dx::XMVectorMultiplyAdd(ey, absY[p], radius);
+			radius = dx::XMVectorMultiplyAdd(ez, absZ[p], radius);
+
+			inside = dx::XMVectorAndInt(inside, dx::XMVectorGreaterOrEqual(distance, dx::XMVectorNegate(radius)));
+		}
+
+		// write the 4 results into the bitmask
+		uint32_t result[4];
+		dx::XMStoreInt4(result, inside);
+		for (size_t j = 0; j < 4 && i + j < boxes.count; ++j)
+		{
+			if (result[j])
+				visibleMask[(i + j) >> 5] |= 1u << ((i + j) & 31);
+		}
+	}
+}
@@ -1,20 +1,70 @@
 #pragma once
 
+#include <algorithm>
 #include "camera.h"
 
 
+// axis aligned boxes as structure of arrays, padded to a multiple of 4 for simd culling
+struct BoundingBoxList
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	size_t count = 0;
+
+	void Clear() { count = 0; }
+	void Add(const dx::XMFLOAT3& center, const dx::XMFLOAT3& extents);
+};
+
+// six normalized planes pointing into the frustum
+struct Frustum
+{
+	dx::XMFLOAT4 planes[6];
+};
+
+// rectangle on screen in normalized device coordinates
+struct ScreenRect
+{
+	float minX, minY, maxX, maxY;
+
+	static ScreenRect FullScreen() { return { -1.0f, -1.0f, 1.0f, 1.0f }; }
+	static ScreenRect Empty() { return { 0.0f, 0.0f, 0.0f, 0.0f }; }
+
+	bool IsEmpty() const { return minX >= maxX || minY >= maxY; }
+	void Intersect(const ScreenRect& other)
+	{
+		minX = std::max(minX, other.minX); minY = std::max(minY, other.minY);
+		maxX = std::min(maxX, other.maxX); maxY = std::min(maxY, other.maxY);
+	}
+};
+
 static class FrustumCulling
 {
 public:
 	// called every frame in camera.cpp
 	static void ConstructFrustum(float screenDepth, const dx::XMMATRIX& projectionMatrix, const dx::XMMATRIX& viewMatrix);
 
+	// build the frustum of any view, used for the render passes that dont look through the main camera
+	static void ConstructFrustum(Frustum& frustum, float screenDepth, const dx::XMMATRIX& projectionMatrix, const dx::XMMATRIX& viewMatrix);
+
+	// frustum of a view projection narrowed to a rectangle on screen, an oblique near plane is kept as it is
+	static void ConstructFrustum(Frustum& frustum, const dx::XMMATRIX& viewProjectionMatrix, const ScreenRect& rect);
+
+	// screen bounds of a local box, empty if the box is behind the camera and full screen if it crosses the camera plane
+	static ScreenRect ProjectBox(const dx::XMFLOAT3& center, const dx::XMFLOAT3& extents, const dx::XMMATRIX& worldViewProjectionMatrix);
+	static const Frustum& GetFrustum() { return m_frustum; }
+
 	// check if the given point is inside the camera frustum
 	static bool CheckPoint(dx::XMVECTOR position);
 
 	// check if the given sphere is inside the camera frustum
 	static bool CheckSphere(dx::XMVECTOR position, float radius);
 
+	// test 4 boxes at a time against the frustum, bit i of the mask is set if box i is visible
+	static void CullBoxes(const Frustum& frustum, const BoundingBoxList& boxes, std::vector<uint32_t>& visibleMask);
+	static void CullBoxes(const BoundingBoxList& boxes, std::vector<uint32_t>& visibleMask) { CullBoxes(m_frustum, boxes, visibleMask); }
+
+	static bool IsVisible(const std::vector<uint32_t>& visibleMask, size_t index) { return (visibleMask[index >> 5] >> (index & 31)) & 1; }
+
 private:
-	static dx::XMFLOAT4 m_planes[6];
+	static Frustum m_frustum;
 };
@@ -2,10 +2,20 @@
 
 #include "pass.h"
 
+// objects drawing the same model at the same level of detail can share one instanced draw, batching is per model only,
+// the first object of a group sets the material for all of them so objects of one model have to draw it with the same material
+struct InstanceKey
+{
+	const class Model* model;
+	uint32_t lod;
+
+	bool operator==(const InstanceKey& other) const { return model == other.model && lod == other.lod; }
+};
 
 class GameObject
 {
 	friend class Scene;
+	friend class Visibility;
 
 public:
 	GameObject() {}
@@ -17,7 +27,9 @@ public:
 		m_destroy = false;
 		m_draw = true;
 		m_enableFrustumCulling = true;
+		m_hasBounds = false;
 		m_disableUpdate = false;
+		m_passMask = m_shaderPassMask = PASS_MASK_ALL;
 
 		m_position = dx::XMFLOAT3(0, 0, 0);
 		m_oldPosition = m_position;
@@ -30,19 +42,25 @@ public:
 	virtual void Uninit() {}
 	virtual void Update() {}
 	virtual void LateUpdate() {}
-	virtual void Draw(Pass pass) 
-	{
-		// update the old position
-		m_oldPosition = m_position;
-	};
-	virtual void Draw(const std::shared_ptr<class Shader>& shader, Pass pass)
-	{
-		// update the old position
-		m_oldPosition = m_position;
-	}
+	// passes may be drawn on several threads at once, drawing must not change the object
+	virtual void Draw(Pass pass) {}
+	virtual void Draw(const std::shared_ptr<class Shader>& shader, Pass pass) {}
+
+	// called instead of Draw by the instance batcher, return false to be drawn the normal way,
+	// otherwise do the part of Draw that isnt drawing and hand out the key and world matrix of the instance
+	virtual bool DrawInstance(Pass pass, InstanceKey& key, dx::XMFLOAT4X4& world) { return false; }
+	// draws a whole group of instances written to the instance buffer right before, called on the first object of the group
+	virtual void DrawInstanced(Pass pass, const InstanceKey& key, UINT instanceCount) {}
 
 	void SetParent(GameObject* parent) { m_parent = (std::shared_ptr<GameObject>)parent; }
+	// passes the object draws in with its own shader and with the override shader of the pass, the scene only visits subscribed objects
+	void SetPassMask(uint32_t passMask, uint32_t shaderPassMask) { m_passMask = passMask; m_shaderPassMask = shaderPassMask; }
+	uint32_t GetPassMask(bool overrideShader) const { return overrideShader ? m_shaderPassMask : m_passMask; }
+	bool IsSubscribed(Pass pass, bool overrideShader) const { return (GetPassMask(overrideShader) & PassBit(pass)) != 0; }
+
 	void EnableFrustumCulling(bool enable) { m_enableFrustumCulling = enable; }
+	virtual bool IsCullable() const { return m_enableFrustumCulling; }
+	void SetLocalBounds(dx::XMFLOAT3 center, dx::XMFLOAT3 extents) { m_boundsCenter = center; m_boundsExtents = extents; m_hasBounds = true; }
 	void SetVelocity(dx::XMFLOAT3 velocity) { m_velocity = velocity; }
 
 	dx::XMVECTOR GetPosition() const
@@ -104,6 +122,29 @@ public:
 			return scale * rot * trans;
 	}
 
+	void GetLocalBounds(dx::XMFLOAT3& center, dx::XMFLOAT3& extents) const { center = m_boundsCenter; extents = m_boundsExtents; }
+
+	// world space axis aligned box around the local bounds, objects without bounds get a 2 unit box around their position
+	void GetWorldBounds(dx::XMFLOAT3& center, dx::XMFLOAT3& extents) const
+	{
+		if (!m_hasBounds)
+		{
+			center = GetPositionFloat();
+			extents = dx::XMFLOAT3(2.0f, 2.0f, 2.0f);
+			return;
+		}
+
+		// transform the center and project the extents onto the world axes
+		dx::XMMATRIX world = GetWorldMatrix();
+		dx::XMVECTOR worldCenter = dx::XMVector3Transform(dx::XMLoadFloat3(&m_boundsCenter), world);
+		dx::XMVECTOR worldExtents = dx::XMVectorScale(dx::XMVectorAbs(world.r[0]), m_boundsExtents.x);
+		worldExtents = dx::XMVectorMultiplyAdd(dx::XMVectorAbs(world.r[1]), dx::XMVectorReplicate(m_boundsExtents.y), worldExtents);
+		worldExtents = dx::XMVectorMultiplyAdd(dx::XMVectorAbs(world.r[2]), dx::XMVectorReplicate(m_boundsExtents.z), worldExtents);
+
+		dx::XMStoreFloat3(&center, worldCenter);
+		dx::XMStoreFloat3(&extents, worldExtents);
+	}
+
 	dx::XMFLOAT3 GetForward(bool normalize = false) const
 	{
 		dx::XMFLOAT4X4 world;
@@ -166,9 +207,13 @@ protected:
 
 	std::weak_ptr<GameObject> m_parent;
 
+	dx::XMFLOAT3 m_boundsCenter, m_boundsExtents;
+
 	bool m_destroy;
 	bool m_initialized;
 	bool m_draw;
 	bool m_enableFrustumCulling;
+	bool m_hasBounds;
 	bool m_disableUpdate;
+	uint32_t m_passMask, m_shaderPassMask;
 };
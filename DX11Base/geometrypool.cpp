@@ -0,0 +1,117 @@
+#include "pch.h"
+#include <algorithm>
+#include "geometrypool.h"
+
+
+std::vector<GeometryPool::Chunk> GeometryPool::m_vertexChunks;
+std::vector<GeometryPool::Chunk> GeometryPool::m_indexChunks[2];
+UINT GeometryPool::m_vertexNum = 0;
+UINT GeometryPool::m_indexNum[2] = {};
+int GeometryPool::m_allocationNum = 0;
+
+
+void GeometryPool::Uninit()
+{
+	for (Chunk& chunk : m_vertexChunks)
+		SAFE_RELEASE(chunk.buffer);
+	m_vertexChunks.clear();
+	for (std::vector<Chunk>& chunks : m_indexChunks)
+	{
+		for (Chunk& chunk : chunks)
+			SAFE_RELEASE(chunk.buffer);
+		chunks.clear();
+	}
+
+	m_vertexNum = 0;
+	m_indexNum[0] = m_indexNum[1] = 0;
+	m_allocationNum = 0;
+}
+
+bool GeometryPool::Allocate(const VERTEX_3D_PACKED* vertices, UINT vertexNum, const void* indices, UINT indexNum, IndexFormat indexFormat, GeometryAllocation& allocation)
+{
+	int format = (int)indexFormat;
+	UINT indexSize = indexFormat == IndexFormat::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	// the space is only taken once both the vertices and the indices have a chunk
+	Chunk* vertexChunk = FindChunk(m_vertexChunks, vertexNum, sizeof(VERTEX_3D_PACKED), VERTEX_CHUNK_SIZE, D3D11_BIND_VERTEX_BUFFER);
+	if (!vertexChunk)
+		return false;
+	Chunk* indexChunk = FindChunk(m_indexChunks[format], indexNum, indexSize, INDEX_CHUNK_SIZE, D3D11_BIND_INDEX_BUFFER);
+	if (!indexChunk)
+		return false;
+
+	ID3D11DeviceContext* deviceContext = CRenderer::GetDeviceContext();
+
+	D3D11_BOX box = { sizeof(VERTEX_3D_PACKED) * vertexChunk->used, 0, 0, sizeof(VERTEX_3D_PACKED) * (vertexChunk->used + vertexNum), 1, 1 };
+	deviceContext->UpdateSubresource(vertexChunk->buffer, 0, &box, vertices, 0, 0);
+
+	box = { indexSize * indexChunk->used, 0, 0, indexSize * (indexChunk->used + indexNum), 1, 1 };
+	deviceContext->UpdateSubresource(indexChunk->buffer, 0, &box, indices, 0, 0);
+
+	allocation.vertexBuffer = vertexChunk->buffer;
+	allocation.indexBuffer = indexChunk->buffer;
+	allocation.baseVertex = vertexChunk->used;
+	allocation.vertexNum = vertexNum;
+	allocation.firstIndex = indexChunk->used;
+	allocation.indexNum = indexNum;
+	allocation.indexFormat = indexFormat;
+
+	vertexChunk->used += vertexNum;
+	indexChunk->used += indexNum;
+	m_vertexNum += vertexNum;
+	m_indexNum[format] += indexNum;
+	m_allocationNum++;
+
+	return true;
+}
+
+void GeometryPool::Free(const GeometryAllocation& allocation)
+{
+	if (--m_allocationNum > 0)
+		return;
+
+	// nothing is left, the chunks stay and are filled from the start again
+	for (Chunk& chunk : m_vertexChunks)
+		chunk.used = 0;
+	for (std::vector<Chunk>& chunks : m_indexChunks)
+		for (Chunk& chunk : chunks)
+			chunk.used = 0;
+
+	m_allocationNum = 0;
+	m_vertexNum = 0;
+	m_indexNum[0] = m_indexNum[1] = 0;
+}
+
+GeometryPool::Chunk* GeometryPool::FindChunk(std::vector<Chunk>& chunks, UINT num, UINT elementSize, UINT chunkSize, UINT bindFlags)
+{
+	for (Chunk& chunk : chunks)
+	{
+		if (num <= chunk.capacity - chunk.used)
+			return &chunk;
+	}
+
+	// default usage so later meshes can be copied in
+	Chunk chunk;
+	chunk.capacity = std::max(num, chunkSize);
+	chunk.used = 0;
+	chunk.buffer = CreateBuffer(elementSize * chunk.capacity, bindFlags);
+	if (!chunk.buffer)
+		return nullptr;
+
+	chunks.push_back(chunk);
+	return &chunks.back();
+}
+
+ID3D11Buffer* GeometryPool::CreateBuffer(UINT size, UINT bindFlags)
+{
+	D3D11_BUFFER_DESC bd;
+	ZeroMemory(&bd, sizeof(bd));
+	bd.Usage = D3D11_USAGE_DEFAULT;
+	bd.ByteWidth = size;
+	bd.BindFlags = bindFlags;
+	bd.CPUAccessFlags = 0;
+
+	ID3D11Buffer* buffer = nullptr;
+	CRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &buffer);
+	return buffer;
+}
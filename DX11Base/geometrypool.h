@@ -0,0 +1,53 @@
+#pragma once
+
+#include "renderer.h"
+
+
+// where a sub mesh was put in the shared buffers, drawn with the first index and base vertex as offsets
+struct GeometryAllocation
+{
+	ID3D11Buffer* vertexBuffer;
+	ID3D11Buffer* indexBuffer;
+	UINT baseVertex, vertexNum;
+	UINT firstIndex, indexNum;
+	IndexFormat indexFormat;
+};
+
+// shared vertex buffers and index buffers per index format every static mesh is copied into,
+// consecutive draws of different meshes then keep the same buffers bound,
+// the buffers are created in chunks as meshes are loaded so the pool is only as large as what the game uses
+static class GeometryPool
+{
+public:
+	static void Uninit();
+
+	// false when no buffer could be created for the mesh, the caller keeps its own buffers then
+	static bool Allocate(const VERTEX_3D_PACKED* vertices, UINT vertexNum, const void* indices, UINT indexNum, IndexFormat indexFormat, GeometryAllocation& allocation);
+	// the space is given back once every allocation was freed, models are only unloaded all at once
+	static void Free(const GeometryAllocation& allocation);
+
+	static UINT GetVertexNum() { return m_vertexNum; }
+	static UINT GetIndexNum(IndexFormat format) { return m_indexNum[(int)format]; }
+	static int GetAllocationNum() { return m_allocationNum; }
+
+private:
+	// elements of a new chunk, a mesh larger than that gets a chunk of its own size
+	static const UINT VERTEX_CHUNK_SIZE = 1 << 16;
+	static const UINT INDEX_CHUNK_SIZE = 1 << 18;
+
+	struct Chunk
+	{
+		ID3D11Buffer* buffer;
+		UINT capacity, used;
+	};
+
+	static std::vector<Chunk> m_vertexChunks;
+	static std::vector<Chunk> m_indexChunks[2];
+	static UINT m_vertexNum;
+	static UINT m_indexNum[2];
+	static int m_allocationNum;
+
+	// the first chunk with room for the elements, a new one is added if none has, nullptr if it couldnt be created
+	static Chunk* FindChunk(std::vector<Chunk>& chunks, UINT num, UINT elementSize, UINT chunkSize, UINT bindFlags);
+	static ID3D11Buffer* CreateBuffer(UINT size, UINT bindFlags);
+};
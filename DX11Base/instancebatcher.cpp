@@ -0,0 +1,69 @@
+#include "pch.h"
+#include "instancebatcher.h"
+#include "renderer.h"
+#include "instancingshader.h"
+
+
+bool InstanceBatcher::m_enabled = true;
+thread_local InstanceKey InstanceBatcher::m_key;
+thread_local std::vector<GameObject*> InstanceBatcher::m_group;
+thread_local std::vector<dx::XMFLOAT4X4> InstanceBatcher::m_worlds;
+std::atomic<int> InstanceBatcher::m_groupNum(0);
+std::atomic<int> InstanceBatcher::m_instanceNum(0);
+int InstanceBatcher::m_lastGroupNum = 0;
+int InstanceBatcher::m_lastInstanceNum = 0;
+
+
+void InstanceBatcher::BeginFrame()
+{
+	m_lastGroupNum = m_groupNum;
+	m_lastInstanceNum = m_instanceNum;
+	m_groupNum = 0;
+	m_instanceNum = 0;
+
+	CRenderer::GetShader<InstancingShader>()->BeginFrame();
+}
+
+void InstanceBatcher::Draw(GameObject* gameObject, Pass pass)
+{
+	InstanceKey key;
+	dx::XMFLOAT4X4 world;
+	if (!m_enabled || !gameObject->DrawInstance(pass, key, world))
+	{
+		// the group ends here so the draw order stays the same
+		Flush(pass);
+		gameObject->Draw(pass);
+		return;
+	}
+
+	if (!m_group.empty() && !(key == m_key))
+		Flush(pass);
+
+	m_key = key;
+	m_group.push_back(gameObject);
+	m_worlds.push_back(world);
+}
+
+void InstanceBatcher::Flush(Pass pass)
+{
+	if (m_group.empty())
+		return;
+
+	auto shader = CRenderer::GetShader<InstancingShader>();
+	if (m_group.size() >= MIN_GROUP_SIZE && shader->ReserveInstances((UINT)m_worlds.size()))
+	{
+		shader->WriteInstances(m_worlds.data(), (UINT)m_worlds.size());
+		m_group.front()->DrawInstanced(pass, m_key, (UINT)m_group.size());
+		m_groupNum++;
+		m_instanceNum += (int)m_group.size();
+	}
+	else
+	{
+		// too small or the instance buffer is full
+		for (GameObject* gameObject : m_group)
+			gameObject->Draw(pass);
+	}
+
+	m_group.clear();
+	m_worlds.clear();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include "gameObject.h"
+
+
+// merges runs of objects in a draw list that draw the same model the same way into one instanced draw,
+// objects opt in through GameObject::DrawInstance
+static class InstanceBatcher
+{
+public:
+	// called by the manager before the passes are drawn
+	static void BeginFrame();
+
+	// draws the object or adds it to the current group, Flush draws what is left after the last object of a pass
+	static void Draw(GameObject* gameObject, Pass pass);
+	static void Flush(Pass pass);
+
+	static void Enable(bool enable) { m_enabled = enable; }
+	static bool IsEnabled() { return m_enabled; }
+
+	// instanced draws and the objects they drew, last frame
+	static int GetGroupNum() { return m_lastGroupNum; }
+	static int GetInstanceNum() { return m_lastInstanceNum; }
+
+private:
+	static const size_t MIN_GROUP_SIZE = 2;		// a single object is cheaper to draw on its own
+
+	static bool m_enabled;
+
+	// every recording thread builds its own group
+	static thread_local InstanceKey m_key;
+	static thread_local std::vector<GameObject*> m_group;
+	static thread_local std::vector<dx::XMFLOAT4X4> m_worlds;
+	static std::atomic<int> m_groupNum, m_instanceNum;
+	static int m_lastGroupNum, m_lastInstanceNum;
+};
@@ -2,6 +2,8 @@
 Texture2D g_Texture : register( t0 );
 SamplerState g_SamplerState : register( s0 );
 
+#include "shadow.hlsli"
+
 struct LIGHT
 {
     float4 Direction;
@@ -42,34 +44,13 @@ struct PixelOut
 PixelOut main(	in float2 inTexCoord	    : TEXCOORD0,
 				in float4 inDiffuse	        : COLOR0,
 				in float4 inPosition	    : SV_POSITION,
-				in float4 inNormal		    : NORMAL0,
-                in float3 inWorldPosition   : TEXCOORD1)
+				in float4 inWorldPosition   : TEXCOORD1)
 {
+    // same as the basic light shader, the instances are never clipped by a portal
     PixelOut pixel = (PixelOut) 0;
 
-    // texture + vertex color + material color
     pixel.color = g_Texture.Sample(g_SamplerState, inTexCoord);
-    pixel.color *= inDiffuse * Material.Diffuse;
-  
-    // lighting
-    inNormal = normalize(inNormal);
-    float light = 0.5 - 0.5 * dot(Light.Direction.xyz, inNormal.xyz);
-  
-    pixel.color.rgb *= light * Light.Diffuse;
-    pixel.color.rgb += Light.Ambient;
-  
-    // specular blinn-phong
-    float3 eyev = inWorldPosition.xyz - CameraPosition.xyz;
-    eyev = normalize(eyev);
-	
-    float3 halfv = eyev + Light.Direction.xyz;
-    halfv = normalize(halfv);
-	
-    float specular = -dot(halfv, inNormal.xyz);
-    specular = saturate(specular);
-    specular = pow(specular, 60);
-	
-    pixel.color.rgb += specular * Material.Specular;
-    
+    pixel.color *= inDiffuse;
+    pixel.color.rgb *= lerp(SHADOW_DARKNESS, 1, ShadowFactor(inWorldPosition));
     return pixel;
 }
@@ -5,11 +5,6 @@
 //*****************************************************************************
 
 // }gNXobt@
-cbuffer WorldBuffer : register( b0 )
-{
-	matrix World;
-}
-
 cbuffer ViewBuffer : register( b1 )
 {
 	matrix View;
@@ -20,7 +15,13 @@ cbuffer ProjectionBuffer : register( b2 )
 	matrix Projection;
 }
 
-StructuredBuffer<float3> Position : register(t2);
+cbuffer InstanceBuffer : register(b3)
+{
+    uint InstanceOffset;
+}
+
+// world matrices of every instance drawn this frame, a draw reads from its offset on
+StructuredBuffer<float4x4> InstanceWorld : register(t2);
 
 
 //=============================================================================
@@ -35,27 +36,16 @@ void main(in float4 inPosition          : POSITION0,
 			out float2 outTexCoord      : TEXCOORD0,
 			out float4 outDiffuse       : COLOR0,
 			out float4 outPosition      : SV_POSITION,
-			out float4 outNormal        : NORMAL0,
-            out float3 outWorldPosition : TEXCOORD1)
+			out float4 outWorldPosition : TEXCOORD1)
 {
+	matrix World = InstanceWorld[InstanceOffset + inInstanceId];
+
 	matrix wvp;
 	wvp = mul(World, View);
 	wvp = mul(wvp, Projection);
-    inPosition.xyz += Position[inInstanceId];
 	outPosition = mul(inPosition, wvp);
-    
+	outWorldPosition = mul(inPosition, World);
+
 	outTexCoord = inTexCoord;
     outDiffuse = inDiffuse;
-    outWorldPosition = mul(inPosition, World);
-    
-    float4 normal;
-    normal = float4(inNormal.xyz, 0.0);
-    normal = mul(normal, World);
-    outNormal = normalize(normal);
-
-	// linear fog
-	//outDepth = 1 - saturate((80 - outPosition.w) / (80 - 0.1F));
-	
-	// exponential fog
-	//outDepth = 1 - pow(1.0 / 2.71828, outPosition.w * 0.05F);
 }
@@ -2,6 +2,7 @@
 #include <io.h>
 #include "renderer.h"
 #include "instancingshader.h"
+#include "statecache.h"
 
 
 void InstancingShader::Init()
@@ -64,6 +65,7 @@ void InstancingShader::Init()
 			buffer,
 			fsize,
 			&m_vertexLayout);
+		CreatePackedVertexLayout(buffer, fsize);
 
 		delete[] buffer;
 	}
@@ -100,41 +102,34 @@ void InstancingShader::Init()
 
 	hBufferDesc.ByteWidth = sizeof(dx::XMFLOAT4);
 	device->CreateBuffer(&hBufferDesc, NULL, &m_cameraPosBuffer);
+	device->CreateBuffer(&hBufferDesc, NULL, &m_instanceBuffer);
 
-	// structured buffer
+	// world matrices of the instances, written by the cpu every frame
 	{
-		dx::XMFLOAT3* pos = new dx::XMFLOAT3[10000];
-		int i = 0;
-		for (int x = 0; x < 100; ++x)
-		{
-			for (int z = 0; z < 100; ++z)
-			{
-				pos[i] = dx::XMFLOAT3(x, 1.0f, z);
-				++i;
-			}
-		}
-
 		ZeroMemory(&hBufferDesc, sizeof(hBufferDesc));
-		hBufferDesc.ByteWidth = sizeof(dx::XMFLOAT3) * 10000;
-		hBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		hBufferDesc.ByteWidth = sizeof(dx::XMFLOAT4X4) * MAX_INSTANCES;
+		hBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
 		hBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-		hBufferDesc.StructureByteStride = sizeof(dx::XMFLOAT3);
+		hBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		hBufferDesc.StructureByteStride = sizeof(dx::XMFLOAT4X4);
 		hBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-
-		D3D11_SUBRESOURCE_DATA sd;
-		ZeroMemory(&sd, sizeof(sd));
-		sd.pSysMem = pos;
-		CRenderer::GetDevice()->CreateBuffer(&hBufferDesc, &sd, &m_positionBuffer);
-
-		delete[] pos;
+		CRenderer::GetDevice()->CreateBuffer(&hBufferDesc, NULL, &m_instanceWorldBuffer);
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC srvd;
 		ZeroMemory(&srvd, sizeof(srvd));
 		srvd.Format = DXGI_FORMAT_UNKNOWN;
 		srvd.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
 		srvd.Buffer.FirstElement = 0;
-		srvd.Buffer.NumElements = 10000;
-		CRenderer::GetDevice()->CreateShaderResourceView(m_positionBuffer, &srvd, &m_positionSRV);
+		srvd.Buffer.NumElements = MAX_INSTANCES;
+		CRenderer::GetDevice()->CreateShaderResourceView(m_instanceWorldBuffer, &srvd, &m_instanceSRV);
+
+		// appending without overwriting a dynamic buffer read through a view came with d3d 11.1,
+		// older runtimes discard and write everything appended this frame again
+		D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+		if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+			m_noOverwrite = options.MapNoOverwriteOnDynamicBufferSRV != FALSE;
+		if (!m_noOverwrite)
+			m_instances.resize(MAX_INSTANCES);
 	}
 
 	UpdateConstantBuffers();
@@ -151,6 +146,53 @@ void InstancingShader::Uninit()
 {
 	Shader::Uninit();
 
-	SAFE_RELEASE(m_positionBuffer);
-	SAFE_RELEASE(m_positionSRV);
+	SAFE_RELEASE(m_instanceBuffer);
+	SAFE_RELEASE(m_instanceWorldBuffer);
+	SAFE_RELEASE(m_instanceSRV);
+}
+
+bool InstancingShader::ReserveInstances(UINT count)
+{
+	UINT reserved = m_reservedNum;
+	do
+	{
+		if (reserved + count > MAX_INSTANCES)
+			return false;
+	} while (!m_reservedNum.compare_exchange_weak(reserved, reserved + count));
+
+	return true;
+}
+
+void InstancingShader::UploadInstances(const dx::XMFLOAT4X4* worlds, UINT count)
+{
+	// every write was reserved this frame, so it fits behind the ones executed before it
+	assert(m_instanceHead + count <= MAX_INSTANCES);
+
+	// the draws executed earlier this frame still read what is behind the head, so only the first write discards
+	D3D11_MAP mapType = m_instanceHead == 0 || !m_noOverwrite ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	D3D11_MAPPED_SUBRESOURCE msr;
+	if (FAILED(CRenderer::GetDeviceContext()->Map(m_instanceWorldBuffer, 0, mapType, 0, &msr)) || !msr.pData)
+		return;
+
+	dx::XMFLOAT4X4* instances = (dx::XMFLOAT4X4*)msr.pData;
+	if (m_noOverwrite)
+	{
+		for (UINT i = 0; i < count; ++i)
+			dx::XMStoreFloat4x4(&instances[m_instanceHead + i], dx::XMMatrixTranspose(dx::XMLoadFloat4x4(&worlds[i])));
+	}
+	else
+	{
+		// discarding hands out fresh memory, the draws executed earlier read the matrices from there too
+		for (UINT i = 0; i < count; ++i)
+			dx::XMStoreFloat4x4(&m_instances[m_instanceHead + i], dx::XMMatrixTranspose(dx::XMLoadFloat4x4(&worlds[i])));
+		memcpy(instances, m_instances.data(), sizeof(dx::XMFLOAT4X4) * (m_instanceHead + count));
+	}
+
+	CRenderer::GetDeviceContext()->Unmap(m_instanceWorldBuffer, 0);
+
+	// the next instanced draw starts reading at the first matrix written here
+	UINT first = m_instanceHead;
+	m_instanceHead += count;
+	if (StateCache::UpdateConstantBuffer(m_instanceBuffer, &first, sizeof(first)))
+		ConstantRing::Update(m_instanceBuffer, &first, sizeof(first));
 }
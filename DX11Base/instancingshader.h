@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include "shader.h"
+#include "shadowcache.h"
 
 
 class InstancingShader : public Shader
@@ -17,70 +19,96 @@ public:
 		deviceContext->IASetInputLayout(m_vertexLayout);
 
 		// set constant buffers
-		deviceContext->VSSetConstantBuffers(0, 1, &m_worldBuffer);
-		deviceContext->VSSetConstantBuffers(1, 1, &m_viewBuffer);
-		deviceContext->VSSetConstantBuffers(2, 1, &m_projectionBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 0, m_worldBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 1, m_viewBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 2, m_projectionBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 3, m_instanceBuffer);
+
+		ConstantRing::Bind(ShaderStage::Pixel, 0, m_lightBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 1, m_materialBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 2, m_cameraPosBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 3, ShadowCache::GetConstantBuffer());
+
+		deviceContext->VSSetShaderResources(2, 1, &m_instanceSRV);
+
+		// shadow map of the directional light, same slots as the basic light shader
+		ID3D11ShaderResourceView* shadowMap = ShadowCache::GetShadowMap();
+		ID3D11SamplerState* shadowSampler = ShadowCache::GetSampler();
+		deviceContext->PSSetShaderResources(1, 1, &shadowMap);
+		deviceContext->PSSetSamplers(1, 1, &shadowSampler);
+	}
 
-		deviceContext->PSSetConstantBuffers(0, 1, &m_lightBuffer);
-		deviceContext->PSSetConstantBuffers(1, 1, &m_materialBuffer);
-		deviceContext->PSSetConstantBuffers(2, 1, &m_cameraPosBuffer);
+	// the instance buffer is filled from the start again every frame
+	void BeginFrame() { m_instanceHead = 0; m_reservedNum = 0; }
 
-		SetPositionShaderResources();
-	}
+	// makes room for world matrices this frame, false if the buffer is full, passes recorded on worker threads reserve at the same time
+	bool ReserveInstances(UINT count);
 
-	void SetPositionShaderResources()
-	{
-		CRenderer::GetDeviceContext()->VSSetShaderResources(2, 1, &m_positionSRV);
-	}
+	// records the world matrices of the next instanced draw, they are written to the instance buffer when the pass is executed
+	// so no recording thread touches the immediate context
+	void WriteInstances(const dx::XMFLOAT4X4* worlds, UINT count) { CRenderer::WriteInstances(this, worlds, count); }
+
+	// called by the backend on the main thread, appends the matrices and points the draws after it at them
+	void UploadInstances(const dx::XMFLOAT4X4* worlds, UINT count);
 
 	void SetWorldMatrix(dx::XMMATRIX *WorldMatrix) override
 	{
 		dx::XMMATRIX world = *WorldMatrix;
 		world = dx::XMMatrixTranspose(world);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_worldBuffer, 0, NULL, &world, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_worldBuffer, &world, sizeof(world));
 	}
 
 	void SetViewMatrix(dx::XMMATRIX *ViewMatrix) override
 	{
 		dx::XMMATRIX view = *ViewMatrix;
 		view = dx::XMMatrixTranspose(view);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_viewBuffer, 0, NULL, &view, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_viewBuffer, &view, sizeof(view));
 	}
 
 	void SetProjectionMatrix(dx::XMMATRIX *ProjectionMatrix) override
 	{
 		dx::XMMATRIX projection = *ProjectionMatrix;
 		projection = dx::XMMatrixTranspose(projection);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_projectionBuffer, 0, NULL, &projection, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_projectionBuffer, &projection, sizeof(projection));
 	}
 
 	void SetMaterial(MATERIAL Material) override
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_materialBuffer, 0, NULL, &Material, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_materialBuffer, &Material, sizeof(Material));
 	}
 
 	void SetDirectionalLight(DirectionalLight* Light) override
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_lightBuffer, 0, NULL, Light, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_lightBuffer, Light, sizeof(*Light));
 	}
 
 	void SetCameraPosition(dx::XMFLOAT3* cameraPosition) override
 	{
 		dx::XMFLOAT4 cam = dx::XMFLOAT4(cameraPosition->x, cameraPosition->y, cameraPosition->z, 1);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_cameraPosBuffer, 0, NULL, &cam, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_cameraPosBuffer, &cam, sizeof(cam));
 	}
 
 	void SetTexture(ID3D11ShaderResourceView* texture) override
 	{
-		CRenderer::GetDeviceContext()->PSSetShaderResources(0, 1, &texture);
+		CRenderer::SetShaderResource(ShaderStage::Pixel, 0, texture);
 	}
 
 	void SetSamplerState(ID3D11SamplerState* sampler) override
 	{
-		CRenderer::GetDeviceContext()->PSSetSamplers(0, 1, &sampler);
+		CRenderer::SetSampler(0, sampler);
 	}
 
 private:
-	ID3D11Buffer* m_positionBuffer;
-	ID3D11ShaderResourceView* m_positionSRV;
+	static const UINT MAX_INSTANCES = 16384;
+
+	ID3D11Buffer* m_instanceBuffer;
+	ID3D11Buffer* m_instanceWorldBuffer;
+	ID3D11ShaderResourceView* m_instanceSRV;
+	UINT m_instanceHead = 0;					// written by the backend in the order the passes run
+	std::atomic<UINT> m_reservedNum{ 0 };		// reserved by the recording threads
+
+	// false on runtimes that cannot map the instance buffer without overwriting,
+	// everything appended this frame is kept here to be written again after every discard
+	bool m_noOverwrite = false;
+	std::vector<dx::XMFLOAT4X4> m_instances;
 };
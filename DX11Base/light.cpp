@@ -1,11 +1,21 @@
 #include "pch.h"
+#include <algorithm>
+#include <float.h>
 #include "light.h"
 #include "camera.h"
 #include "manager.h"
 #include "main.h"
 
+// used while no directional light was set
+#define DEFAULT_LIGHT_DIRECTION dx::XMVectorSet(0.4f, -1.0f, 0.3f, 0.0f)
+// added around the scene bounds so a flat scene still has a volume and the casters on its edge stay inside the depth range
+#define SCENE_BOUNDS_MARGIN 0.5f
+
 
 DirectionalLight* LightManager::m_dirLight = nullptr;
+ShadowCascade LightManager::m_cascades[LightManager::CASCADE_NUM] = {};
+float LightManager::m_splitLambda = 0.75f;
+const int LightManager::FACES[6][4] = { { 0, 2, 6, 4 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 5, 7, 6 } };
 
 
 void LightManager::SetDirectionalLight(dx::XMFLOAT4 direction, dx::XMFLOAT4 diffuse, dx::XMFLOAT4 ambient)
@@ -24,22 +34,220 @@ void LightManager::SetDirectionalLight(dx::XMFLOAT4 direction, dx::XMFLOAT4 diff
 	m_dirLight->Ambient = ambient;
 }
 
+dx::XMVECTOR LightManager::GetDirection()
+{
+	if (m_dirLight)
+		return dx::XMVector3Normalize(dx::XMLoadFloat4(&m_dirLight->Direction));
+
+	return dx::XMVector3Normalize(DEFAULT_LIGHT_DIRECTION);
+}
+
 dx::XMMATRIX LightManager::GetProjectionMatrix()
 {
-	auto cam = CManager::GetActiveScene()->GetMainCamera();
-	//return dx::XMMatrixOrthographicLH(15, 15, cam->GetNearClip(), cam->GetFarClip());
-	return dx::XMMatrixPerspectiveFovLH(1.0f, (float)SCREEN_WIDTH / SCREEN_HEIGHT, 1.0f, 100.0f);
+	const RenderPass* renderPass = CManager::GetActiveRenderPass();
+	return GetProjectionMatrix(renderPass ? renderPass->cascade : 0);
 }
 
 dx::XMMATRIX LightManager::GetViewMatrix()
 {
-	dx::XMVECTOR pos = CManager::GetActiveScene()->GetMainCamera()->GetPosition();
-	dx::XMVECTOR focus = pos;
-	dx::XMVECTOR up = dx::XMVectorSet(0, 0, 1, 0);
-	
-	pos = dx::XMVectorSetY(pos, dx::XMVectorGetY(pos) + 15);
+	// no translation, the cascades are placed by their projection so their texel grid stays fixed in light space
+	dx::XMVECTOR direction = GetDirection();
+	dx::XMVECTOR up = fabsf(dx::XMVectorGetY(direction)) > 0.99f ? dx::XMVectorSet(0, 0, 1, 0) : dx::XMVectorSet(0, 1, 0, 0);
+
+	return dx::XMMatrixLookToLH(dx::XMVectorZero(), direction, up);
+}
+
+void LightManager::UpdateCascades(const dx::XMFLOAT3& sceneMin, const dx::XMFLOAT3& sceneMax)
+{
+	auto camera = CManager::GetActiveScene()->GetMainCamera();
+	if (!camera || sceneMin.x > sceneMax.x)
+	{
+		for (auto& cascade : m_cascades)
+			DisableCascade(cascade);
+		return;
+	}
+
+	dx::XMFLOAT3 sceneCorners[8];
+	for (int i = 0; i < 8; ++i)
+	{
+		sceneCorners[i].x = i & 1 ? sceneMax.x + SCENE_BOUNDS_MARGIN : sceneMin.x - SCENE_BOUNDS_MARGIN;
+		sceneCorners[i].y = i & 2 ? sceneMax.y + SCENE_BOUNDS_MARGIN : sceneMin.y - SCENE_BOUNDS_MARGIN;
+		sceneCorners[i].z = i & 4 ? sceneMax.z + SCENE_BOUNDS_MARGIN : sceneMin.z - SCENE_BOUNDS_MARGIN;
+	}
+
+	// every cascade spans the whole scene in depth so casters between the light and the receivers are drawn,
+	// the main camera only splits the part of its view depth the scene reaches
+	dx::XMMATRIX lightView = GetViewMatrix();
+	dx::XMMATRIX cameraView = camera->GetViewMatrix();
+	float nearZ = FLT_MAX, farZ = -FLT_MAX;
+	float depthMin = FLT_MAX, depthMax = -FLT_MAX;
+	for (const dx::XMFLOAT3& corner : sceneCorners)
+	{
+		dx::XMVECTOR position = dx::XMLoadFloat3(&corner);
+		float lightZ = dx::XMVectorGetZ(dx::XMVector3Transform(position, lightView));
+		float viewZ = dx::XMVectorGetZ(dx::XMVector3Transform(position, cameraView));
+		nearZ = std::min(nearZ, lightZ);
+		farZ = std::max(farZ, lightZ);
+		depthMin = std::min(depthMin, viewZ);
+		depthMax = std::max(depthMax, viewZ);
+	}
 
-	return dx::XMMatrixLookAtLH(pos, focus, up);
+	float nearClip = camera->GetNearClip();
+	float farClip = camera->GetFarClip();
+	float depthNear = std::max(nearClip, depthMin);
+	float depthFar = std::min(farClip, depthMax);
+
+	// corners of the whole frustum, a slice lies between them on the rays through the corners
+	dx::XMMATRIX inverseViewProjection = dx::XMMatrixInverse(nullptr, cameraView * camera->GetProjectionMatrix());
+	dx::XMVECTOR frustumNear[4], frustumFar[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		float x = i & 1 ? 1.0f : -1.0f;
+		float y = i & 2 ? 1.0f : -1.0f;
+		frustumNear[i] = dx::XMVector3TransformCoord(dx::XMVectorSet(x, y, 0.0f, 1.0f), inverseViewProjection);
+		frustumFar[i] = dx::XMVector3TransformCoord(dx::XMVectorSet(x, y, 1.0f, 1.0f), inverseViewProjection);
+	}
+
+	// between even and logarithmic splits, the near cascades get the detail the camera sees up close
+	auto split = [&](int i)
+	{
+		float t = (float)i / CASCADE_NUM;
+		float even = depthNear + (depthFar - depthNear) * t;
+		float logarithmic = depthNear * powf(depthFar / depthNear, t);
+		return even + (logarithmic - even) * m_splitLambda;
+	};
+
+	for (int c = 0; c < CASCADE_NUM; ++c)
+	{
+		ShadowCascade& cascade = m_cascades[c];
+		if (depthNear >= depthFar)
+		{
+			DisableCascade(cascade);
+			continue;
+		}
+
+		float splitNear = split(c);
+		float splitFar = split(c + 1);
+
+		dx::XMFLOAT3 sliceCorners[8];
+		for (int i = 0; i < 8; ++i)
+		{
+			float depth = i & 4 ? splitFar : splitNear;
+			float t = (depth - nearClip) / (farClip - nearClip);
+			dx::XMStoreFloat3(&sliceCorners[i], dx::XMVectorLerp(frustumNear[i & 3], frustumFar[i & 3], t));
+		}
+
+		FitCascade(cascade, sliceCorners, sceneCorners, lightView, nearZ, farZ);
+	}
+}
+
+void LightManager::DisableCascade(ShadowCascade& cascade)
+{
+	// maps everything behind the far plane so no receiver picks the cascade
+	cascade.valid = false;
+	dx::XMStoreFloat4x4(&cascade.projection, dx::XMMatrixScaling(0.0f, 0.0f, 0.0f) * dx::XMMatrixTranslation(0.0f, 0.0f, 2.0f));
+}
+
+void LightManager::FitCascade(ShadowCascade& cascade, const dx::XMFLOAT3 sliceCorners[8], const dx::XMFLOAT3 sceneCorners[8], const dx::XMMATRIX& lightView, float nearZ, float farZ)
+{
+	dx::XMFLOAT4 slicePlanes[6], scenePlanes[6];
+	GetFacePlanes(sliceCorners, slicePlanes);
+	GetFacePlanes(sceneCorners, scenePlanes);
+
+	// the receivers are where the slice and the scene overlap, every corner of that volume lies on a face of one of them clipped by the other
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	std::vector<dx::XMFLOAT3> polygon;
+	for (int volume = 0; volume < 2; ++volume)
+	{
+		const dx::XMFLOAT3* corners = volume == 0 ? sliceCorners : sceneCorners;
+		const dx::XMFLOAT4* planes = volume == 0 ? scenePlanes : slicePlanes;
+		for (const auto& face : FACES)
+		{
+			polygon.assign({ corners[face[0]], corners[face[1]], corners[face[2]], corners[face[3]] });
+			for (int p = 0; p < 6 && !polygon.empty(); ++p)
+				ClipPolygon(polygon, planes[p]);
+
+			for (const dx::XMFLOAT3& point : polygon)
+			{
+				dx::XMFLOAT3 light;
+				dx::XMStoreFloat3(&light, dx::XMVector3Transform(dx::XMLoadFloat3(&point), lightView));
+				minX = std::min(minX, light.x);
+				minY = std::min(minY, light.y);
+				maxX = std::max(maxX, light.x);
+				maxY = std::max(maxY, light.y);
+			}
+		}
+	}
+
+	if (minX > maxX)
+	{
+		DisableCascade(cascade);
+		return;
+	}
+
+	// square and a little larger than the receivers so they stay inside when the corner snaps down onto the texel grid
+	float extent = std::max(maxX - minX, maxY - minY);
+	extent = QuantizeExtent(extent * CASCADE_SIZE / (CASCADE_SIZE - SNAP_TEXELS));
+	float step = extent / CASCADE_SIZE * SNAP_TEXELS;
+	float left = floorf(minX / step) * step;
+	float bottom = floorf(minY / step) * step;
+
+	cascade.valid = true;
+	dx::XMStoreFloat4x4(&cascade.projection, dx::XMMatrixOrthographicOffCenterLH(left, left + extent, bottom, bottom + extent, nearZ, farZ));
+}
+
+void LightManager::GetFacePlanes(const dx::XMFLOAT3 corners[8], dx::XMFLOAT4 planes[6])
+{
+	dx::XMVECTOR center = dx::XMVectorZero();
+	for (int i = 0; i < 8; ++i)
+		center = dx::XMVectorAdd(center, dx::XMLoadFloat3(&corners[i]));
+	center = dx::XMVectorScale(center, 1.0f / 8.0f);
+
+	for (int f = 0; f < 6; ++f)
+	{
+		// the diagonals of the face, a slice whose near face is tiny still gets a normal
+		dx::XMVECTOR p0 = dx::XMLoadFloat3(&corners[FACES[f][0]]);
+		dx::XMVECTOR p1 = dx::XMLoadFloat3(&corners[FACES[f][1]]);
+		dx::XMVECTOR p2 = dx::XMLoadFloat3(&corners[FACES[f][2]]);
+		dx::XMVECTOR p3 = dx::XMLoadFloat3(&corners[FACES[f][3]]);
+		dx::XMVECTOR normal = dx::XMVector3Normalize(dx::XMVector3Cross(dx::XMVectorSubtract(p2, p0), dx::XMVectorSubtract(p3, p1)));
+		dx::XMVECTOR plane = dx::XMPlaneFromPointNormal(p0, normal);
+
+		if (dx::XMVectorGetX(dx::XMPlaneDotCoord(plane, center)) < 0.0f)
+			plane = dx::XMVectorNegate(plane);
+		dx::XMStoreFloat4(&planes[f], plane);
+	}
+}
+
+void LightManager::ClipPolygon(std::vector<dx::XMFLOAT3>& polygon, const dx::XMFLOAT4& plane)
+{
+	// points on the plane are kept, the faces of the two volumes often touch
+	static const float EPSILON = 1e-4f;
+	std::vector<dx::XMFLOAT3> clipped;
+	for (size_t i = 0; i < polygon.size(); ++i)
+	{
+		const dx::XMFLOAT3& a = polygon[i];
+		const dx::XMFLOAT3& b = polygon[(i + 1) % polygon.size()];
+		float da = plane.x * a.x + plane.y * a.y + plane.z * a.z + plane.w;
+		float db = plane.x * b.x + plane.y * b.y + plane.z * b.z + plane.w;
+
+		if (da >= -EPSILON)
+			clipped.push_back(a);
+		if ((da >= -EPSILON) != (db >= -EPSILON))
+		{
+			float t = da / (da - db);
+			clipped.push_back({ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t });
+		}
+	}
+
+	polygon.swap(clipped);
+}
+
+float LightManager::QuantizeExtent(float extent)
+{
+	extent = std::max(extent, 0.01f);
+	float step = exp2f(floorf(log2f(extent)) - 3.0f);
+	return ceilf(extent / step) * step;
 }
 
 void LightManager::UninitLighting()
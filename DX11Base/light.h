@@ -8,17 +8,58 @@ struct DirectionalLight
 	dx::XMFLOAT4	Ambient;
 };
 
+// one orthographic slice of the shadow of the directional light
+struct ShadowCascade
+{
+	dx::XMFLOAT4X4 projection;		// in light view space, fitted to the receivers of the slice and snapped to its texels
+
+	bool valid;						// false when no part of the scene is inside the slice
+};
+
 static class LightManager
 {
 public:
+	static const int CASCADE_NUM = 4;
+	static const UINT CASCADE_SIZE = 1024;		// resolution of a cascade in the shadow map
+
 	static void SetDirectionalLight(dx::XMFLOAT4 direction, dx::XMFLOAT4 diffuse, dx::XMFLOAT4 ambient);
 	static DirectionalLight* GetDirectionalLight() { return m_dirLight; }
+	static dx::XMVECTOR GetDirection();
 
-	static dx::XMMATRIX GetProjectionMatrix();
+	// rotation into light space, shared by every cascade
 	static dx::XMMATRIX GetViewMatrix();
+	// projection of the cascade the active shadow pass renders
+	static dx::XMMATRIX GetProjectionMatrix();
+	static dx::XMMATRIX GetProjectionMatrix(int cascade) { return dx::XMLoadFloat4x4(&m_cascades[cascade].projection); }
+	static const ShadowCascade& GetCascade(int cascade) { return m_cascades[cascade]; }
+
+	// splits the part of the main camera frustum inside the scene bounds into the cascades and fits each of them to its slice,
+	// called with the matrices of the frame before the shadow passes are culled
+	static void UpdateCascades(const dx::XMFLOAT3& sceneMin, const dx::XMFLOAT3& sceneMax);
+
+	// 0 splits the view depth evenly, 1 logarithmically
+	static float GetSplitLambda() { return m_splitLambda; }
+	static void SetSplitLambda(float lambda) { m_splitLambda = lambda; }
 
 	static void UninitLighting();
 
 private:
+	// the fitted bounds move in steps of this many texels, the cached static cascades only change when they step
+	static const UINT SNAP_TEXELS = 32;
+
 	static DirectionalLight* m_dirLight;
+	static ShadowCascade m_cascades[CASCADE_NUM];
+	static float m_splitLambda;
+
+	// corners of a box or a frustum slice are numbered with bit 0 for x, bit 1 for y and bit 2 for depth, a face lists four of them in order
+	static const int FACES[6][4];
+
+	static void DisableCascade(ShadowCascade& cascade);
+	static void FitCascade(ShadowCascade& cascade, const dx::XMFLOAT3 sliceCorners[8], const dx::XMFLOAT3 sceneCorners[8], const dx::XMMATRIX& lightView, float nearZ, float farZ);
+	// planes of the faces pointing into a box or slice
+	static void GetFacePlanes(const dx::XMFLOAT3 corners[8], dx::XMFLOAT4 planes[6]);
+	// keeps the part of a convex polygon in front of the plane
+	static void ClipPolygon(std::vector<dx::XMFLOAT3>& polygon, const dx::XMFLOAT4& plane);
+	// rounds up to an eighth of the power of two below, the texel size only changes when the extent grows or shrinks by a step
+	static float QuantizeExtent(float extent);
 };
@@ -0,0 +1,77 @@
+#include "pch.h"
+#include <algorithm>
+#include "main.h"
+#include "manager.h"
+#include "portalmanager.h"
+#include "lodselector.h"
+
+
+bool LodSelector::m_enabled = true;
+float LodSelector::m_detailPixels = 160.0f;
+float LodSelector::m_recursionBias = 0.5f;
+std::atomic<int> LodSelector::m_selectedNum[Model::LOD_NUM] = {};
+int LodSelector::m_lastSelectedNum[Model::LOD_NUM] = {};
+
+
+void LodSelector::BeginFrame()
+{
+	for (int lod = 0; lod < Model::LOD_NUM; ++lod)
+	{
+		m_lastSelectedNum[lod] = m_selectedNum[lod];
+		m_selectedNum[lod] = 0;
+	}
+}
+
+int LodSelector::Select(const Model& model, const dx::XMMATRIX& world)
+{
+	int lodNum = model.GetLodNum();
+	if (!m_enabled || lodNum <= 1)
+	{
+		m_selectedNum[0]++;
+		return 0;
+	}
+
+	// the view of the pass, portal passes see the model through the view of their recursion level
+	dx::XMMATRIX view, projection;
+	float viewportHeight = (float)SCREEN_HEIGHT;
+	float bias = 0.0f;
+	if (auto portal = PortalManager::GetPortal(PortalManager::GetRenderingPortal()))
+	{
+		view = portal->GetViewMatrix();
+		projection = portal->GetProjectionMatrix();
+		bias = m_recursionBias * std::max(portal->GetRecursionLevel(), 0);
+
+		// levels of the render texture technique are rendered smaller the deeper they are
+		const RenderPass* renderPass = CManager::GetActiveRenderPass();
+		if (renderPass && renderPass->scaledViewport)
+			viewportHeight = renderPass->viewport.Height;
+	}
+	else
+	{
+		view = CManager::GetViewMatrix();
+		projection = CManager::GetProjectionMatrix();
+	}
+
+	// bounding sphere of the model in world space
+	dx::XMFLOAT3 boundsCenter = model.GetBoundsCenter();
+	dx::XMFLOAT3 boundsExtents = model.GetBoundsExtents();
+	dx::XMVECTOR center = dx::XMVector3Transform(dx::XMLoadFloat3(&boundsCenter), world);
+	float scale = std::max(std::max(dx::XMVectorGetX(dx::XMVector3Length(world.r[0])), dx::XMVectorGetX(dx::XMVector3Length(world.r[1]))), dx::XMVectorGetX(dx::XMVector3Length(world.r[2])));
+	float radius = dx::XMVectorGetX(dx::XMVector3Length(dx::XMLoadFloat3(&boundsExtents))) * scale;
+
+	// the camera is inside or right next to it
+	float depth = dx::XMVectorGetZ(dx::XMVector3Transform(center, view));
+	int lod = 0;
+	if (depth > radius)
+	{
+		dx::XMFLOAT4X4 proj;
+		dx::XMStoreFloat4x4(&proj, projection);
+		float pixels = radius * proj._22 / depth * viewportHeight;
+
+		float level = log2f(m_detailPixels / std::max(pixels, 1.0f)) + bias;
+		lod = std::min(std::max((int)ceilf(level), 0), lodNum - 1);
+	}
+
+	m_selectedNum[lod]++;
+	return lod;
+}
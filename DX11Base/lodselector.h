@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include "model.h"
+
+
+// picks the level of detail a model is drawn with from its size on screen in the pass being drawn,
+// portal passes measure it with the view of their recursion level and at the resolution that level is rendered at
+static class LodSelector
+{
+public:
+	// called by the manager before the passes are drawn
+	static void BeginFrame();
+
+	// level of detail for the model drawn with the given world matrix
+	static int Select(const Model& model, const dx::XMMATRIX& world);
+
+	static void Enable(bool enable) { m_enabled = enable; }
+	static bool IsEnabled() { return m_enabled; }
+
+	// height in pixels below which a model drops to the next level, halved again for every level after
+	static float GetDetailPixels() { return m_detailPixels; }
+	static void SetDetailPixels(float pixels) { m_detailPixels = pixels; }
+
+	// levels added for every recursion level, deeper views are only seen through several openings
+	static float GetRecursionBias() { return m_recursionBias; }
+	static void SetRecursionBias(float bias) { m_recursionBias = bias; }
+
+	// models drawn at each level of detail last frame
+	static int GetSelectedNum(int lod) { return m_lastSelectedNum[lod]; }
+
+private:
+	static bool m_enabled;
+	static float m_detailPixels;
+	static float m_recursionBias;
+
+	// passes are recorded on several threads
+	static std::atomic<int> m_selectedNum[Model::LOD_NUM];
+	static int m_lastSelectedNum[Model::LOD_NUM];
+};
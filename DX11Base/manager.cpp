@@ -1,20 +1,40 @@
 #include "pch.h"
+#include <algorithm>
 #include "main.h"
 #include "manager.h"
 #include "modelmanager.h"
 #include "scenetitle.h"
 #include "scenegame.h"
 #include "debug.h"
+#include "framebudget.h"
+#include "framegraph.h"
+#include "statecache.h"
+#include "instancebatcher.h"
+#include "lodselector.h"
+#include "geometrypool.h"
+#include "shadowcache.h"
+#include "portalmanager.h"
+#include "workerpool.h"
 
 
 Scene* CManager::m_scene;
 Scene* CManager::m_nextScene;
 std::vector<RenderPass> CManager::m_renderPasses = std::vector<RenderPass>();
+thread_local int CManager::m_activeRenderPass = -1;
+dx::XMFLOAT4X4 CManager::m_view;
+dx::XMFLOAT4X4 CManager::m_projection;
+bool CManager::m_parallelRecording = true;
+int CManager::m_parallelPassNum = 0;
+int CManager::m_lastParallelPassNum = 0;
+std::vector<CommandBuffer> CManager::m_passBuffers;
 
 
 void CManager::Init()
 {
+	WorkerPool::Init();
 	CRenderer::Init();
+	ShadowCache::Init();
+	FrameBudget::Init();
 	CInput::Init();
 	Audio::Init(GetWindow());
 
@@ -44,11 +64,16 @@ void CManager::Uninit()
 	Audio::Uninit();
 	CInput::Uninit();
 	ModelManager::UnloadAllModel();
+	GeometryPool::Uninit();
+	FrameBudget::Uninit();
+	ShadowCache::Uninit();
 	CRenderer::Uninit();
+	WorkerPool::Uninit();
 }
 
 void CManager::Update()
 {
+	FrameBudget::BeginUpdate();
 	CInput::Update();
 	if (Debug::pauseUpdate)
 		return;
@@ -61,16 +86,47 @@ void CManager::Update()
 
 void CManager::Draw()
 {
-	// render every pass
-	for (int i = 0; i < m_renderPasses.size(); ++i)
+	FrameBudget::BeginFrame();
+
+	// the camera only uploads its matrices while the passes are recorded
+	auto camera = m_scene->GetMainCamera();
+	camera->UpdateMatrices();
+	dx::XMStoreFloat4x4(&m_view, camera->GetViewMatrix());
+	dx::XMStoreFloat4x4(&m_projection, camera->GetProjectionMatrix());
+
+	// the draw lists are sorted and culled with the view that is drawn, the shadow cascades follow it as well
+	// and are fitted to the gathered scene before the shadow passes are culled with them
+	m_scene->OptimizeListForRendering();
+	LightManager::UpdateCascades(m_scene->GetSceneMin(), m_scene->GetSceneMax());
+	ShadowCache::Update();
+	m_scene->CullRenderPasses();
+
+	// render the passes the frame graph decided to run, in its order
+	ShadowCache::BeginFrame();
+	FrameGraph::Compile(m_renderPasses);
+	StateCache::BeginFrame((int)m_renderPasses.size());
+	InstanceBatcher::BeginFrame();
+	LodSelector::BeginFrame();
+	m_lastParallelPassNum = m_parallelPassNum;
+	m_parallelPassNum = 0;
+
+	const std::vector<CompiledPass>& order = FrameGraph::GetExecutionOrder();
+	for (size_t first = 0; first < order.size();)
 	{
-		CRenderer::Begin(m_renderPasses[i].targetOutput, m_renderPasses[i].clearRTV, m_renderPasses[i].clearDepth, m_renderPasses[i].clearStencil, m_renderPasses[i].depthStencilView);
-
-		if (m_renderPasses[i].overrideShader)
-			m_scene->Draw(m_renderPasses[i].overrideShader, m_renderPasses[i].pass);
+		// a run of portal passes can be recorded in parallel, one thread per portal
+		size_t last = first;
+		while (m_parallelRecording && last < order.size() && GetRecordGroup(m_renderPasses[order[last].index]) >= 0)
+			++last;
+
+		if (last - first > 1)
+		{
+			DrawPassesParallel(first, last);
+			first = last;
+		}
 		else
-			m_scene->Draw(m_renderPasses[i].pass);
+			DrawPass(order[first++]);
 	}
+	m_activeRenderPass = -1;
 
 	// render imgui
 	ImGui_ImplDX11_NewFrame();
@@ -80,9 +136,102 @@ void CManager::Draw()
 	ImGui::Render();
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 
+	FrameBudget::EndFrame();
 	CRenderer::End();
 }
 
+void CManager::BeginPass(const CompiledPass& compiled)
+{
+	int i = compiled.index;
+	m_activeRenderPass = i;
+	StateCache::BeginPass(i);
+	if (m_renderPasses[i].pass == Pass::Lightmap)
+		ShadowCache::Composite();
+
+	// every pass sets its viewport, passes that dont render into a part of the target get the whole of it so no opening of a pass before stays bound
+	bool scaled = m_renderPasses[i].scaledViewport;
+	const D3D11_VIEWPORT* viewport = scaled ? &m_renderPasses[i].viewport : CRenderer::GetViewport();
+	CRenderer::Begin(m_renderPasses[i].targetOutput, compiled.clearRTV, compiled.clearDepth, compiled.clearStencil, m_renderPasses[i].depthStencilView,
+		viewport, scaled ? &m_renderPasses[i].scissor : nullptr);
+}
+
+void CManager::DrawPass(const CompiledPass& compiled)
+{
+	BeginPass(compiled);
+	DrawScene(compiled.index);
+	CRenderer::Submit();
+}
+
+void CManager::DrawPassesParallel(size_t first, size_t last)
+{
+	const std::vector<CompiledPass>& order = FrameGraph::GetExecutionOrder();
+
+	// one job per portal, a job records the passes of its portal in execution order since the portal counts its levels while drawing
+	std::vector<int> groups;
+	std::vector<std::vector<size_t>> jobs;
+	for (size_t p = first; p < last; ++p)
+	{
+		int group = GetRecordGroup(m_renderPasses[order[p].index]);
+		size_t job = std::find(groups.begin(), groups.end(), group) - groups.begin();
+		if (job == groups.size())
+		{
+			groups.push_back(group);
+			jobs.emplace_back();
+		}
+		jobs[job].push_back(p);
+	}
+
+	if (jobs.size() < 2)
+	{
+		for (size_t p = first; p < last; ++p)
+			DrawPass(order[p]);
+		return;
+	}
+
+	// objects added after the update are initialized here instead of by whichever worker draws them first
+	m_scene->InitPending();
+
+	// caches filled on first use and the recursion levels portals count while drawing are settled before the workers start
+	PortalManager::BeginParallelRecording(groups);
+
+	if (m_passBuffers.size() < order.size())
+		m_passBuffers.resize(order.size());
+
+	// the jobs are taken in order by the pool and the main thread, instance data goes into the pass buffers as well
+	// so nothing is sent to the immediate context until the passes are submitted below
+	WorkerPool::Run(jobs.size(), [&jobs, &groups, &order](size_t j)
+	{
+		for (size_t p : jobs[j])
+		{
+			CRenderer::SetRecordBuffer(&m_passBuffers[p]);
+			m_activeRenderPass = order[p].index;
+			DrawScene(order[p].index);
+		}
+		PortalManager::EndGroupRecording(groups[j]);
+
+		CRenderer::SetRecordBuffer(nullptr);
+		m_activeRenderPass = -1;
+	});
+	PortalManager::EndParallelRecording();
+
+	// the targets are switched and the recorded passes executed on the immediate context in the original order
+	for (size_t p = first; p < last; ++p)
+	{
+		BeginPass(order[p]);
+		CRenderer::Submit(m_passBuffers[p]);
+	}
+
+	m_parallelPassNum += (int)(last - first);
+}
+
+void CManager::DrawScene(int renderPass)
+{
+	if (m_renderPasses[renderPass].overrideShader)
+		m_scene->Draw(m_renderPasses[renderPass].overrideShader, m_renderPasses[renderPass].pass, renderPass);
+	else
+		m_scene->Draw(m_renderPasses[renderPass].pass, renderPass);
+}
+
 Scene* CManager::GetActiveScene()
 {
 	return m_scene;
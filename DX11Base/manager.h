@@ -3,18 +3,9 @@
 #include "renderer.h"
 #include "scene.h"
 #include "pass.h"
+#include "framegraph.h"
 
 
-struct RenderPass
-{
-	std::vector<uint8_t> targetOutput;
-	Pass pass;
-	std::shared_ptr<class Shader> overrideShader;
-	bool clearRTV;
-	bool clearDepth, clearStencil;
-	ID3D11DepthStencilView* depthStencilView;
-};
-
 static class CManager
 {
 public:
@@ -34,20 +25,56 @@ public:
 		m_nextScene = new T();
 	}
 
-	// add a render pass to the scene
+	// declare a render pass of the scene, the frame graph decides when and if it runs
 	static void AddRenderPass(const RenderPass& renderPass)
 	{
 		m_renderPasses.push_back(renderPass);
 	}
 
 	static std::vector<RenderPass>* GetRenderPasses() { return &m_renderPasses; }
-	static void ClearRenderPasses() { m_renderPasses.clear(); }
+
+	// records the passes of different portals on worker threads, they are still executed in frame graph order
+	static void EnableParallelRecording(bool enable) { m_parallelRecording = enable; }
+	static bool IsParallelRecording() { return m_parallelRecording; }
+	static int GetParallelPassNum() { return m_lastParallelPassNum; }
+
+	// view and projection of the main camera the passes of this frame are drawn with, taken on the main thread before any pass is recorded
+	static dx::XMMATRIX GetViewMatrix() { return dx::XMLoadFloat4x4(&m_view); }
+	static dx::XMMATRIX GetProjectionMatrix() { return dx::XMLoadFloat4x4(&m_projection); }
+
+	// the pass currently being drawn, nullptr outside of Draw
+	static const RenderPass* GetActiveRenderPass() { return m_activeRenderPass < 0 ? nullptr : &m_renderPasses[m_activeRenderPass]; }
+	static void ClearRenderPasses()
+	{
+		m_renderPasses.clear();
+
+		// the draw lists are built per pass index
+		if (m_scene)
+			m_scene->InvalidateVisibility();
+	}
 
 private:
 	static class Scene* m_scene;
 	static class Scene* m_nextScene;
 
 	static std::vector<RenderPass> m_renderPasses;
+	static thread_local int m_activeRenderPass;
+	static dx::XMFLOAT4X4 m_view, m_projection;
+
+	static bool m_parallelRecording;
+	static int m_parallelPassNum, m_lastParallelPassNum;
+	static std::vector<CommandBuffer> m_passBuffers;	// one per executed pass recorded on a worker thread
+
+	static void BeginPass(const CompiledPass& compiled);
+	static void DrawPass(const CompiledPass& compiled);
+	static void DrawPassesParallel(size_t first, size_t last);
+	static void DrawScene(int renderPass);
+
+	// passes of the same group share state while recording and stay on one thread, -1 for passes recorded on the main thread
+	static int GetRecordGroup(const RenderPass& renderPass)
+	{
+		return renderPass.pass == Pass::Portal || renderPass.pass == Pass::PortalFrame ? renderPass.portal : -1;
+	}
 
 	// change the scene if the next scene is set
 	static void ChangeScene()
@@ -0,0 +1,607 @@
+#include "pch.h"
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <sys/stat.h>
+#include "meshoptimizer.h"
+
+// size of the cache the forsyth scores are tuned for
+#define FORSYTH_CACHE_SIZE 32
+// clusters are cut where their cache efficiency is at least this close to the hard cluster they split
+#define OVERDRAW_THRESHOLD 1.05f
+
+
+uint64_t MeshOptimizer::m_triangleNum = 0;
+uint64_t MeshOptimizer::m_vertexNum = 0;
+uint64_t MeshOptimizer::m_missesBefore = 0;
+uint64_t MeshOptimizer::m_missesAfter = 0;
+int MeshOptimizer::m_cachedNum = 0;
+int MeshOptimizer::m_optimizedNum = 0;
+
+
+static float VertexScore(int cachePosition, uint32_t valence)
+{
+	// no triangles left to draw with this vertex
+	if (valence == 0)
+		return -1.0f;
+
+	// the last triangle drawn gets a fixed score so its vertices dont win over the ones about to leave the cache
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = powf(1.0f - (cachePosition - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+	}
+
+	// vertices with few triangles left are finished first so they dont end up alone later
+	return score + 2.0f * powf((float)valence, -0.5f);
+}
+
+static bool IndicesInRange(const std::vector<uint32_t>& indices, uint32_t vertexNum)
+{
+	return std::all_of(indices.begin(), indices.end(), [vertexNum](uint32_t index) { return index < vertexNum; });
+}
+
+static bool IsPermutation(const std::vector<uint32_t>& remap)
+{
+	// every new index is handed out exactly once
+	std::vector<bool> used(remap.size(), false);
+	for (uint32_t index : remap)
+	{
+		if (index >= remap.size() || used[index])
+			return false;
+		used[index] = true;
+	}
+
+	return true;
+}
+
+
+void MeshOptimizer::Optimize(OptimizedMesh& mesh, const dx::XMFLOAT3* positions, bool remapVertices)
+{
+	mesh.missesBefore = SimulateVertexCache(mesh.indices, mesh.vertexNum);
+
+	OptimizeVertexCache(mesh.indices, mesh.vertexNum);
+	OptimizeOverdraw(mesh.indices, positions, mesh.vertexNum, OVERDRAW_THRESHOLD);
+	if (remapVertices)
+		OptimizeVertexFetch(mesh.indices, mesh.remap, mesh.vertexNum);
+	else
+		mesh.remap.clear();
+
+	mesh.missesAfter = SimulateVertexCache(mesh.indices, mesh.vertexNum);
+
+	AddStats(mesh);
+	m_optimizedNum++;
+}
+
+bool MeshOptimizer::LoadCache(const std::string& sourcePath, std::vector<OptimizedMesh>& meshes)
+{
+	uint64_t sourceSize, sourceTime;
+	if (!GetSourceStamp(sourcePath, sourceSize, sourceTime))
+		return false;
+
+	FILE* file = fopen(GetCachePath(sourcePath).c_str(), "rb");
+	if (!file)
+		return false;
+
+	// the header has to match the source file, every mesh has to match what was just imported,
+	// and every index has to point at a vertex so a broken file cant make the draws read outside the buffers
+	char magic[4];
+	uint32_t version, meshNum;
+	uint64_t size, time;
+	bool valid = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, "MOPT", 4) == 0 &&
+		fread(&version, sizeof(version), 1, file) == 1 && version == CACHE_FILE_VERSION &&
+		fread(&size, sizeof(size), 1, file) == 1 && size == sourceSize &&
+		fread(&time, sizeof(time), 1, file) == 1 && time == sourceTime &&
+		fread(&meshNum, sizeof(meshNum), 1, file) == 1 && meshNum == meshes.size();
+
+	for (size_t m = 0; valid && m < meshes.size(); ++m)
+	{
+		OptimizedMesh& mesh = meshes[m];
+		uint32_t counts[6];
+		valid = fread(counts, sizeof(counts), 1, file) == 1 &&
+			counts[0] == mesh.vertexNum && counts[1] == mesh.indices.size() && (counts[2] == 0 || counts[2] == mesh.vertexNum) &&
+			counts[5] <= MAX_CACHED_LODS;
+		if (!valid)
+			break;
+
+		mesh.remap.resize(counts[2]);
+		mesh.missesBefore = counts[3];
+		mesh.missesAfter = counts[4];
+		valid = (mesh.indices.empty() || fread(mesh.indices.data(), sizeof(uint32_t), mesh.indices.size(), file) == mesh.indices.size()) &&
+			(mesh.remap.empty() || fread(mesh.remap.data(), sizeof(uint32_t), mesh.remap.size(), file) == mesh.remap.size()) &&
+			IndicesInRange(mesh.indices, mesh.vertexNum) && IsPermutation(mesh.remap);
+
+		mesh.lods.resize(counts[5]);
+		for (std::vector<uint32_t>& lod : mesh.lods)
+		{
+			uint32_t indexNum;
+			valid = valid && fread(&indexNum, sizeof(indexNum), 1, file) == 1 && indexNum > 0 && indexNum <= mesh.indices.size();
+			if (!valid)
+				break;
+
+			lod.resize(indexNum);
+			valid = fread(lod.data(), sizeof(uint32_t), lod.size(), file) == lod.size() && IndicesInRange(lod, mesh.vertexNum);
+		}
+	}
+
+	fclose(file);
+	if (!valid)
+		return false;
+
+	for (const OptimizedMesh& mesh : meshes)
+		AddStats(mesh);
+	m_cachedNum++;
+
+	return true;
+}
+
+void MeshOptimizer::SaveCache(const std::string& sourcePath, const std::vector<OptimizedMesh>& meshes)
+{
+	uint64_t sourceSize, sourceTime;
+	if (!GetSourceStamp(sourcePath, sourceSize, sourceTime))
+		return;
+
+	FILE* file = fopen(GetCachePath(sourcePath).c_str(), "wb");
+	if (!file)
+		return;
+
+	uint32_t version = CACHE_FILE_VERSION;
+	uint32_t meshNum = (uint32_t)meshes.size();
+	fwrite("MOPT", 4, 1, file);
+	fwrite(&version, sizeof(version), 1, file);
+	fwrite(&sourceSize, sizeof(sourceSize), 1, file);
+	fwrite(&sourceTime, sizeof(sourceTime), 1, file);
+	fwrite(&meshNum, sizeof(meshNum), 1, file);
+
+	for (const OptimizedMesh& mesh : meshes)
+	{
+		uint32_t counts[6] = { mesh.vertexNum, (uint32_t)mesh.indices.size(), (uint32_t)mesh.remap.size(), mesh.missesBefore, mesh.missesAfter, (uint32_t)mesh.lods.size() };
+		fwrite(counts, sizeof(counts), 1, file);
+		fwrite(mesh.indices.data(), sizeof(uint32_t), mesh.indices.size(), file);
+		fwrite(mesh.remap.data(), sizeof(uint32_t), mesh.remap.size(), file);
+
+		for (const std::vector<uint32_t>& lod : mesh.lods)
+		{
+			uint32_t indexNum = (uint32_t)lod.size();
+			fwrite(&indexNum, sizeof(indexNum), 1, file);
+			fwrite(lod.data(), sizeof(uint32_t), lod.size(), file);
+		}
+	}
+
+	fclose(file);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexNum)
+{
+	uint32_t triangleNum = (uint32_t)indices.size() / 3;
+	if (triangleNum == 0)
+		return;
+
+	// triangles using each vertex, the lists shrink as triangles are drawn
+	std::vector<uint32_t> valence(vertexNum, 0);
+	for (uint32_t index : indices)
+		valence[index]++;
+
+	std::vector<uint32_t> offsets(vertexNum + 1, 0);
+	for (uint32_t v = 0; v < vertexNum; ++v)
+		offsets[v + 1] = offsets[v] + valence[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t t = 0; t < triangleNum; ++t)
+		for (int k = 0; k < 3; ++k)
+			adjacency[fill[indices[t * 3 + k]]++] = t;
+
+	std::vector<int> cachePosition(vertexNum, -1);
+	std::vector<float> vertexScore(vertexNum);
+	for (uint32_t v = 0; v < vertexNum; ++v)
+		vertexScore[v] = VertexScore(-1, valence[v]);
+
+	std::vector<float> triangleScore(triangleNum);
+	for (uint32_t t = 0; t < triangleNum; ++t)
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+	std::vector<bool> emitted(triangleNum, false);
+	std::vector<uint32_t> cache, nextCache;
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t cursor = 0;
+	int best = -1;
+	while (result.size() < indices.size())
+	{
+		// nothing in the cache is used by a triangle left, continue with the next one in the original order
+		if (best < 0)
+		{
+			while (emitted[cursor])
+				++cursor;
+			best = (int)cursor;
+		}
+
+		emitted[best] = true;
+		const uint32_t* triangle = &indices[best * 3];
+		for (int k = 0; k < 3; ++k)
+		{
+			uint32_t v = triangle[k];
+			result.push_back(v);
+
+			uint32_t* list = &adjacency[offsets[v]];
+			for (uint32_t i = 0; i < valence[v]; ++i)
+			{
+				if (list[i] == (uint32_t)best)
+				{
+					list[i] = list[valence[v] - 1];
+					break;
+				}
+			}
+			valence[v]--;
+		}
+
+		// the vertices of the triangle move to the front of the cache
+		nextCache.assign(triangle, triangle + 3);
+		for (uint32_t v : cache)
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				nextCache.push_back(v);
+
+		// rescore every vertex that moved or fell out and the triangles left using them
+		for (size_t i = 0; i < nextCache.size(); ++i)
+		{
+			uint32_t v = nextCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+
+			float score = VertexScore(cachePosition[v], valence[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			for (uint32_t j = 0; j < valence[v]; ++j)
+				triangleScore[adjacency[offsets[v] + j]] += delta;
+		}
+
+		if (nextCache.size() > FORSYTH_CACHE_SIZE)
+			nextCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(nextCache);
+
+		// the best triangle is always one using a vertex in the cache
+		best = -1;
+		float bestScore = -FLT_MAX;
+		for (uint32_t v : cache)
+		{
+			for (uint32_t j = 0; j < valence[v]; ++j)
+			{
+				uint32_t t = adjacency[offsets[v] + j];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = (int)t;
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const dx::XMFLOAT3* positions, uint32_t vertexNum, float threshold)
+{
+	uint32_t triangleNum = (uint32_t)indices.size() / 3;
+	if (triangleNum < 2)
+		return;
+
+	// the fifo cache is simulated with timestamps, moving the time past the cache size flushes it
+	std::vector<uint32_t> timestamps(vertexNum, 0);
+	uint32_t time = SIMULATED_CACHE_SIZE + 1;
+	auto triangleMisses = [&](uint32_t t)
+	{
+		uint32_t misses = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			uint32_t v = indices[t * 3 + k];
+			if (time - timestamps[v] > SIMULATED_CACHE_SIZE)
+			{
+				timestamps[v] = time++;
+				misses++;
+			}
+		}
+		return misses;
+	};
+
+	// hard boundaries are where the cache misses every vertex of a triangle, the order can change there for free
+	std::vector<uint32_t> hardStart;
+	for (uint32_t t = 0; t < triangleNum; ++t)
+	{
+		if (triangleMisses(t) == 3 || t == 0)
+			hardStart.push_back(t);
+	}
+	hardStart.push_back(triangleNum);
+
+	// soft boundaries split a hard cluster where the part so far, starting with an empty cache,
+	// already uses the cache about as well as the whole hard cluster
+	std::vector<uint32_t> clusterStart;
+	for (size_t h = 0; h + 1 < hardStart.size(); ++h)
+	{
+		uint32_t begin = hardStart[h], end = hardStart[h + 1];
+
+		time += SIMULATED_CACHE_SIZE + 1;
+		uint32_t hardMisses = 0;
+		for (uint32_t t = begin; t < end; ++t)
+			hardMisses += triangleMisses(t);
+		float clusterThreshold = threshold * hardMisses / (float)(end - begin);
+
+		time += SIMULATED_CACHE_SIZE + 1;
+		clusterStart.push_back(begin);
+		uint32_t clusterMisses = 0, clusterTriangles = 0;
+		for (uint32_t t = begin; t < end; ++t)
+		{
+			clusterMisses += triangleMisses(t);
+			clusterTriangles++;
+
+			if (t + 1 < end && clusterMisses <= clusterThreshold * clusterTriangles)
+			{
+				clusterStart.push_back(t + 1);
+				clusterMisses = clusterTriangles = 0;
+				time += SIMULATED_CACHE_SIZE + 1;
+			}
+		}
+	}
+	clusterStart.push_back(triangleNum);
+
+	// area weighted center and normal of the mesh and of every cluster
+	size_t clusterNum = clusterStart.size() - 1;
+	std::vector<dx::XMFLOAT3> clusterCenter(clusterNum), clusterNormal(clusterNum);
+	dx::XMVECTOR meshCenter = dx::XMVectorZero();
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterNum; ++c)
+	{
+		dx::XMVECTOR center = dx::XMVectorZero();
+		dx::XMVECTOR normal = dx::XMVectorZero();
+		float area = 0.0f;
+		for (uint32_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t)
+		{
+			dx::XMVECTOR p0 = dx::XMLoadFloat3(&positions[indices[t * 3]]);
+			dx::XMVECTOR p1 = dx::XMLoadFloat3(&positions[indices[t * 3 + 1]]);
+			dx::XMVECTOR p2 = dx::XMLoadFloat3(&positions[indices[t * 3 + 2]]);
+
+			dx::XMVECTOR cross = dx::XMVector3Cross(dx::XMVectorSubtract(p1, p0), dx::XMVectorSubtract(p2, p0));
+			float triangleArea = dx::XMVectorGetX(dx::XMVector3Length(cross));
+
+			center = dx::XMVectorAdd(center, dx::XMVectorScale(dx::XMVectorAdd(dx::XMVectorAdd(p0, p1), p2), triangleArea / 3.0f));
+			normal = dx::XMVectorAdd(normal, cross);
+			area += triangleArea;
+		}
+
+		meshCenter = dx::XMVectorAdd(meshCenter, center);
+		meshArea += area;
+
+		dx::XMStoreFloat3(&clusterCenter[c], area > 0.0f ? dx::XMVectorScale(center, 1.0f / area) : center);
+		dx::XMStoreFloat3(&clusterNormal[c], dx::XMVector3Normalize(normal));
+	}
+	if (meshArea > 0.0f)
+		meshCenter = dx::XMVectorScale(meshCenter, 1.0f / meshArea);
+
+	// clusters far out and facing away from the center are likely to occlude the rest, so they are drawn first
+	std::vector<float> sortKey(clusterNum);
+	std::vector<uint32_t> order(clusterNum);
+	for (size_t c = 0; c < clusterNum; ++c)
+	{
+		dx::XMVECTOR offset = dx::XMVectorSubtract(dx::XMLoadFloat3(&clusterCenter[c]), meshCenter);
+		sortKey[c] = dx::XMVectorGetX(dx::XMVector3Dot(offset, dx::XMLoadFloat3(&clusterNormal[c])));
+		order[c] = (uint32_t)c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKey](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (uint32_t c : order)
+		result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+
+	// the sorted order may cost at most the threshold in cache efficiency, otherwise the cache order is kept
+	if (SimulateVertexCache(result, vertexNum) > threshold * SimulateVertexCache(indices, vertexNum))
+		return;
+
+	indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<uint32_t>& remap, uint32_t vertexNum)
+{
+	remap.assign(vertexNum, UINT32_MAX);
+
+	uint32_t next = 0;
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	// vertices no triangle uses go to the end
+	for (uint32_t& index : remap)
+		if (index == UINT32_MAX)
+			index = next++;
+}
+
+void MeshOptimizer::BuildLods(OptimizedMesh& mesh, const dx::XMFLOAT3* positions, int lodNum)
+{
+	mesh.lods.clear();
+
+	// the lods index the vertices in the order they end up in the vertex buffer
+	std::vector<dx::XMFLOAT3> remapped;
+	if (!mesh.remap.empty())
+	{
+		remapped.resize(mesh.vertexNum);
+		for (uint32_t v = 0; v < mesh.vertexNum; ++v)
+			remapped[mesh.remap[v]] = positions[v];
+		positions = remapped.data();
+	}
+
+	uint32_t triangleNum = (uint32_t)mesh.indices.size() / 3;
+	uint32_t maxGridSize = MAX_GRID_SIZE;
+	std::vector<uint32_t> result, best;
+	for (int l = 0; l < lodNum; ++l)
+	{
+		uint32_t target = triangleNum / 2;
+		if (target < MIN_LOD_TRIANGLES)
+			break;
+
+		// finer grids keep more triangles, search for the finest one that still reaches the target
+		best.clear();
+		uint32_t bestGridSize = 0;
+		uint32_t low = 1, high = maxGridSize;
+		while (low <= high)
+		{
+			uint32_t gridSize = (low + high) / 2;
+			SimplifyGrid(mesh.indices, positions, mesh.vertexNum, gridSize, result);
+			if (result.size() / 3 <= target)
+			{
+				best.swap(result);
+				bestGridSize = gridSize;
+				low = gridSize + 1;
+			}
+			else
+			{
+				high = gridSize - 1;
+			}
+		}
+
+		if (best.empty())
+			break;
+
+		OptimizeVertexCache(best, mesh.vertexNum);
+		triangleNum = (uint32_t)best.size() / 3;
+		maxGridSize = bestGridSize;
+		mesh.lods.push_back(best);
+	}
+}
+
+void MeshOptimizer::SimplifyGrid(const std::vector<uint32_t>& indices, const dx::XMFLOAT3* positions, uint32_t vertexNum, uint32_t gridSize, std::vector<uint32_t>& result)
+{
+	result.clear();
+	if (indices.empty())
+		return;
+
+	// the grid covers the vertices the triangles use
+	dx::XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX), boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32_t index : indices)
+	{
+		const dx::XMFLOAT3& p = positions[index];
+		boundsMin = dx::XMFLOAT3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+		boundsMax = dx::XMFLOAT3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+	}
+
+	dx::XMFLOAT3 scale(gridSize / std::max(boundsMax.x - boundsMin.x, FLT_EPSILON),
+		gridSize / std::max(boundsMax.y - boundsMin.y, FLT_EPSILON),
+		gridSize / std::max(boundsMax.z - boundsMin.z, FLT_EPSILON));
+
+	struct Cell
+	{
+		dx::XMFLOAT3 sum;
+		uint32_t count;
+		uint32_t vertex;
+		float distance;
+	};
+
+	// cell of every used vertex and the average position of each cell
+	std::unordered_map<uint32_t, Cell> cells;
+	std::vector<uint32_t> vertexCell(vertexNum, UINT32_MAX);
+	for (uint32_t index : indices)
+	{
+		if (vertexCell[index] != UINT32_MAX)
+			continue;
+
+		const dx::XMFLOAT3& p = positions[index];
+		uint32_t x = std::min((uint32_t)((p.x - boundsMin.x) * scale.x), gridSize - 1);
+		uint32_t y = std::min((uint32_t)((p.y - boundsMin.y) * scale.y), gridSize - 1);
+		uint32_t z = std::min((uint32_t)((p.z - boundsMin.z) * scale.z), gridSize - 1);
+		vertexCell[index] = (x * gridSize + y) * gridSize + z;
+
+		Cell& cell = cells[vertexCell[index]];
+		if (cell.count == 0)
+			cell.vertex = UINT32_MAX;
+		cell.sum = dx::XMFLOAT3(cell.sum.x + p.x, cell.sum.y + p.y, cell.sum.z + p.z);
+		cell.count++;
+	}
+
+	// the vertex nearest to the average stands in for the whole cell, so the lod shares the vertex buffer
+	for (uint32_t v = 0; v < vertexNum; ++v)
+	{
+		if (vertexCell[v] == UINT32_MAX)
+			continue;
+
+		Cell& cell = cells[vertexCell[v]];
+		float offsetX = positions[v].x - cell.sum.x / cell.count;
+		float offsetY = positions[v].y - cell.sum.y / cell.count;
+		float offsetZ = positions[v].z - cell.sum.z / cell.count;
+		float distance = offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ;
+		if (cell.vertex == UINT32_MAX || distance < cell.distance)
+		{
+			cell.vertex = v;
+			cell.distance = distance;
+		}
+	}
+
+	for (uint32_t v = 0; v < vertexNum; ++v)
+	{
+		if (vertexCell[v] != UINT32_MAX)
+			vertexCell[v] = cells[vertexCell[v]].vertex;
+	}
+
+	// triangles whose corners fell into the same cell are gone, the ones left twice are drawn once
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		std::array<uint32_t, 3> triangle = { vertexCell[indices[i]], vertexCell[indices[i + 1]], vertexCell[indices[i + 2]] };
+		if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+			continue;
+
+		// start at the smallest index without changing the winding so duplicates compare equal
+		while (triangle[0] > triangle[1] || triangle[0] > triangle[2])
+			std::rotate(triangle.begin(), triangle.begin() + 1, triangle.end());
+		triangles.push_back(triangle);
+	}
+
+	std::sort(triangles.begin(), triangles.end());
+	triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+	result.reserve(triangles.size() * 3);
+	for (const std::array<uint32_t, 3>& triangle : triangles)
+		result.insert(result.end(), triangle.begin(), triangle.end());
+}
+
+uint32_t MeshOptimizer::SimulateVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexNum, uint32_t cacheSize)
+{
+	// a vertex is in the fifo while less than cacheSize misses happened since it was loaded
+	std::vector<uint32_t> timestamps(vertexNum, 0);
+	uint32_t time = cacheSize + 1;
+	uint32_t misses = 0;
+	for (uint32_t index : indices)
+	{
+		if (time - timestamps[index] > cacheSize)
+		{
+			timestamps[index] = time++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+void MeshOptimizer::AddStats(const OptimizedMesh& mesh)
+{
+	m_triangleNum += mesh.indices.size() / 3;
+	m_vertexNum += mesh.vertexNum;
+	m_missesBefore += mesh.missesBefore;
+	m_missesAfter += mesh.missesAfter;
+}
+
+bool MeshOptimizer::GetSourceStamp(const std::string& sourcePath, uint64_t& size, uint64_t& time)
+{
+	struct _stat64 status;
+	if (_stat64(sourcePath.c_str(), &status) != 0)
+		return false;
+
+	size = (uint64_t)status.st_size;
+	time = (uint64_t)status.st_mtime;
+	return true;
+}
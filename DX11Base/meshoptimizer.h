@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+
+
+// triangle order and vertex order of a sub mesh as the gpu wants them
+struct OptimizedMesh
+{
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> remap;		// new index of every original vertex, empty when the vertices keep their order
+	std::vector<std::vector<uint32_t>> lods;	// coarser versions of the triangles using the same vertices, the finest first
+	uint32_t vertexNum;
+	uint32_t missesBefore, missesAfter;	// vertex cache misses of the simulated cache before and after
+};
+
+// reorders meshes for the post transform vertex cache, overdraw and vertex fetch, done once on load and cached on disk
+static class MeshOptimizer
+{
+public:
+	// optimizes the triangles of a mesh, the vertices are only remapped when asked for since skinned meshes are indexed by their original vertices
+	static void Optimize(OptimizedMesh& mesh, const dx::XMFLOAT3* positions, bool remapVertices);
+
+	// the cache is thrown away when the source file changed or the meshes dont match anymore
+	static bool LoadCache(const std::string& sourcePath, std::vector<OptimizedMesh>& meshes);
+	static void SaveCache(const std::string& sourcePath, const std::vector<OptimizedMesh>& meshes);
+
+	// reorders triangles so recently transformed vertices are reused, tom forsyths linear speed algorithm
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexNum);
+	// sorts clusters of triangles so the ones facing outwards are drawn first, keeping the cache order inside a cluster
+	static void OptimizeOverdraw(std::vector<uint32_t>& indices, const dx::XMFLOAT3* positions, uint32_t vertexNum, float threshold);
+	// renumbers the vertices in the order the triangles first use them
+	static void OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<uint32_t>& remap, uint32_t vertexNum);
+
+	// adds up to lodNum coarser levels to a mesh, each about half the triangles of the one before,
+	// the positions are in the original vertex order
+	static void BuildLods(OptimizedMesh& mesh, const dx::XMFLOAT3* positions, int lodNum);
+	// merges the vertices in every cell of a grid over the mesh into the one nearest to their average and drops the triangles that collapsed
+	static void SimplifyGrid(const std::vector<uint32_t>& indices, const dx::XMFLOAT3* positions, uint32_t vertexNum, uint32_t gridSize, std::vector<uint32_t>& result);
+
+	// vertex cache misses of a fifo cache of the given size
+	static uint32_t SimulateVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexNum, uint32_t cacheSize = SIMULATED_CACHE_SIZE);
+
+	// average cache miss ratio per triangle and per vertex of every mesh loaded so far
+	static float GetACMR(bool optimized) { return m_triangleNum ? (optimized ? m_missesAfter : m_missesBefore) / (float)m_triangleNum : 0.0f; }
+	static float GetATVR(bool optimized) { return m_vertexNum ? (optimized ? m_missesAfter : m_missesBefore) / (float)m_vertexNum : 0.0f; }
+	static int GetCachedNum() { return m_cachedNum; }
+	static int GetOptimizedNum() { return m_optimizedNum; }
+
+private:
+	static const uint32_t SIMULATED_CACHE_SIZE = 16;
+	static const uint32_t CACHE_FILE_VERSION = 3;
+	static const uint32_t MIN_LOD_TRIANGLES = 32;	// meshes this small arent worth simplifying further
+	static const uint32_t MAX_GRID_SIZE = 1024;
+	static const uint32_t MAX_CACHED_LODS = 16;		// more than any model asks for, a larger count comes from a broken file
+
+	static uint64_t m_triangleNum, m_vertexNum, m_missesBefore, m_missesAfter;
+	static int m_cachedNum, m_optimizedNum;
+
+	static void AddStats(const OptimizedMesh& mesh);
+	static std::string GetCachePath(const std::string& sourcePath) { return sourcePath + ".meshcache"; }
+	static bool GetSourceStamp(const std::string& sourcePath, uint64_t& size, uint64_t& time);
+};
@@ -1,9 +1,13 @@
 #include "pch.h"
+#include <float.h>
+#include <algorithm>
 #include "main.h"
 #include "renderer.h"
 #include "shader.h"
 #include "model.h"
 #include "skinningcs.h"
+#include "meshoptimizer.h"
+#include "geometrypool.h"
 
 
 std::shared_ptr<class SkinningCompute> Model::m_skinningCs = nullptr;
@@ -34,16 +38,149 @@ void Model::Load(const char* fileName)
 	m_bones.back().second = Bone{};
 	CreateBone(m_scene->mRootNode);
 	
+	// calculate the bounding box from every vertex of every sub mesh
+	aiVector3D boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	aiVector3D boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (unsigned int m = 0; m < m_scene->mNumMeshes; ++m)
+	{
+		aiMesh* mesh = m_scene->mMeshes[m];
+		for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+		{
+			const aiVector3D& p = mesh->mVertices[v];
+			boundsMin.x = p.x < boundsMin.x ? p.x : boundsMin.x;
+			boundsMin.y = p.y < boundsMin.y ? p.y : boundsMin.y;
+			boundsMin.z = p.z < boundsMin.z ? p.z : boundsMin.z;
+			boundsMax.x = p.x > boundsMax.x ? p.x : boundsMax.x;
+			boundsMax.y = p.y > boundsMax.y ? p.y : boundsMax.y;
+			boundsMax.z = p.z > boundsMax.z ? p.z : boundsMax.z;
+		}
+	}
+
+	if (boundsMin.x > boundsMax.x)
+		boundsMin = boundsMax = aiVector3D(0, 0, 0);
+
+	m_boundsCenter = dx::XMFLOAT3((boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f);
+	m_boundsExtents = dx::XMFLOAT3((boundsMax.x - boundsMin.x) * 0.5f, (boundsMax.y - boundsMin.y) * 0.5f, (boundsMax.z - boundsMin.z) * 0.5f);
+
 	// create buffers
 	m_vertexBuffer = new ID3D11Buffer*[m_scene->mNumMeshes];
 	m_indexBuffer = new ID3D11Buffer*[m_scene->mNumMeshes];
+	m_indexFormat.resize(m_scene->mNumMeshes);
+	m_lods.assign(m_scene->mNumMeshes, std::vector<MeshLod>());
+	m_baseVertex.assign(m_scene->mNumMeshes, 0);
+	m_pooled.assign(m_scene->mNumMeshes, false);
+	m_lodNum = 1;
+
+	bool packed = !m_scene->HasAnimations();
+	m_vertexFormat = packed ? VertexFormat::Packed : VertexFormat::Standard;
+	m_vertexStride = packed ? sizeof(VERTEX_3D_PACKED) : sizeof(VERTEX_3D);
+
+	// triangle and vertex order of every sub mesh, optimized on the first load and read back from the cache after that
+	std::vector<OptimizedMesh> meshes(m_scene->mNumMeshes);
+	for (unsigned int m = 0; m < m_scene->mNumMeshes; ++m)
+	{
+		meshes[m].vertexNum = m_scene->mMeshes[m]->mNumVertices;
+		meshes[m].indices.resize(m_scene->mMeshes[m]->mNumFaces * 3);
+	}
+
+	if (!MeshOptimizer::LoadCache(modelPath, meshes))
+	{
+		for (unsigned int m = 0; m < m_scene->mNumMeshes; ++m)
+		{
+			aiMesh* mesh = m_scene->mMeshes[m];
+			for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
+			{
+				const aiFace* face = &mesh->mFaces[f];
+				assert(face->mNumIndices == 3);
+
+				for (unsigned int i = 0; i < 3; ++i)
+					meshes[m].indices[f * 3 + i] = face->mIndices[i];
+			}
+
+			// skinned meshes keep their vertex order, the deform vertices and bone weights are indexed by it
+			const dx::XMFLOAT3* positions = reinterpret_cast<const dx::XMFLOAT3*>(mesh->mVertices);
+			MeshOptimizer::Optimize(meshes[m], positions, packed);
+			MeshOptimizer::BuildLods(meshes[m], positions, LOD_NUM - 1);
+		}
+
+		MeshOptimizer::SaveCache(modelPath, meshes);
+	}
 
 	// loop for every sub meshes
 	for (unsigned int m = 0; m < m_scene->mNumMeshes; ++m)
 	{
 		aiMesh* mesh = m_scene->mMeshes[m];
 
+		// index data, 16 bit when every vertex of the sub mesh can be addressed with it,
+		// the levels of detail follow the full mesh
+		bool shortIndex = mesh->mNumVertices <= 0xFFFF;
+		m_indexFormat[m] = shortIndex ? IndexFormat::UInt16 : IndexFormat::UInt32;
+
+		std::vector<uint32_t> index32 = meshes[m].indices;
+		m_lods[m].push_back({ 0, (UINT)index32.size() });
+		for (const std::vector<uint32_t>& lod : meshes[m].lods)
+		{
+			m_lods[m].push_back({ (UINT)index32.size(), (UINT)lod.size() });
+			index32.insert(index32.end(), lod.begin(), lod.end());
+		}
+		m_lodNum = std::max(m_lodNum, (int)m_lods[m].size());
+
+		std::vector<uint16_t> index16;
+		if (shortIndex)
+			index16.assign(index32.begin(), index32.end());
+		const void* indexData = shortIndex ? (const void*)index16.data() : (const void*)index32.data();
+
+		// packed vertices, the tangent frame isnt read by any shader so it is left out
+		bool pooled = false;
+		if (packed)
+		{
+			std::vector<VERTEX_3D_PACKED> vertex(mesh->mNumVertices);
+
+			const std::vector<uint32_t>& remap = meshes[m].remap;
+			for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
+			{
+				VERTEX_3D_PACKED& out = vertex[remap.empty() ? v : remap[v]];
+				out.Position = dx::XMFLOAT3(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z);
+				dx::PackedVector::XMStoreByteN4(&out.Normal, dx::XMVectorSet(mesh->mNormals[v].x, mesh->mNormals[v].y, mesh->mNormals[v].z, 1.0f));
+				if (mesh->HasTextureCoords(0))
+					out.TexCoord = dx::PackedVector::XMHALF2(mesh->mTextureCoords[0][v].x, mesh->mTextureCoords[0][v].y);
+				else
+					out.TexCoord = dx::PackedVector::XMHALF2(0.0f, 0.0f);
+			}
+
+			// static meshes share the buffers of the geometry pool, the draws offset into them
+			GeometryAllocation allocation;
+			pooled = GeometryPool::Allocate(vertex.data(), mesh->mNumVertices, indexData, (UINT)index32.size(), m_indexFormat[m], allocation);
+			if (pooled)
+			{
+				m_vertexBuffer[m] = allocation.vertexBuffer;
+				m_indexBuffer[m] = allocation.indexBuffer;
+				m_baseVertex[m] = allocation.baseVertex;
+				for (MeshLod& lod : m_lods[m])
+					lod.firstIndex += allocation.firstIndex;
+
+				m_pooled[m] = true;
+				m_allocations.push_back(allocation);
+			}
+			// the pool is full, fall back to an immutable buffer of its own
+			else
+			{
+				D3D11_BUFFER_DESC bd;
+				ZeroMemory(&bd, sizeof(bd));
+				bd.Usage = D3D11_USAGE_IMMUTABLE;
+				bd.ByteWidth = sizeof(VERTEX_3D_PACKED) * mesh->mNumVertices;
+				bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+				bd.CPUAccessFlags = 0;
+
+				D3D11_SUBRESOURCE_DATA sd;
+				ZeroMemory(&sd, sizeof(sd));
+				sd.pSysMem = vertex.data();
+
+				CRenderer::GetDevice()->CreateBuffer(&bd, &sd, &m_vertexBuffer[m]);
+			}
+		}
 		// create vertex buffer
+		else
 		{
 			VERTEX_3D* vertex = new VERTEX_3D[mesh->mNumVertices];
 
@@ -73,32 +210,20 @@ void Model::Load(const char* fileName)
 		}
 
 		// create index buffer
+		if (!pooled)
 		{
-			unsigned int* index = new unsigned int[mesh->mNumFaces * 3];
-
-			for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
-			{
-				const aiFace* face = &mesh->mFaces[f];
-				assert(face->mNumIndices == 3);
-
-				index[f * 3 + 0] = face->mIndices[0];
-				index[f * 3 + 1] = face->mIndices[1];
-				index[f * 3 + 2] = face->mIndices[2];
-			}
-
 			D3D11_BUFFER_DESC bd;
 			ZeroMemory(&bd, sizeof(bd));
-			bd.Usage = D3D11_USAGE_DEFAULT;
-			bd.ByteWidth = sizeof(unsigned int) * mesh->mNumFaces * 3;
+			bd.Usage = D3D11_USAGE_IMMUTABLE;
+			bd.ByteWidth = (UINT)((shortIndex ? sizeof(uint16_t) : sizeof(uint32_t)) * index32.size());
 			bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 			bd.CPUAccessFlags = 0;
 
 			D3D11_SUBRESOURCE_DATA sd;
 			ZeroMemory(&sd, sizeof(sd));
-			sd.pSysMem = index;
+			sd.pSysMem = indexData;
 
 			CRenderer::GetDevice()->CreateBuffer(&bd, &sd, &m_indexBuffer[m]);
-			delete[] index;
 		}
 
 		// create deform vertices and bones
@@ -198,16 +323,41 @@ void Model::Load(const char* fileName)
 			m_texture[path.data] = nullptr;
 		}
 	}
+
+	// resolve the texture of every material once, the colors are set by whoever draws the model
+	m_materials.resize(m_scene->mNumMaterials);
+	for (unsigned int m = 0; m < m_scene->mNumMaterials; ++m)
+	{
+		aiMaterial* material = m_scene->mMaterials[m];
+
+		aiString path;
+		material->GetTexture(aiTextureType_DIFFUSE, 0, &path);
+		m_materials[m].diffuse = m_texture[path.data];
+	}
+
+	m_meshMaterial.resize(m_scene->mNumMeshes);
+	for (unsigned int m = 0; m < m_scene->mNumMeshes; ++m)
+		m_meshMaterial[m] = m_scene->mMeshes[m]->mMaterialIndex;
 }
 
 void Model::Unload()
 {
+	// pooled meshes only point into the buffers of the pool
 	for (int i = 0; i < m_scene->mNumMeshes; ++i)
 	{
+		if (m_pooled[i])
+			continue;
+
 		SAFE_RELEASE(m_vertexBuffer[i]);
 		SAFE_RELEASE(m_indexBuffer[i]);
 	}
 
+	for (const GeometryAllocation& allocation : m_allocations)
+		GeometryPool::Free(allocation);
+	m_allocations.clear();
+	m_pooled.clear();
+	m_baseVertex.clear();
+
 	SAFE_DELETE_ARRAY(m_vertexBuffer);
 	SAFE_DELETE_ARRAY(m_indexBuffer);
 
@@ -219,6 +369,10 @@ void Model::Unload()
 	}
 
 	m_texture.clear();
+	m_materials.clear();
+	m_meshMaterial.clear();
+	m_lods.clear();
+	m_indexFormat.clear();
 
 	aiReleaseImport(m_scene);
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <map>
+#include "commandbuffer.h"
+#include "geometrypool.h"
 #include "assimp/cimport.h"
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
@@ -18,6 +20,19 @@ struct DeformVertex
 	float boneWeight[4];
 };
 
+// everything a sub mesh needs at draw time, resolved once on load
+struct ModelMaterial
+{
+	ID3D11ShaderResourceView* diffuse;
+};
+
+// range of the index buffer of a sub mesh drawing one level of detail
+struct MeshLod
+{
+	UINT firstIndex;
+	UINT indexCount;
+};
+
 struct Bone
 {
 	aiMatrix4x4 matrix;
@@ -30,10 +45,26 @@ class Model
 	friend class CRenderer;
 
 public:
+	// levels of detail generated on load including the full mesh, small meshes get fewer
+	static const int LOD_NUM = 4;
+
 	void Load(const char* fileName);
 	void Unload();
 	void Update(int frame, int animationNum);
 
+	// local space bounding box of every sub mesh combined
+	dx::XMFLOAT3 GetBoundsCenter() const { return m_boundsCenter; }
+	dx::XMFLOAT3 GetBoundsExtents() const { return m_boundsExtents; }
+
+
+	// levels of detail of the sub mesh with the most of them, a sub mesh with fewer draws its coarsest one instead
+	int GetLodNum() const { return m_lodNum; }
+	const MeshLod& GetMeshLod(UINT mesh, int lod) const
+	{
+		const std::vector<MeshLod>& lods = m_lods[mesh];
+		return lods[lod < (int)lods.size() ? lod : lods.size() - 1];
+	}
+
 private:
 	static std::shared_ptr<class SkinningCompute> m_skinningCs;
 
@@ -41,13 +72,32 @@ private:
 	ID3D11Buffer** m_vertexBuffer;
 	ID3D11Buffer** m_indexBuffer;
 
+	// only used on load to share textures between materials and to release them
 	std::map<std::string, ID3D11ShaderResourceView*> m_texture;
 
+	// flat per mesh draw data so drawing never touches the scene or the texture map
+	std::vector<ModelMaterial> m_materials;
+	std::vector<UINT> m_meshMaterial;
+	std::vector<std::vector<MeshLod>> m_lods;
+	std::vector<IndexFormat> m_indexFormat;
+	int m_lodNum = 1;
+
+	// static sub meshes live in the geometry pool, their buffers are shared and drawn with a base vertex
+	std::vector<UINT> m_baseVertex;
+	std::vector<bool> m_pooled;
+	std::vector<GeometryAllocation> m_allocations;
+
+	// models without animation are packed into immutable buffers, animated ones are rewritten by the skinning
+	VertexFormat m_vertexFormat;
+	UINT m_vertexStride;
+
 	std::vector<DeformVertex>* m_deformVertices;
 	std::vector<std::pair<std::string, Bone>> m_bones;
 
 	int m_boneNodeIndex;
 
+	dx::XMFLOAT3 m_boundsCenter, m_boundsExtents;
+
 	// for motion blending
 	UINT m_prevAnimIndex = 0, m_curAnimIndex = 0;
 	UINT m_prevAnim = 0;
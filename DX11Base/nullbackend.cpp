@@ -0,0 +1,46 @@
+#include <string.h>
+#include "nullbackend.h"
+
+
+void NullBackend::Execute(const CommandBuffer& commandBuffer)
+{
+	for (const CommandHeader* header = commandBuffer.First(); header; header = commandBuffer.Next(header))
+	{
+		++m_commandNum[(int)header->type];
+
+		switch (header->type)
+		{
+		case CommandType::UpdateConstantBuffer:
+			m_constantBytes += CommandBuffer::GetPayload<UpdateConstantBufferCommand>(header).size;
+			break;
+		case CommandType::Draw:
+			m_vertexNum += CommandBuffer::GetPayload<DrawCommand>(header).vertexCount;
+			++m_drawNum;
+			break;
+		case CommandType::DrawIndexed:
+			m_vertexNum += CommandBuffer::GetPayload<DrawIndexedCommand>(header).indexCount;
+			++m_drawNum;
+			break;
+		case CommandType::DrawIndexedInstanced:
+		{
+			const DrawIndexedInstancedCommand& command = CommandBuffer::GetPayload<DrawIndexedInstancedCommand>(header);
+			m_vertexNum += (uint64_t)command.indexCount * command.instanceCount;
+			++m_drawNum;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	++m_executeNum;
+}
+
+void NullBackend::ResetStats()
+{
+	memset(m_commandNum, 0, sizeof(m_commandNum));
+	m_drawNum = 0;
+	m_vertexNum = 0;
+	m_constantBytes = 0;
+	m_executeNum = 0;
+}
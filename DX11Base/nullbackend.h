@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include "renderbackend.h"
+#include "commandbuffer.h"
+
+
+// executes nothing and only counts what would have been sent to the gpu,
+// for measuring the cpu side of the submission and for checking recorded streams without a device
+class NullBackend : public RenderBackend
+{
+public:
+	void Execute(const CommandBuffer& commandBuffer) override;
+	const char* GetName() const override { return "Null"; }
+
+	void ResetStats();
+	uint32_t GetCommandNum(CommandType type) const { return m_commandNum[(int)type]; }
+	uint32_t GetDrawNum() const { return m_drawNum; }
+	uint64_t GetVertexNum() const { return m_vertexNum; }
+	uint64_t GetConstantBytes() const { return m_constantBytes; }
+	uint32_t GetExecuteNum() const { return m_executeNum; }
+
+private:
+	uint32_t m_commandNum[(int)CommandType::Num] = {};
+	uint32_t m_drawNum = 0;
+	uint64_t m_vertexNum = 0;		// indices for indexed draws, times the instances
+	uint64_t m_constantBytes = 0;
+	uint32_t m_executeNum = 0;
+};
@@ -3,5 +3,30 @@
 
 enum class Pass
 {
-	Default, Lightmap, PortalBlue, PortalOrange, StencilOnly, PortalBlueFrame, PortalOrangeFrame, PortalBackface, UI
+	Default, Lightmap, LightmapStatic, Portal, StencilOnly, PortalFrame, PortalBackface, UI
+};
+
+const int PASS_NUM = (int)Pass::UI + 1;
+const uint32_t PASS_MASK_ALL = (1u << PASS_NUM) - 1;
+const uint32_t PASS_MASK_NONE = 0;
+
+inline uint32_t PassBit(Pass pass) { return 1u << (uint32_t)pass; }
+
+struct RenderPass
+{
+	std::vector<uint8_t> targetOutput;
+	std::vector<uint8_t> targetInput;	// targets sampled by the pass, the frame graph keeps the passes writing them
+	Pass pass;
+	std::shared_ptr<class Shader> overrideShader;
+	bool clearRTV;					// discard what earlier passes wrote, the first pass writing a target in a frame always clears it
+	bool clearDepth, clearStencil;
+	ID3D11DepthStencilView* depthStencilView;
+	int priority;					// passes run from the lowest priority up, in the order they were added within the same priority
+	int portal;						// slot of the portal the pass renders, used by portal passes
+	int recursionLevel;				// how many times the view went through the portal, used by portal passes
+	int cascade;					// cascade of the directional light shadow, used by lightmap passes
+	bool skip;						// nothing to draw, set every frame for portals that cant be seen
+	bool scaledViewport;			// render only into the viewport and scissor below, set every frame by the owner of the pass
+	D3D11_VIEWPORT viewport;
+	D3D11_RECT scissor;
 };
@@ -9,6 +9,7 @@
 #include "fpscamera.h"
 #include "cube.h"
 #include "debug.h"
+#include "lodselector.h"
 #include <typeinfo>
 
 
@@ -20,11 +21,15 @@ void Player::Awake()
 	m_shader = CRenderer::GetShader<BasicLightShader>();
 
 	ModelManager::GetModel(MODEL_PLAYER, m_model);
+	SetLocalBounds(m_model->GetBoundsCenter(), m_model->GetBoundsExtents());
 
 	SetPosition(0.0F, 0.0F, 0.0F);
 	SetRotation(0.0F, 0.0F, 0.0F);
 	SetScale(0.06F, 0.06F, 0.06F);
 
+	// the clone is drawn in every pass with the own shader, only the shadow uses the shader of the pass
+	SetPassMask(PASS_MASK_ALL, PassBit(Pass::Lightmap));
+
 	virtualUp = { 0, 1, 0 };
 	m_obb.Init((GameObject*)this, 33, 70, 33, 0, 35, 0);
 
@@ -33,7 +38,7 @@ void Player::Awake()
 	m_enableFrustumCulling = false;
 	m_isJumping = false;
 	m_velocity = m_movementVelocity = { 0,0,0 };
-	m_entrancePortal = PortalType::None;
+	m_entrancePortal = m_exitPortal = PORTAL_NONE;
 
 	m_model->Update(0, 0);
 }
@@ -65,9 +70,10 @@ void Player::Update()
 	{
 		virtualUp = Lerp(virtualUp, dx::XMFLOAT3{ 0,1,0 }, 0.06f);
 
-		auto blue = PortalManager::GetPortal(PortalType::Blue);
-		auto orange = PortalManager::GetPortal(PortalType::Orange);
-		if (blue && orange && blue->GetForward(true).y >= 0.9f && orange->GetForward(true).y >= 0.9f)
+		// snap back if the pair the player came out of is facing up on both sides
+		auto exit = PortalManager::GetPortal(m_exitPortal);
+		auto entrance = PortalManager::GetLinkedPortal(m_exitPortal);
+		if (exit && entrance && exit->GetForward(true).y >= 0.9f && entrance->GetForward(true).y >= 0.9f)
 		{
 			virtualUp = { 0,1,0 };
 		}
@@ -99,6 +105,10 @@ void Player::Update()
 	if (CInput::GetKeyTrigger(DIK_E))
 		GrabObject();
 
+	// the next shots go into the next portal pair
+	if (CInput::GetKeyTrigger(DIK_TAB))
+		PortalManager::SetShootPair((PortalManager::GetShootPair() + 1) % PortalManager::GetPairNum());
+
 	// shoot portal
 	if (!m_grabbingObject.lock())
 	{
@@ -119,34 +129,31 @@ void Player::Draw(Pass pass)
 	material.Diffuse = dx::XMFLOAT4(1, 1, 1, 1);
 	m_shader->SetMaterial(material);
 
-	if (pass == Pass::PortalBlue)
+	if (pass == Pass::Portal)
 	{
-		m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(PortalType::Blue));
-		m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(PortalType::Blue));
-	}
-	else if (pass == Pass::PortalOrange)
-	{
-		m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(PortalType::Orange));
-		m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(PortalType::Orange));
+		int portal = PortalManager::GetRenderingPortal();
+		m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(portal));
+		m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(portal));
 	}
 
 	// only draw player through portal view and if both portals are active
-	if ((pass == Pass::PortalBlue || pass == Pass::PortalOrange))
+	if (pass == Pass::Portal)
 	{
-		if (PortalManager::GetPortal(PortalType::Blue) && PortalManager::GetPortal(PortalType::Orange))
+		int portal = PortalManager::GetRenderingPortal();
+		if (PortalManager::GetPortal(portal) && PortalManager::GetLinkedPortal(portal))
 		{
 			dx::XMMATRIX world = GetFixedUpWorldMatrix();
 			m_shader->SetWorldMatrix(&world);
-			CRenderer::DrawModel(m_shader, m_model);
+			CRenderer::DrawModel(m_shader, m_model, true, LodSelector::Select(*m_model, world));
 		}
 	}
 	else if(auto linked = PortalManager::GetLinkedPortal(m_entrancePortal))
 	{
 		// draw the clone for the main camera
-		m_shader->SetPortalInverseWorldMatrix(Debug::portalClipping, &dx::XMMatrixInverse(nullptr, linked->GetWorldMatrix()));
+		m_shader->SetPortalInverseWorldMatrix(Debug::portalClipping, &linked->GetInverseWorldMatrix());
 		dx::XMMATRIX world = GetClonedWorldMatrix();
 		m_shader->SetWorldMatrix(&world);
-		CRenderer::DrawModel(m_shader, m_model);
+		CRenderer::DrawModel(m_shader, m_model, true, LodSelector::Select(*m_model, world));
 
 		m_shader->SetPortalInverseWorldMatrix(false);
 	}
@@ -155,11 +162,11 @@ void Player::Draw(Pass pass)
 	if (auto portal = PortalManager::GetPortal(m_entrancePortal))
 	{
 		int recursionCheck = PortalManager::GetPortalTechnique() == PortalTechnique::Stencil ? 3 : 1;
-		if (portal->GetCurrentIteration() == recursionCheck)
+		if (PortalManager::GetCurrentIteration(m_entrancePortal) == recursionCheck)
 		{
 			dx::XMMATRIX world = GetClonedWorldMatrix();
 			m_shader->SetWorldMatrix(&world);
-			CRenderer::DrawModel(m_shader, m_model);
+			CRenderer::DrawModel(m_shader, m_model, true, LodSelector::Select(*m_model, world));
 		}
 	}
 
@@ -219,10 +226,8 @@ void Player::Swap()
 		m_position -= virtualUp * m_camera->GetHeight();
 
 		// swap the entrance portal
-		if (portal->GetType() == PortalType::Blue)
-			SetEntrancePortal(PortalType::Orange);
-		else
-			SetEntrancePortal(PortalType::Blue);
+		m_exitPortal = LinkedPortalSlot(portal->GetSlot());
+		SetEntrancePortal(m_exitPortal);
 
 		// play swap sound effect if there is enough velocity
 		float velLength = dx::XMVectorGetX(dx::XMVector3LengthSq(vel));
@@ -460,7 +465,8 @@ void Player::UpdateGrabObject()
 			// player is near the portal
 			if (portal->GetLinkedPortal())
 			{
-				dx::XMVECTOR portalForward = dx::XMLoadFloat3(&portal->GetForward());
+				dx::XMFLOAT3 forward = portal->GetForward();
+				dx::XMVECTOR portalForward = dx::XMLoadFloat3(&forward);
 				dx::XMVECTOR portalToPoint = dx::XMVectorSubtract(point, portal->GetPosition());
 
 				float dot = dx::XMVectorGetX(dx::XMVector3Dot(portalForward, portalToPoint));
@@ -480,7 +486,7 @@ void Player::UpdateGrabObject()
 					// point is still on the same side
 					if (m_entrancePortal == traveler->GetEntrancePortal())
 						obj->SetPosition(point);
-					else if (traveler->GetEntrancePortal() != PortalType::None && (swapped || traveler->GetEntrancePortal() == m_entrancePortal))
+					else if (traveler->GetEntrancePortal() != PORTAL_NONE && (swapped || traveler->GetEntrancePortal() == m_entrancePortal))
 					{
 						obj->SetPosition(portal->GetClonedPosition(point));
 						swapped = false;
@@ -499,7 +505,8 @@ void Player::UpdateGrabObject()
 			if (portal->GetLinkedPortal())
 			{
 				portal = swapped ? portal->GetLinkedPortal() : portal;
-				dx::XMVECTOR portalForward = dx::XMLoadFloat3(&portal->GetForward());
+				dx::XMFLOAT3 forward = portal->GetForward();
+				dx::XMVECTOR portalForward = dx::XMLoadFloat3(&forward);
 				dx::XMVECTOR portalToPoint = dx::XMVectorSubtract(point, portal->GetPosition());
 
 				float dot = dx::XMVectorGetX(dx::XMVector3Dot(portalForward, portalToPoint));
@@ -534,7 +541,7 @@ void Player::UpdateGrabObject()
 		else
 		{
 			obj->SetPosition(point);
-			if (traveler->GetEntrancePortal() == PortalType::None)
+			if (traveler->GetEntrancePortal() == PORTAL_NONE)
 				swapped = false;
 		}
 	}
@@ -567,7 +574,7 @@ void Player::UpdateGrabCollision()
 		}
 
 		// if not near a portal, do proper collision response
-		if (grab->GetEntrancePortal() == PortalType::None && GetEntrancePortal() == PortalType::None)
+		if (grab->GetEntrancePortal() == PORTAL_NONE && GetEntrancePortal() == PORTAL_NONE)
 		{
 			dx::XMFLOAT3 forward, position;
 			dx::XMStoreFloat3(&forward, dx::XMVector3Normalize(dx::XMVectorSubtract(obj->GetPosition(), m_camera->GetPosition())));
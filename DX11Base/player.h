@@ -38,6 +38,7 @@ private:
 	dx::XMFLOAT3 m_movementVelocity;
 	bool m_isJumping;
 	float m_grabRadius;
+	int m_exitPortal;
 
 	void UpdateAnimation();
 	void Movement();
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "portal.h"
 #include "manager.h"
+#include "portalmanager.h"
 #include "fpscamera.h"
 #include "modelmanager.h"
 #include "debug.h"
@@ -12,6 +13,7 @@ void Portal::Awake()
 
 	// init values
 	ModelManager::GetModel(MODEL_PORTAL, m_model);
+	SetLocalBounds(m_model->GetBoundsCenter(), m_model->GetBoundsExtents());
 
 	SetPosition(0.0F, 0.0F, 0.0F);
 	SetRotation(0.0F, 0.0F, 0.0F);
@@ -20,6 +22,7 @@ void Portal::Awake()
 	m_enableFrustumCulling = false;
 	m_curScale = 0;
 	m_finalScale = 2.0f;
+	m_visibleDepth = PortalManager::GetRecursionNum();
 
 	// colliders
 	m_triggerCollider.Init((GameObject*)this, 1.2f, 2.5f, 2.0f, 0, 0, 0.5f);
@@ -65,7 +68,119 @@ dx::XMMATRIX Portal::GetFakeWorldMatrix() const
 		return scale * rot * trans;
 }
 
-dx::XMMATRIX Portal::GetProjectionMatrix(bool firstIteration)
+void Portal::BuildViewChain(int depth)
+{
+	m_viewChain.clear();
+	m_projectionChain.clear();
+	if (!m_linkedPortal.lock())
+		return;
+
+	// walk the camera through the portal once per level instead of once per level per draw
+	auto mainCam = std::static_pointer_cast<FPSCamera>(CManager::GetActiveScene()->GetMainCamera());
+	dx::XMMATRIX portalToPortal = GetPortalToPortalMatrix();
+	dx::XMMATRIX cam = mainCam->GetLocalToWorldMatrix(false);
+	for (int level = 0; level <= depth; ++level)
+	{
+		cam *= portalToPortal;
+
+		dx::XMFLOAT4X4 view, projection;
+		dx::XMStoreFloat4x4(&view, CameraWorldToView(cam));
+		dx::XMStoreFloat4x4(&projection, CalculateProjectionMatrix(dx::XMLoadFloat4x4(&view)));
+		m_viewChain.push_back(view);
+		m_projectionChain.push_back(projection);
+	}
+}
+
+dx::XMMATRIX Portal::GetViewMatrixAtLevel(int level) const
+{
+	if (level >= 0 && level < (int)m_viewChain.size())
+		return dx::XMLoadFloat4x4(&m_viewChain[level]);
+
+	// not in the chain of this frame, walk through the portal by hand
+	auto mainCam = std::static_pointer_cast<FPSCamera>(CManager::GetActiveScene()->GetMainCamera());
+	if (!m_linkedPortal.lock())
+		return mainCam->GetViewMatrix();
+
+	dx::XMMATRIX portalToPortal = GetPortalToPortalMatrix();
+	dx::XMMATRIX cam = mainCam->GetLocalToWorldMatrix(false);
+	for (int i = 0; i <= level; ++i)
+		cam *= portalToPortal;
+
+	return CameraWorldToView(cam);
+}
+
+dx::XMMATRIX Portal::GetProjectionMatrixAtLevel(int level) const
+{
+	if (level >= 0 && level < (int)m_projectionChain.size())
+		return dx::XMLoadFloat4x4(&m_projectionChain[level]);
+
+	return CalculateProjectionMatrix(GetViewMatrixAtLevel(level));
+}
+
+dx::XMMATRIX Portal::GetInverseWorldMatrix() const
+{
+	UpdateTransformCache();
+	return dx::XMLoadFloat4x4(&m_inverseWorldMatrix);
+}
+
+dx::XMMATRIX Portal::GetPortalToPortalMatrix() const
+{
+	auto linkedPortal = m_linkedPortal.lock();
+	if (!linkedPortal)
+		return dx::XMMatrixIdentity();
+
+	// only recalculate when one of the two portals moved or the link changed
+	UpdateTransformCache();
+	linkedPortal->UpdateTransformCache();
+	if (m_portalToPortalVersion != m_transformVersion || m_portalToPortalLinkedVersion != linkedPortal->m_transformVersion ||
+		m_portalToPortalLinked != linkedPortal.get())
+	{
+		// in portal local -> rotate locally by y 180 -> out portal world
+		dx::XMMATRIX portalToPortal = dx::XMLoadFloat4x4(&m_inverseWorldMatrix);
+		portalToPortal *= dx::XMMatrixRotationY(dx::XMConvertToRadians(180));
+		portalToPortal *= dx::XMLoadFloat4x4(&linkedPortal->m_worldMatrix);
+		dx::XMStoreFloat4x4(&m_portalToPortalMatrix, portalToPortal);
+
+		m_portalToPortalVersion = m_transformVersion;
+		m_portalToPortalLinkedVersion = linkedPortal->m_transformVersion;
+		m_portalToPortalLinked = linkedPortal.get();
+	}
+
+	return dx::XMLoadFloat4x4(&m_portalToPortalMatrix);
+}
+
+void Portal::UpdateTransformCache() const
+{
+	if (m_transformVersion != 0 &&
+		m_cachedPosition.x == m_position.x && m_cachedPosition.y == m_position.y && m_cachedPosition.z == m_position.z &&
+		m_cachedRotation.x == m_rotation.x && m_cachedRotation.y == m_rotation.y && m_cachedRotation.z == m_rotation.z && m_cachedRotation.w == m_rotation.w &&
+		m_cachedScale.x == m_scale.x && m_cachedScale.y == m_scale.y && m_cachedScale.z == m_scale.z)
+		return;
+
+	// the portal moved, this is the only place the inverse is calculated
+	dx::XMMATRIX world = GetWorldMatrix();
+	dx::XMStoreFloat4x4(&m_worldMatrix, world);
+	dx::XMStoreFloat4x4(&m_inverseWorldMatrix, dx::XMMatrixInverse(nullptr, world));
+
+	m_cachedPosition = m_position;
+	m_cachedRotation = m_rotation;
+	m_cachedScale = m_scale;
+	m_transformVersion++;
+}
+
+dx::XMMATRIX Portal::CameraWorldToView(const dx::XMMATRIX& cameraWorld)
+{
+	dx::XMFLOAT4X4 fout;
+	dx::XMStoreFloat4x4(&fout, cameraWorld);
+
+	dx::XMVECTOR forward = dx::XMVectorSet(fout._31, fout._32, fout._33, 0);
+	dx::XMVECTOR up = dx::XMVectorSet(fout._21, fout._22, fout._23, 0);
+	dx::XMVECTOR eye = dx::XMVectorSet(fout._41, fout._42, fout._43, 1);
+
+	return dx::XMMatrixLookToLH(eye, forward, up);
+}
+
+dx::XMMATRIX Portal::CalculateProjectionMatrix(const dx::XMMATRIX& viewMatrix) const
 {
 	if (!Debug::obliqueProjectionEnabled)
 		return CManager::GetActiveScene()->GetMainCamera()->GetProjectionMatrix();
@@ -75,7 +190,7 @@ dx::XMMATRIX Portal::GetProjectionMatrix(bool firstIteration)
 		auto cam = std::static_pointer_cast<FPSCamera>(CManager::GetActiveScene()->GetMainCamera());
 
 		dx::XMFLOAT4X4 v;
-		dx::XMStoreFloat4x4(&v, (GetViewMatrix(firstIteration)));
+		dx::XMStoreFloat4x4(&v, viewMatrix);
 
 		// Find a camera-space position on the plane (it does not matter where on the clip plane, as long as it is on it)
 		dx::XMFLOAT3 position;
@@ -102,18 +217,16 @@ dx::XMMATRIX Portal::GetProjectionMatrix(bool firstIteration)
 		dx::XMVECTOR clipPlane = dx::XMVectorSet(Cx, Cy, Cz, Cw);
 		return cam->CalculateObliqueMatrix(clipPlane);
 	}
+
+	return CManager::GetActiveScene()->GetMainCamera()->GetProjectionMatrix();
 }
 
 dx::XMVECTOR Portal::GetClonedVelocity(dx::XMVECTOR velocity) const
 {
-	if (auto linkedPortal = m_linkedPortal.lock())
+	if (m_linkedPortal.lock())
 	{
 		//direction vector -> in portal local -> rotate locally by y 180 -> out portal world
-		velocity = dx::XMVector3TransformNormal(velocity, dx::XMMatrixInverse(nullptr, GetWorldMatrix()));
-		velocity = dx::XMVector3TransformNormal(velocity, dx::XMMatrixRotationY(dx::XMConvertToRadians(180)));
-		velocity = dx::XMVector3TransformNormal(velocity, linkedPortal->GetWorldMatrix());
-
-		return velocity;
+		return dx::XMVector3TransformNormal(velocity, GetPortalToPortalMatrix());
 	}
 
 	return dx::XMVECTOR{ 0,0,0 };
@@ -121,14 +234,10 @@ dx::XMVECTOR Portal::GetClonedVelocity(dx::XMVECTOR velocity) const
 
 dx::XMVECTOR Portal::GetClonedPosition(dx::XMVECTOR position) const
 {
-	if (auto linkedPortal = m_linkedPortal.lock())
+	if (m_linkedPortal.lock())
 	{
 		//direction vector -> in portal local -> rotate locally by y 180 -> out portal world
-		position = dx::XMVector3Transform(position, dx::XMMatrixInverse(nullptr, GetWorldMatrix()));
-		position = dx::XMVector3Transform(position, dx::XMMatrixRotationY(dx::XMConvertToRadians(180)));
-		position = dx::XMVector3Transform(position, linkedPortal->GetWorldMatrix());
-
-		return position;
+		return dx::XMVector3Transform(position, GetPortalToPortalMatrix());
 	}
 
 	return dx::XMVECTOR{ 0,0,0 };
@@ -136,15 +245,8 @@ dx::XMVECTOR Portal::GetClonedPosition(dx::XMVECTOR position) const
 
 dx::XMMATRIX Portal::GetClonedOrientationMatrix(dx::XMMATRIX matrix) const
 {
-	if (auto linkedPortal = m_linkedPortal.lock())
-	{
-		dx::XMMATRIX out = matrix;
-		out *= dx::XMMatrixInverse(nullptr, GetWorldMatrix());
-		out *= dx::XMMatrixRotationY(dx::XMConvertToRadians(180));
-		out *= linkedPortal->GetWorldMatrix();
-
-		return out;
-	}
+	if (m_linkedPortal.lock())
+		return matrix * GetPortalToPortalMatrix();
 
 	return dx::XMMatrixIdentity();
 }
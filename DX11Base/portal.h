@@ -9,6 +9,11 @@ enum class PortalType
 	None, Blue, Orange
 };
 
+// portals live in slots, two per pair, the linked portal is always in the neighbouring slot
+constexpr int PORTAL_NONE = -1;
+inline int PortalSlot(int pair, PortalType type) { return type == PortalType::None ? PORTAL_NONE : pair * 2 + (type == PortalType::Blue ? 0 : 1); }
+inline int LinkedPortalSlot(int slot) { return slot == PORTAL_NONE ? PORTAL_NONE : slot ^ 1; }
+
 class Portal : public GameObject
 {
 public:
@@ -17,30 +22,48 @@ public:
 
 	// setters
 	void SetColor(dx::XMFLOAT4 color) { m_color = color; }
-	void SetOtherPortal(const std::shared_ptr<Portal>& otherPortal) { m_linkedPortal = otherPortal; }
+	void SetOtherPortal(const std::shared_ptr<Portal>& otherPortal) { m_linkedPortal = otherPortal; m_viewChain.clear(); m_projectionChain.clear(); }
 	void SetType(PortalType type) { m_type = type; }
+	void SetSlot(int slot) { m_slot = slot; }
 	void SetAttachedColliderNormal(dx::XMFLOAT3 normal) { m_attachedColliderNormal = normal; }
 
 	// used for rendering with render texture
 	virtual void SetRenderTexture(const std::shared_ptr<RenderTexture>& renderTexture) {}
 	virtual void SetTempRenderTexture(const std::shared_ptr<RenderTexture>& renderTexture) {}
+	virtual void SetHistoryRenderTexture(const std::shared_ptr<RenderTexture>& renderTexture) {}
 	virtual void SetRecursionNum(uint32_t num) {}
 
+	// deepest recursion level worth rendering this frame, -1 if the portal cant be seen
+	virtual void SetVisibleDepth(int depth) { m_visibleDepth = depth; }
+	int GetVisibleDepth() const { return m_visibleDepth; }
+
+	// view and oblique projection of every recursion level, built once per frame after the camera moved
+	void BuildViewChain(int depth);
+
 	// getters
 	virtual dx::XMMATRIX GetFakeWorldMatrix() const;
-	virtual dx::XMMATRIX GetViewMatrix(bool firstIteration = false) = 0;
-	dx::XMMATRIX GetProjectionMatrix(bool firstIteration = false);
+	dx::XMMATRIX GetInverseWorldMatrix() const;
+	dx::XMMATRIX GetPortalToPortalMatrix() const;
+	dx::XMMATRIX GetViewMatrix(bool firstIteration = false) const { return GetViewMatrixAtLevel(firstIteration ? 0 : GetRecursionLevel()); }
+	dx::XMMATRIX GetProjectionMatrix(bool firstIteration = false) const { return GetProjectionMatrixAtLevel(firstIteration ? 0 : GetRecursionLevel()); }
+	dx::XMMATRIX GetViewMatrixAtLevel(int level) const;
+	dx::XMMATRIX GetProjectionMatrixAtLevel(int level) const;
 	dx::XMVECTOR GetClonedVelocity(dx::XMVECTOR velocity) const;
 	dx::XMVECTOR GetClonedPosition(dx::XMVECTOR position) const;
 	dx::XMMATRIX GetClonedOrientationMatrix(dx::XMMATRIX matrix) const;
 	std::shared_ptr<Portal> GetLinkedPortal() const { return m_linkedPortal.lock(); }
 
 	PortalType GetType() const { return m_type; }
+	int GetSlot() const { return m_slot; }
+	int GetPair() const { return m_slot / 2; }
 	OBB* GetTriggerCollider() { return &m_triggerCollider; }
 	std::vector<OBB*>* GetEdgeColliders() { return &m_edgeColliders; }
 	dx::XMFLOAT3 GetAttachedColliderNormal() const { return m_attachedColliderNormal; }
 	int GetCurrentIteration() const { return m_curIteration; }
 
+	// recursion level of the portal pass currently being drawn
+	virtual int GetRecursionLevel() const = 0;
+
 protected:
 	std::shared_ptr<class Model> m_model;
 	OBB m_triggerCollider;
@@ -49,9 +72,27 @@ protected:
 
 	std::weak_ptr<Portal> m_linkedPortal;
 	PortalType m_type;
+	int m_slot = PORTAL_NONE;
 
 	dx::XMFLOAT4 m_color;
 	float m_curScale, m_finalScale;
 
 	int m_curIteration;
+	int m_visibleDepth;
+
+private:
+	// transforms cached until the portal moves, the version tells the linked portal when to rebuild,
+	// filled on the main thread before portal passes are recorded in parallel
+	mutable dx::XMFLOAT4X4 m_worldMatrix, m_inverseWorldMatrix, m_portalToPortalMatrix;
+	mutable dx::XMFLOAT3 m_cachedPosition, m_cachedScale;
+	mutable dx::XMFLOAT4 m_cachedRotation;
+	mutable uint32_t m_transformVersion = 0;
+	mutable uint32_t m_portalToPortalVersion = 0, m_portalToPortalLinkedVersion = 0;
+	mutable const Portal* m_portalToPortalLinked = nullptr;
+
+	std::vector<dx::XMFLOAT4X4> m_viewChain, m_projectionChain;
+
+	void UpdateTransformCache() const;
+	dx::XMMATRIX CalculateProjectionMatrix(const dx::XMMATRIX& viewMatrix) const;
+	static dx::XMMATRIX CameraWorldToView(const dx::XMMATRIX& cameraWorld);
 };
@@ -17,44 +17,44 @@ public:
 		deviceContext->IASetInputLayout(m_vertexLayout);
 
 		// set constant buffers
-		deviceContext->VSSetConstantBuffers(0, 1, &m_worldBuffer);
-		deviceContext->VSSetConstantBuffers(1, 1, &m_viewBuffer);
-		deviceContext->VSSetConstantBuffers(2, 1, &m_projectionBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 0, m_worldBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 1, m_viewBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 2, m_projectionBuffer);
 
-		deviceContext->PSSetConstantBuffers(0, 1, &m_materialBuffer);
-		deviceContext->PSSetConstantBuffers(1, 1, &m_valueBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 0, m_materialBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 1, m_valueBuffer);
 		deviceContext->PSSetShaderResources(0, 1, &m_maskTexture);
 	}
 
 	void SetValueBuffer(int stencilPass)
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_valueBuffer, 0, NULL, &stencilPass, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_valueBuffer, &stencilPass, sizeof(stencilPass));
 	}
 
 	void SetMaterial(MATERIAL material) override
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_materialBuffer, 0, NULL, &material, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_materialBuffer, &material, sizeof(material));
 	}
 
 	void SetWorldMatrix(dx::XMMATRIX *WorldMatrix) override
 	{
 		dx::XMMATRIX world = *WorldMatrix;
 		world = dx::XMMatrixTranspose(world);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_worldBuffer, 0, NULL, &world, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_worldBuffer, &world, sizeof(world));
 	}
 
 	void SetViewMatrix(dx::XMMATRIX *ViewMatrix) override
 	{
 		dx::XMMATRIX view = *ViewMatrix;
 		view = dx::XMMatrixTranspose(view);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_viewBuffer, 0, NULL, &view, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_viewBuffer, &view, sizeof(view));
 	}
 
 	void SetProjectionMatrix(dx::XMMATRIX *ProjectionMatrix) override
 	{
 		dx::XMMATRIX projection = *ProjectionMatrix;
 		projection = dx::XMMatrixTranspose(projection);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_projectionBuffer, 0, NULL, &projection, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_projectionBuffer, &projection, sizeof(projection));
 	}
 
 private:
@@ -1,4 +1,7 @@
 #include "pch.h"
+#include <float.h>
+#include <limits.h>
+#include <thread>
 #include "portalmanager.h"
 #include "manager.h"
 #include "portaltraveler.h"
@@ -6,8 +9,12 @@
 #include "collision.h"
 #include "portalrendertexture.h"
 #include "portalstencil.h"
+#include "portalvisibility.h"
+#include "framebudget.h"
+#include "rendertexturepool.h"
 #include "depthfromlightshader.h"
 #include "portalbackfaceshader.h"
+#include "shadowcache.h"
 #include "main.h"
 
 #ifdef _DEBUG
@@ -16,168 +23,150 @@
 #define START_RECURSION_COUNT 5;
 #endif
 
+#define START_PAIR_COUNT 1
+#define PORTAL_GRID_CELL_SIZE 8.0f
+#define PORTAL_GRID_MARGIN 4.0f
+#define PORTAL_MIN_LEVEL_SCALE 0.125f
+#define ATLAS_PACK_ATTEMPTS 16
+#define ATLAS_DEEP_ATTEMPTS 8			// attempts that only shrink the levels seen through other levels
+#define ATLAS_SHRINK_STEP 0.85f
+#define ITERATION_PENDING INT_MIN		// the group of the portal is still being recorded
 
-std::weak_ptr<Portal> PortalManager::m_bluePortal;
-std::weak_ptr<Portal> PortalManager::m_orangePortal;
-std::weak_ptr<RenderTexture> PortalManager::m_renderTexBlue;
-std::weak_ptr<RenderTexture> PortalManager::m_renderTexBlueTemp;
-std::weak_ptr<RenderTexture> PortalManager::m_renderTexOrange;
-std::weak_ptr<RenderTexture> PortalManager::m_renderTexOrangeTemp;
+
+std::vector<std::weak_ptr<Portal>> PortalManager::m_portals(START_PAIR_COUNT * 2);
+std::shared_ptr<RenderTexture> PortalManager::m_levelAtlas[2];
+std::vector<std::shared_ptr<RenderTexture>> PortalManager::m_renderTexturesHistory(START_PAIR_COUNT * 2);
 PortalTechnique PortalManager::m_technique = PortalTechnique::Stencil;
 int PortalManager::m_recursionNum = START_RECURSION_COUNT;
+int PortalManager::m_pairNum = START_PAIR_COUNT;
+int PortalManager::m_shootPair = 0;
+int PortalManager::m_reprojectionLevels = 1;
+float PortalManager::m_levelFalloff = 0.75f;
 
 std::vector<std::weak_ptr<PortalTraveler>> PortalManager::m_travelers;
+std::vector<int> PortalManager::m_iterations;
+std::vector<std::atomic<int>> PortalManager::m_finalIterations;
+std::vector<int> PortalManager::m_groupOrder;
+bool PortalManager::m_parallelRecording = false;
+
+std::unordered_map<uint64_t, std::vector<int>> PortalManager::m_portalGrid;
+bool PortalManager::m_portalGridDirty = true;
+
+std::vector<std::vector<PortalManager::LevelCell>> PortalManager::m_levelCells;
+std::vector<PortalManager::LevelOpening> PortalManager::m_levelOpenings[2];
 
 
 void PortalManager::LateUpdate()
 {
+	if (m_portalGridDirty)
+		RebuildPortalGrid();
+
 	// update travelers
 	for(auto t : m_travelers)
 	{
 		if (auto traveler = t.lock())
 		{
-			if (auto bluePortal = m_bluePortal.lock())
+			// see if the traveler is colliding with any linked portal around it
+			traveler->SetEntrancePortal(FindEntrancePortal(traveler));
+
+			// check if the traveler is behind entrance portal, if so swap the main and clone
+			if (auto portal = GetPortal(traveler->GetEntrancePortal()))
 			{
-				if (auto orangePortal = m_orangePortal.lock())
+				dx::XMFLOAT3 forward = portal->GetForward();
+				dx::XMVECTOR portalForward = dx::XMLoadFloat3(&forward);
+				dx::XMVECTOR portalToCamera = dx::XMVectorSubtract(traveler->GetTravelerPosition(), portal->GetPosition());
+
+				float dot = dx::XMVectorGetX(dx::XMVector3Dot(portalForward, portalToCamera));
+				if (dot < 0.0f)
 				{
-					// see if the traveler is colliding with portal
-					dx::XMFLOAT3 blueCol = Collision::ObbObbCollision(bluePortal->GetTriggerCollider(), traveler->GetOBB());
-					dx::XMFLOAT3 orangeCol = Collision::ObbObbCollision(orangePortal->GetTriggerCollider(), traveler->GetOBB());
-
-					// check for collision
-					if (blueCol.x != 0 || blueCol.y != 0 || blueCol.z != 0)
-						traveler->SetEntrancePortal(PortalType::Blue);
-					else if (orangeCol.x != 0 || orangeCol.y != 0 || orangeCol.z != 0)
-						traveler->SetEntrancePortal(PortalType::Orange);
-					else
-					{
-						traveler->SetEntrancePortal(PortalType::None);
-						continue;
-					}
-
-					// check if the traveler is behind entrance portal, if so swap the main and clone
-					if (auto portal = GetPortal(traveler->GetEntrancePortal()))
-					{
-						dx::XMVECTOR portalForward = dx::XMLoadFloat3(&portal->GetForward());
-						dx::XMVECTOR portalToCamera = dx::XMVectorSubtract(traveler->GetTravelerPosition(), portal->GetPosition());
-
-						float dot = dx::XMVectorGetX(dx::XMVector3Dot(portalForward, portalToCamera));
-						if (dot < 0.0f)
-						{
-							// traveler is behind the portal, swap it
-							traveler->Swap();
-						}
-					}
+					// traveler is behind the portal, swap it
+					traveler->Swap();
 				}
-				else
-					traveler->SetEntrancePortal(PortalType::None);
 			}
-			else
-				traveler->SetEntrancePortal(PortalType::None);
 		}
 	}
 
 	// update portal render order based on depth
 	if (m_technique == PortalTechnique::Stencil)
-	{
-		if (auto blue = m_bluePortal.lock())
-		{
-			if (auto orange = m_orangePortal.lock())
-			{
-				auto camera = CManager::GetActiveScene()->GetMainCamera();
-				float blueDepth = dx::XMVectorGetZ(dx::XMVector3Transform(blue->GetPosition(), camera->GetViewMatrix()));
-				float orangeDepth = dx::XMVectorGetZ(dx::XMVector3Transform(orange->GetPosition(), camera->GetViewMatrix()));
-				PortalType type = blueDepth > orangeDepth ? PortalType::Blue : PortalType::Orange;
+		SortStencilPasses();
 
-				auto renderPasses = CManager::GetRenderPasses();
-				int i = 0;
+	// cache the view of every level now that the camera wont move anymore this frame
+	for (auto& p : m_portals)
+		if (auto portal = p.lock())
+			portal->BuildViewChain(m_recursionNum);
 
-				// update first portal passes
-				(*renderPasses)[i++].pass = type == PortalType::Blue ? Pass::PortalBlue : Pass::PortalOrange;
-				for (; i <= PortalManager::GetRecursionNum() + 1; ++i)
-				{
-					(*renderPasses)[i].pass = type == PortalType::Blue ? Pass::PortalBlue : Pass::PortalOrange;
-				}
-				(*renderPasses)[i++].pass = type == PortalType::Blue ? Pass::PortalBlueFrame : Pass::PortalOrangeFrame;
+	// walk the portal graph breadth first to find out how deep each portal is worth rendering within the budget,
+	// the portal can lower it further when its deepest levels are reprojected
+	PortalVisibility::Evaluate(FrameBudget::GetRecursionDepth());
+	for (auto& p : m_portals)
+		if (auto portal = p.lock())
+			portal->SetVisibleDepth(PortalVisibility::GetVisibleDepth(portal->GetSlot()));
 
-				// update second portal passes
-				(*renderPasses)[i++].pass = type == PortalType::Blue ? Pass::PortalOrange : Pass::PortalBlue;
-				int startI = i;
-				for (; i <= startI + PortalManager::GetRecursionNum(); ++i)
-				{
-					(*renderPasses)[i].pass = type == PortalType::Blue ? Pass::PortalOrange : Pass::PortalBlue;
-				}
-				(*renderPasses)[i++].pass = type == PortalType::Blue ? Pass::PortalOrangeFrame : Pass::PortalBlueFrame;
-			}
+	// give every level that is rendered this frame its cell in the level atlas
+	PackLevelAtlas();
+
+	// skip the portal, stencil and frame passes deeper than what has to be rendered
+	for (auto& renderPass : *CManager::GetRenderPasses())
+	{
+		if (renderPass.pass != Pass::Portal && renderPass.pass != Pass::StencilOnly && renderPass.pass != Pass::PortalFrame)
+			continue;
+
+		auto portal = GetPortal(renderPass.portal);
+		renderPass.skip = !portal || renderPass.recursionLevel > portal->GetVisibleDepth();
+
+		// render texture passes only fill the opening of their level, culled levels are reset to the whole texture instead of keeping an old opening
+		if (renderPass.scaledViewport)
+		{
+			dx::XMFLOAT4 textureTransform;
+			GetLevelViewport(renderPass.portal, renderPass.recursionLevel, renderPass.viewport, renderPass.scissor, textureTransform);
 		}
 	}
 }
 
-void PortalManager::CreatePortal(PortalType type, dx::XMFLOAT3 position, dx::XMFLOAT3 lookAt, dx::XMFLOAT3 up)
+void PortalManager::CreatePortal(int pair, PortalType type, dx::XMFLOAT3 position, dx::XMFLOAT3 lookAt, dx::XMFLOAT3 up)
 {
+	int slot = PortalSlot(pair, type);
+	if (slot < 0 || slot >= (int)m_portals.size())
+		return;
+
 	std::shared_ptr<Portal> portal = nullptr;
 
 	if (m_technique == PortalTechnique::RenderToTexture)
 	{
 		portal = CManager::GetActiveScene()->AddGameObject<PortalRenderTexture>(1);
 		portal->SetRecursionNum(m_recursionNum);
+
+		if (m_levelAtlas[0])
+			portal->SetRenderTexture(m_levelAtlas[0]);
+
+		if (m_levelAtlas[1])
+			portal->SetTempRenderTexture(m_levelAtlas[1]);
+
+		if (m_renderTexturesHistory[slot])
+			portal->SetHistoryRenderTexture(m_renderTexturesHistory[slot]);
 	}
 	else
 		portal = CManager::GetActiveScene()->AddGameObject<PortalStencil>(1);
 
 	portal->SetAttachedColliderNormal(lookAt);
-	
-	switch (type)
-	{
-	case PortalType::Blue:
-		if (auto oldPortal = m_bluePortal.lock())
-			oldPortal->SetDestroy();
 
-		if (m_technique == PortalTechnique::RenderToTexture)
-		{
-			if (auto renderTex = m_renderTexBlue.lock())
-				portal->SetRenderTexture(renderTex);
-
-			if (auto tempTex = m_renderTexBlueTemp.lock())
-				portal->SetTempRenderTexture(tempTex);
-		}
-
-		portal->SetColor({0,0,1,1});
-		portal->SetType(PortalType::Blue);
-		m_bluePortal = portal;
-
-		if (auto orangePortal = m_orangePortal.lock())
-		{
-			orangePortal->SetOtherPortal(portal);
-			portal->SetOtherPortal(orangePortal);
-		}
-
-		break;
-
-	case PortalType::Orange:
-		if (auto oldPortal = m_orangePortal.lock())
-			oldPortal->SetDestroy();
-
-		if (m_technique == PortalTechnique::RenderToTexture)
-		{
-			if (auto renderTex = m_renderTexOrange.lock())
-				portal->SetRenderTexture(renderTex);
-
-			if (auto tempTex = m_renderTexOrangeTemp.lock())
-				portal->SetTempRenderTexture(tempTex);
-		}
+	// replace the old portal of this slot
+	if (auto oldPortal = m_portals[slot].lock())
+		oldPortal->SetDestroy();
 
+	if (type == PortalType::Blue)
+		portal->SetColor({ 0,0,1,1 });
+	else
 		portal->SetColor({ 1,0.7f,0,1 });
-		portal->SetType(PortalType::Orange);
-		m_orangePortal = portal;
 
-		if (auto bluePortal = m_bluePortal.lock())
-		{
-			bluePortal->SetOtherPortal(portal);
-			portal->SetOtherPortal(bluePortal);
-		}
+	portal->SetType(type);
+	portal->SetSlot(slot);
+	m_portals[slot] = portal;
 
-		break;
+	if (auto linkedPortal = GetLinkedPortal(slot))
+	{
+		linkedPortal->SetOtherPortal(portal);
+		portal->SetOtherPortal(linkedPortal);
 	}
 
 	// get the orientation from forward and up vector and set it
@@ -202,157 +191,468 @@ void PortalManager::CreatePortal(PortalType type, dx::XMFLOAT3 position, dx::XMF
 
 	portal->SetPosition(position);
 	portal->SetRotation(outRot);
+
+	m_portalGridDirty = true;
 }
 
-dx::XMMATRIX PortalManager::GetProjectionMatrix(PortalType type)
+void PortalManager::DestroyPortal(int slot)
 {
-	switch (type)
+	if (auto portal = GetPortal(slot))
 	{
-	case PortalType::Blue:
-		if (auto portal = m_bluePortal.lock())
-			return portal->GetProjectionMatrix();
-	case PortalType::Orange:
-		if (auto portal = m_orangePortal.lock())
-			return portal->GetProjectionMatrix();
-	default:
-		return dx::XMMATRIX();
+		portal->SetDestroy();
+		m_portals[slot].reset();
+		m_portalGridDirty = true;
 	}
 }
 
-dx::XMMATRIX PortalManager::GetViewMatrix(PortalType type)
+dx::XMMATRIX PortalManager::GetProjectionMatrix(int slot)
 {
-	switch (type)
-	{
-	case PortalType::Blue:
-		if (auto portal = m_bluePortal.lock())
-			return portal->GetViewMatrix();
-	case PortalType::Orange:
-		if (auto portal = m_orangePortal.lock())
-			return portal->GetViewMatrix();
-	default:
-		return dx::XMMATRIX();
-	}
+	if (auto portal = GetPortal(slot))
+		return portal->GetProjectionMatrix();
+
+	return dx::XMMATRIX();
 }
 
-std::shared_ptr<Portal> PortalManager::GetPortal(PortalType type)
+dx::XMMATRIX PortalManager::GetViewMatrix(int slot)
 {
-	if (type == PortalType::None)
-		return nullptr;
+	if (auto portal = GetPortal(slot))
+		return portal->GetViewMatrix();
 
-	return type == PortalType::Blue ? m_bluePortal.lock() : m_orangePortal.lock();
+	return dx::XMMATRIX();
 }
 
-std::shared_ptr<Portal> PortalManager::GetLinkedPortal(PortalType type)
+std::shared_ptr<Portal> PortalManager::GetPortal(int slot)
 {
-	if (type == PortalType::None)
+	if (slot < 0 || slot >= (int)m_portals.size())
 		return nullptr;
 
-	return type == PortalType::Blue ? m_orangePortal.lock() : m_bluePortal.lock();
+	return m_portals[slot].lock();
 }
 
-void PortalManager::BindRenderTexture(PortalType type, const std::shared_ptr<RenderTexture>& renderTexture, const std::shared_ptr<RenderTexture>& renderTextureTemp)
+int PortalManager::GetRenderingPortal()
 {
-	switch (type)
+	const RenderPass* renderPass = CManager::GetActiveRenderPass();
+	if (!renderPass || (renderPass->pass != Pass::Portal && renderPass->pass != Pass::PortalFrame))
+		return PORTAL_NONE;
+
+	return renderPass->portal;
+}
+
+void PortalManager::BeginParallelRecording(const std::vector<int>& groups)
+{
+	m_iterations.assign(m_portals.size(), -1);
+	m_groupOrder.assign(m_portals.size(), INT_MAX);
+	if (m_finalIterations.size() != m_portals.size())
+		m_finalIterations = std::vector<std::atomic<int>>(m_portals.size());
+	for (auto& iteration : m_finalIterations)
+		iteration = ITERATION_PENDING;
+
+	for (size_t i = 0; i < groups.size(); ++i)
+		if (groups[i] >= 0 && groups[i] < (int)m_portals.size())
+			m_groupOrder[groups[i]] = (int)i;
+
+	for (int slot = 0; slot < (int)m_portals.size(); ++slot)
 	{
-	case PortalType::Blue:
-		m_renderTexBlue = renderTexture;
-		m_renderTexBlueTemp = renderTextureTemp;
-	case PortalType::Orange:
-		m_renderTexOrange = renderTexture;
-		m_renderTexOrangeTemp = renderTextureTemp;
+		auto portal = m_portals[slot].lock();
+		if (!portal)
+			continue;
+
+		// the workers only read the cached transforms from here on
+		portal->GetInverseWorldMatrix();
+		portal->GetPortalToPortalMatrix();
+
+		m_iterations[slot] = portal->GetCurrentIteration();
 	}
+
+	m_parallelRecording = true;
+}
+
+void PortalManager::EndGroupRecording(int slot)
+{
+	auto portal = GetPortal(slot);
+	if (slot >= 0 && slot < (int)m_finalIterations.size())
+		m_finalIterations[slot] = portal ? portal->GetCurrentIteration() : -1;
 }
 
+int PortalManager::GetCurrentIteration(int slot)
+{
+	auto portal = GetPortal(slot);
+	if (!portal)
+		return -1;
+
+	int rendering = GetRenderingPortal();
+	if (!m_parallelRecording || rendering == slot)
+		return portal->GetCurrentIteration();
+
+	// drawn one after another, the passes of a later portal see the iteration the earlier portal ended with,
+	// its group was taken before this one by the pool so waiting for it always finishes
+	if (rendering >= 0 && m_groupOrder[slot] < m_groupOrder[rendering])
+	{
+		int iteration;
+		while ((iteration = m_finalIterations[slot]) == ITERATION_PENDING)
+			std::this_thread::yield();
+		return iteration;
+	}
+
+	// only the thread recording the passes of the portal sees it count
+	return m_iterations[slot];
+}
+
+
 void PortalManager::SetRecursionNum(int num)
 {
 	if (num < 0)
 		return;
 
-	m_recursionNum = num; 
+	m_recursionNum = num;
 	SetPortalTechnique(m_technique);
 }
 
-void PortalManager::SetPortalTechnique(PortalTechnique technique)
+void PortalManager::SetPairNum(int num)
 {
-	CManager::ClearRenderPasses();
-	CRenderer::UnbindRenderTargetViews();
-	if (auto portal = m_bluePortal.lock())
+	if (num < 1)
+		return;
+
+	m_pairNum = num;
+	SetShootPair(m_shootPair);
+	SetPortalTechnique(m_technique);
+}
+
+void PortalManager::GetLevelViewport(int slot, int level, D3D11_VIEWPORT& viewport, D3D11_RECT& scissor, dx::XMFLOAT4& textureTransform)
+{
+	if (slot >= 0 && slot < (int)m_levelCells.size() && level >= 0 && level < (int)m_levelCells[slot].size())
 	{
-		portal->SetDestroy();
-		m_bluePortal.reset();
+		const LevelCell& cell = m_levelCells[slot][level];
+		viewport = cell.viewport;
+		scissor = cell.scissor;
+		textureTransform = cell.textureTransform;
+		return;
 	}
-	if (auto portal = m_orangePortal.lock())
+
+	// levels that are not rendered this frame map to the whole texture
+	viewport = { 0.0f, 0.0f, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT, 0.0f, 1.0f };
+	scissor = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+	textureTransform = { 1.0f, 1.0f, 0.0f, 0.0f };
+}
+
+dx::XMFLOAT4 PortalManager::GetLevelTextureTransform(int slot, int level)
+{
+	D3D11_VIEWPORT viewport;
+	D3D11_RECT scissor;
+	dx::XMFLOAT4 textureTransform;
+	GetLevelViewport(slot, level, viewport, scissor, textureTransform);
+
+	return textureTransform;
+}
+
+void PortalManager::PackLevelAtlas()
+{
+	// the vectors keep their memory from frame to frame
+	m_levelCells.resize(m_portals.size());
+	for (auto& cells : m_levelCells)
+		cells.clear();
+	for (auto& atlas : m_levelOpenings)
+		atlas.clear();
+
+	if (m_technique != PortalTechnique::RenderToTexture)
+		return;
+
+	// only the opening a level is seen through has to be rendered, level L goes into atlas L % 2
+	for (int slot = 0; slot < (int)m_portals.size(); ++slot)
 	{
-		portal->SetDestroy();
-		m_orangePortal.reset();
+		auto portal = m_portals[slot].lock();
+		if (!portal)
+			continue;
+
+		int depth = portal->GetVisibleDepth();
+		m_levelCells[slot].resize(std::max(depth + 1, 0));
+		for (int level = 0; level <= depth; ++level)
+		{
+			ScreenRect rect = PortalVisibility::GetScreenRect(slot, level);
+			if (rect.IsEmpty())
+				rect = ScreenRect::FullScreen();
+
+			LevelOpening opening = {};
+			opening.slot = slot;
+			opening.level = level;
+			opening.left = floorf((rect.minX + 1.0f) * 0.5f * SCREEN_WIDTH);
+			opening.top = floorf((1.0f - rect.maxY) * 0.5f * SCREEN_HEIGHT);
+			opening.width = ceilf((rect.maxX + 1.0f) * 0.5f * SCREEN_WIDTH) - opening.left;
+			opening.height = ceilf((1.0f - rect.minY) * 0.5f * SCREEN_HEIGHT) - opening.top;
+			m_levelOpenings[level % 2].push_back(opening);
+		}
 	}
 
-	m_technique = technique;
-	
-	// setup render passes for rendering with render texture
-	if (m_technique == PortalTechnique::RenderToTexture)
+	for (auto& atlas : m_levelOpenings)
 	{
-		// create portal render textures
-		auto bluePortalTexture = std::make_shared<RenderTexture>(3, SCREEN_WIDTH, SCREEN_HEIGHT, RenderTextureType::Custom);
-		CRenderer::BindRenderTargetView(bluePortalTexture);
+		// shrink the deeper levels until everything fits, the level seen directly only once they got small
+		bool packed = false;
+		for (int attempt = 0; attempt < ATLAS_PACK_ATTEMPTS && !packed; ++attempt)
+		{
+			float deepFit = powf(ATLAS_SHRINK_STEP, (float)attempt);
+			float directFit = powf(ATLAS_SHRINK_STEP, (float)std::max(attempt - ATLAS_DEEP_ATTEMPTS, 0));
+			for (auto& opening : atlas)
+			{
+				// every level renders at a fraction of the resolution of the level before it
+				opening.scale = FrameBudget::GetResolutionScale() * std::max(powf(m_levelFalloff, (float)opening.level), PORTAL_MIN_LEVEL_SCALE);
+				opening.scale *= opening.level == 0 ? directFit : deepFit;
 
-		auto blueTempPortalTexture = std::make_shared<RenderTexture>(4, SCREEN_WIDTH, SCREEN_HEIGHT, RenderTextureType::Custom);
-		CRenderer::BindRenderTargetView(blueTempPortalTexture);
-		PortalManager::BindRenderTexture(PortalType::Blue, bluePortalTexture, blueTempPortalTexture);
+				// one extra texel keeps the filtering inside the cell
+				opening.cellWidth = std::min((LONG)ceilf(opening.width * opening.scale) + 1, (LONG)SCREEN_WIDTH);
+				opening.cellHeight = std::min((LONG)ceilf(opening.height * opening.scale) + 1, (LONG)SCREEN_HEIGHT);
+			}
 
-		auto orangePortalTexture = std::make_shared<RenderTexture>(5, SCREEN_WIDTH, SCREEN_HEIGHT, RenderTextureType::Custom);
-		CRenderer::BindRenderTargetView(orangePortalTexture);
+			packed = PackShelves(atlas);
+		}
 
-		auto orangeTempPortalTexture = std::make_shared<RenderTexture>(6, SCREEN_WIDTH, SCREEN_HEIGHT, RenderTextureType::Custom);
-		CRenderer::BindRenderTargetView(orangeTempPortalTexture);
-		PortalManager::BindRenderTexture(PortalType::Orange, orangePortalTexture, orangeTempPortalTexture);
+		// too many openings for the shelves, every level gets an equal cell of a grid instead of overflowing the atlas
+		if (!packed)
+			PackGrid(atlas);
 
-		// render to portal texture (blue portal)
-		RenderPass renderPass = {};
-		renderPass.targetOutput = { bluePortalTexture->GetRenderTargetViewID(), blueTempPortalTexture->GetRenderTargetViewID() };
-		renderPass.clearRTV = true;
-		renderPass.clearDepth = renderPass.clearStencil = true;
-		renderPass.pass = Pass::PortalBlue;
-		CManager::AddRenderPass(renderPass);
-
-		for (int i = 1; i <= m_recursionNum; ++i)
+		// move the opening into its cell
+		for (const auto& opening : atlas)
 		{
-			if (i % 2 == 0)
-				renderPass.targetOutput = { bluePortalTexture->GetRenderTargetViewID() };
-			else
-				renderPass.targetOutput = { blueTempPortalTexture->GetRenderTargetViewID() };
-
-			CManager::AddRenderPass(renderPass);
+			LevelCell& cell = m_levelCells[opening.slot][opening.level];
+			cell.viewport.TopLeftX = opening.x - opening.left * opening.scale;
+			cell.viewport.TopLeftY = opening.y - opening.top * opening.scale;
+			cell.viewport.Width = SCREEN_WIDTH * opening.scale;
+			cell.viewport.Height = SCREEN_HEIGHT * opening.scale;
+			cell.viewport.MinDepth = 0.0f;
+			cell.viewport.MaxDepth = 1.0f;
+
+			cell.scissor.left = opening.x;
+			cell.scissor.top = opening.y;
+			cell.scissor.right = std::min(opening.x + opening.cellWidth, (LONG)SCREEN_WIDTH);
+			cell.scissor.bottom = std::min(opening.y + opening.cellHeight, (LONG)SCREEN_HEIGHT);
+
+			cell.textureTransform = { opening.scale, opening.scale, cell.viewport.TopLeftX / SCREEN_WIDTH, cell.viewport.TopLeftY / SCREEN_HEIGHT };
 		}
+	}
+}
 
-		// render to portal texture (orange portal)
-		renderPass.targetOutput = { orangePortalTexture->GetRenderTargetViewID(), orangeTempPortalTexture->GetRenderTargetViewID() };
-		renderPass.pass = Pass::PortalOrange;
-		CManager::AddRenderPass(renderPass);
+bool PortalManager::PackShelves(std::vector<LevelOpening>& openings)
+{
+	// tallest first so the shelves waste as little height as possible
+	std::sort(openings.begin(), openings.end(), [](const LevelOpening& a, const LevelOpening& b) { return a.cellHeight > b.cellHeight; });
 
-		for (int i = 1; i <= m_recursionNum; ++i)
+	LONG x = 0, y = 0, shelfHeight = 0;
+	bool fits = true;
+	for (auto& opening : openings)
+	{
+		if (x + opening.cellWidth > SCREEN_WIDTH)
 		{
-			if (i % 2 == 0)
-				renderPass.targetOutput = { orangePortalTexture->GetRenderTargetViewID() };
-			else
-				renderPass.targetOutput = { orangeTempPortalTexture->GetRenderTargetViewID() };
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
 
-			CManager::AddRenderPass(renderPass);
+		opening.x = x;
+		opening.y = y;
+		x += opening.cellWidth;
+		shelfHeight = std::max(shelfHeight, opening.cellHeight);
+		fits &= y + opening.cellHeight <= SCREEN_HEIGHT;
+	}
+
+	return fits;
+}
+
+void PortalManager::PackGrid(std::vector<LevelOpening>& openings)
+{
+	LONG columns = (LONG)ceilf(sqrtf((float)openings.size()));
+	LONG rows = ((LONG)openings.size() + columns - 1) / columns;
+	LONG cellWidth = SCREEN_WIDTH / columns;
+	LONG cellHeight = SCREEN_HEIGHT / rows;
+
+	for (size_t i = 0; i < openings.size(); ++i)
+	{
+		LevelOpening& opening = openings[i];
+
+		// the opening shrinks to its cell, minus the extra filtering texel
+		float fit = std::min((cellWidth - 1) / std::max(opening.width, 1.0f), (cellHeight - 1) / std::max(opening.height, 1.0f));
+		opening.scale = std::min(opening.scale, fit);
+		opening.cellWidth = std::min((LONG)ceilf(opening.width * opening.scale) + 1, cellWidth);
+		opening.cellHeight = std::min((LONG)ceilf(opening.height * opening.scale) + 1, cellHeight);
+		opening.x = (LONG)(i % columns) * cellWidth;
+		opening.y = (LONG)(i / columns) * cellHeight;
+	}
+}
+
+void PortalManager::RebuildPortalGrid()
+{
+	m_portalGrid.clear();
+	m_portalGridDirty = false;
+
+	for (int slot = 0; slot < (int)m_portals.size(); ++slot)
+	{
+		auto portal = m_portals[slot].lock();
+		if (!portal)
+			continue;
+
+		// world bounds of the portal, grown so travelers touching the trigger are found from their position
+		dx::XMFLOAT3 localCenter, localExtents;
+		portal->GetLocalBounds(localCenter, localExtents);
+
+		dx::XMFLOAT4X4 world;
+		dx::XMStoreFloat4x4(&world, portal->GetWorldMatrix());
+
+		dx::XMFLOAT3 center;
+		dx::XMStoreFloat3(&center, dx::XMVector3TransformCoord(dx::XMLoadFloat3(&localCenter), dx::XMLoadFloat4x4(&world)));
+
+		dx::XMFLOAT3 extents;
+		extents.x = fabsf(world._11) * localExtents.x + fabsf(world._21) * localExtents.y + fabsf(world._31) * localExtents.z + PORTAL_GRID_MARGIN;
+		extents.y = fabsf(world._12) * localExtents.x + fabsf(world._22) * localExtents.y + fabsf(world._32) * localExtents.z + PORTAL_GRID_MARGIN;
+		extents.z = fabsf(world._13) * localExtents.x + fabsf(world._23) * localExtents.y + fabsf(world._33) * localExtents.z + PORTAL_GRID_MARGIN;
+
+		int minX = (int)floorf((center.x - extents.x) / PORTAL_GRID_CELL_SIZE), maxX = (int)floorf((center.x + extents.x) / PORTAL_GRID_CELL_SIZE);
+		int minY = (int)floorf((center.y - extents.y) / PORTAL_GRID_CELL_SIZE), maxY = (int)floorf((center.y + extents.y) / PORTAL_GRID_CELL_SIZE);
+		int minZ = (int)floorf((center.z - extents.z) / PORTAL_GRID_CELL_SIZE), maxZ = (int)floorf((center.z + extents.z) / PORTAL_GRID_CELL_SIZE);
+
+		for (int x = minX; x <= maxX; ++x)
+			for (int y = minY; y <= maxY; ++y)
+				for (int z = minZ; z <= maxZ; ++z)
+					m_portalGrid[GridKey(x, y, z)].push_back(slot);
+	}
+}
+
+int PortalManager::FindEntrancePortal(const std::shared_ptr<PortalTraveler>& traveler)
+{
+	dx::XMFLOAT3 position;
+	dx::XMStoreFloat3(&position, traveler->GetTravelerPosition());
+
+	auto cell = m_portalGrid.find(GridKey(
+		(int)floorf(position.x / PORTAL_GRID_CELL_SIZE),
+		(int)floorf(position.y / PORTAL_GRID_CELL_SIZE),
+		(int)floorf(position.z / PORTAL_GRID_CELL_SIZE)));
+
+	if (cell == m_portalGrid.end())
+		return PORTAL_NONE;
+
+	// keep the current entrance if it still collides so overlapping triggers dont flicker between portals
+	int current = traveler->GetEntrancePortal();
+	int found = PORTAL_NONE;
+	for (int slot : cell->second)
+	{
+		auto portal = GetPortal(slot);
+		if (!portal || !portal->GetLinkedPortal())
+			continue;
+
+		dx::XMFLOAT3 col = Collision::ObbObbCollision(portal->GetTriggerCollider(), traveler->GetOBB());
+		if (col.x == 0 && col.y == 0 && col.z == 0)
+			continue;
+
+		if (slot == current)
+			return slot;
+		if (found == PORTAL_NONE)
+			found = slot;
+	}
+
+	return found;
+}
+
+void PortalManager::SortStencilPasses()
+{
+	// the farthest portal is drawn first so the nearer ones end up on top
+	auto camera = CManager::GetActiveScene()->GetMainCamera();
+	std::vector<std::pair<float, int>> order;
+	for (int slot = 0; slot < (int)m_portals.size(); ++slot)
+	{
+		float depth = -FLT_MAX;
+		if (auto portal = m_portals[slot].lock())
+			depth = dx::XMVectorGetZ(dx::XMVector3Transform(portal->GetPosition(), camera->GetViewMatrix()));
+
+		order.emplace_back(depth, slot);
+	}
+	std::stable_sort(order.begin(), order.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+
+	// every portal owns a group of write, inside and frame passes, the frame graph runs the groups by priority
+	std::vector<int> rank(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		rank[order[i].second] = (int)i;
+
+	for (auto& renderPass : *CManager::GetRenderPasses())
+		if (renderPass.pass == Pass::Portal || renderPass.pass == Pass::PortalFrame)
+			renderPass.priority = rank[renderPass.portal];
+}
+
+void PortalManager::SetPortalTechnique(PortalTechnique technique)
+{
+	CManager::ClearRenderPasses();
+	for (auto& p : m_portals)
+	{
+		if (auto portal = p.lock())
+			portal->SetDestroy();
+	}
+
+	// hand the textures back to the pool, the next lease of the same size gets them again without allocating
+	for (auto& atlas : m_levelAtlas)
+	{
+		RenderTexturePool::Release(atlas);
+		atlas.reset();
+	}
+	for (auto& texture : m_renderTexturesHistory)
+		RenderTexturePool::Release(texture);
+
+	int slotNum = m_pairNum * 2;
+	m_portals.assign(slotNum, std::weak_ptr<Portal>());
+	m_renderTexturesHistory.assign(slotNum, nullptr);
+	m_levelCells.clear();
+	m_portalGridDirty = true;
+
+	m_technique = technique;
+	FrameBudget::SetMaxRecursionDepth(m_recursionNum);
+
+	// the shadow maps are drawn before any of the views that receive them
+	ShadowCache::AddRenderPasses();
+
+	// setup render passes for rendering with render texture
+	if (m_technique == PortalTechnique::RenderToTexture)
+	{
+		// the portals render one after another, so a level atlas is shared by all of them instead of every portal owning two textures,
+		// only the final texture of the last frame is kept per portal
+		for (auto& atlas : m_levelAtlas)
+			atlas = RenderTexturePool::Acquire(SCREEN_WIDTH, SCREEN_HEIGHT);
+		for (int slot = 0; slot < slotNum; ++slot)
+			m_renderTexturesHistory[slot] = RenderTexturePool::Acquire(SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+
+	// textures of removed pairs or of the other technique are freed instead of kept for a lease that may never come
+	RenderTexturePool::Trim();
+
+	if (m_technique == PortalTechnique::RenderToTexture)
+	{
+
+		for (int slot = 0; slot < slotNum; ++slot)
+		{
+			RenderPass renderPass = {};
+			renderPass.clearDepth = renderPass.clearStencil = true;
+			renderPass.scaledViewport = true;
+			renderPass.pass = Pass::Portal;
+			renderPass.portal = slot;
+
+			// the deepest view is rendered first, every level writes its own cell and reads the level behind it,
+			// the frame graph clears each atlas before the first level written into it
+			for (int level = m_recursionNum; level >= 0; --level)
+			{
+				renderPass.targetOutput = { m_levelAtlas[level % 2]->GetRenderTargetViewID() };
+				renderPass.targetInput = { m_levelAtlas[(level + 1) % 2]->GetRenderTargetViewID() };
+				renderPass.recursionLevel = level;
+				CManager::AddRenderPass(renderPass);
+			}
 		}
 
-		// finally draw everything
-		renderPass = {};
+		// finally draw everything, the portals show the first level of their cell
+		RenderPass renderPass = {};
 		renderPass.targetOutput = { 1 };
+		renderPass.targetInput = { m_levelAtlas[0]->GetRenderTargetViewID() };
 		renderPass.pass = Pass::Default;
 		renderPass.overrideShader = nullptr;
-		renderPass.clearRTV = true;
 		renderPass.clearDepth = renderPass.clearStencil = true;
 		CManager::AddRenderPass(renderPass);
 
 		// draw portal backface
+		renderPass.targetInput.clear();
 		renderPass.overrideShader = CRenderer::GetShader<PortalBackfaceShader>();
 		renderPass.pass = Pass::PortalBackface;
-		renderPass.clearRTV = false;
 		renderPass.clearDepth = false;
 		renderPass.clearStencil = false;
 		CManager::AddRenderPass(renderPass);
@@ -370,47 +670,38 @@ void PortalManager::SetPortalTechnique(PortalTechnique technique)
 		RenderPass renderPass = {};
 		renderPass.targetOutput = { 1 };
 
-		// write stencil inside blue portal
-		renderPass.pass = Pass::PortalBlue;
-		renderPass.overrideShader = CRenderer::GetShader<PortalStencilShader>();
-		renderPass.clearRTV = true;
-		renderPass.clearStencil = true;
-		renderPass.clearDepth = true;
-		CManager::AddRenderPass(renderPass);
-
-		// inside blue portal
-		renderPass.overrideShader = nullptr;
-		renderPass.clearRTV = false;
-		renderPass.clearStencil = false;
-		renderPass.clearDepth = true;
-		for (int i = 0; i <= m_recursionNum; ++i)
+		// one group per portal, the priority of the groups is sorted by depth every frame
+		for (int slot = 0; slot < slotNum; ++slot)
+		{
+			// write stencil inside portal
+			renderPass.pass = Pass::Portal;
+			renderPass.portal = slot;
+			renderPass.priority = slot;
+			renderPass.overrideShader = CRenderer::GetShader<PortalStencilShader>();
+			renderPass.clearStencil = true;
+			renderPass.clearDepth = true;
+			renderPass.recursionLevel = 0;
 			CManager::AddRenderPass(renderPass);
 
-		// render portal blue frame
-		renderPass.pass = Pass::PortalBlueFrame;
-		renderPass.overrideShader = CRenderer::GetShader<PortalStencilShader>();
-		CManager::AddRenderPass(renderPass);
-
-		// write stencil inside orange portal
-		renderPass.pass = Pass::PortalOrange;
-		renderPass.overrideShader = CRenderer::GetShader<PortalStencilShader>();
-		renderPass.clearStencil = true;
-		renderPass.clearDepth = true;
-		CManager::AddRenderPass(renderPass);
+			// inside portal
+			renderPass.overrideShader = nullptr;
+			renderPass.clearStencil = false;
+			renderPass.clearDepth = true;
+			for (int i = 0; i <= m_recursionNum; ++i)
+			{
+				renderPass.recursionLevel = i;
+				CManager::AddRenderPass(renderPass);
+			}
 
-		// inside orange portal
-		renderPass.overrideShader = nullptr;
-		renderPass.clearStencil = false;
-		renderPass.clearDepth = true;
-		for (int i = 0; i <= m_recursionNum; ++i)
+			// render portal frame
+			renderPass.pass = Pass::PortalFrame;
+			renderPass.overrideShader = CRenderer::GetShader<PortalStencilShader>();
+			renderPass.recursionLevel = 0;
 			CManager::AddRenderPass(renderPass);
+		}
 
-		// render portal orange frame
-		renderPass.pass = Pass::PortalOrangeFrame;
-		renderPass.overrideShader = CRenderer::GetShader<PortalStencilShader>();
-		CManager::AddRenderPass(renderPass);
-
-		// draw both portals and frames into depth
+		// draw every portal and frame into depth, after all of the groups
+		renderPass.priority = slotNum;
 		renderPass.overrideShader = CRenderer::GetShader<PortalStencilShader>();
 		renderPass.pass = Pass::Default;
 		renderPass.clearDepth = true;
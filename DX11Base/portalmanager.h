@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
 #include "portal.h"
 
 
@@ -13,23 +16,106 @@ public:
 	static void SetPortalTechnique(PortalTechnique technique);
 	static PortalTechnique GetPortalTechnique() { return m_technique; }
 
-	static void CreatePortal(PortalType type, dx::XMFLOAT3 position, dx::XMFLOAT3 lookAt, dx::XMFLOAT3 up);
-	static dx::XMMATRIX GetProjectionMatrix(PortalType type);
-	static dx::XMMATRIX GetViewMatrix(PortalType type);
-	static std::shared_ptr<Portal> GetPortal(PortalType type);
-	static std::shared_ptr<Portal> GetLinkedPortal(PortalType type);
+	// the player shoots the portals of the shoot pair
+	static void CreatePortal(PortalType type, dx::XMFLOAT3 position, dx::XMFLOAT3 lookAt, dx::XMFLOAT3 up) { CreatePortal(m_shootPair, type, position, lookAt, up); }
+	static void CreatePortal(int pair, PortalType type, dx::XMFLOAT3 position, dx::XMFLOAT3 lookAt, dx::XMFLOAT3 up);
+	static void DestroyPortal(int slot);
+	static dx::XMMATRIX GetProjectionMatrix(int slot);
+	static dx::XMMATRIX GetViewMatrix(int slot);
+	static std::shared_ptr<Portal> GetPortal(int slot);
+	static std::shared_ptr<Portal> GetPortal(PortalType type) { return GetPortal(PortalSlot(0, type)); }
+	static std::shared_ptr<Portal> GetLinkedPortal(int slot) { return GetPortal(LinkedPortalSlot(slot)); }
+	static int GetSlotNum() { return (int)m_portals.size(); }
+
+	// slot of the portal whose pass is being drawn, PORTAL_NONE outside of portal passes
+	static int GetRenderingPortal();
+
+	// called around portal passes recorded on worker threads, groups are the portal slots in the order their passes run,
+	// fills the transform caches and keeps the iteration of every portal so the passes of one portal never see another portal
+	// counting its levels on a different thread, a portal whose group runs earlier is seen at the iteration its group ended with
+	static void BeginParallelRecording(const std::vector<int>& groups);
+	static void EndGroupRecording(int slot);
+	static void EndParallelRecording() { m_parallelRecording = false; }
+
+	// iteration the portal in the slot is at for the pass being drawn, -1 if there is no portal
+	static int GetCurrentIteration(int slot);
 
-	static void BindRenderTexture(PortalType type, const std::shared_ptr<RenderTexture>& renderTexture, const std::shared_ptr<RenderTexture>& renderTextureTemp);
 	static int GetRecursionNum() { return m_recursionNum; }
 	static void SetRecursionNum(int num);
 
+	// number of linked pairs the render passes are set up for, changing it recreates the portals
+	static int GetPairNum() { return m_pairNum; }
+	static void SetPairNum(int num);
+
+	// pair the next shot portal goes into, the player cycles through the pairs
+	static int GetShootPair() { return m_shootPair; }
+	static void SetShootPair(int pair) { m_shootPair = std::min(std::max(pair, 0), m_pairNum - 1); }
+
+	// deepest levels reprojected from the last frame instead of rendered, render texture technique only
+	static int GetReprojectionLevels() { return m_technique == PortalTechnique::RenderToTexture ? m_reprojectionLevels : 0; }
+	static void SetReprojectionLevels(int levels) { m_reprojectionLevels = std::max(levels, 0); }
+
+	// resolution of a recursion level relative to the level before it, render texture technique only
+	static float GetLevelFalloff() { return m_levelFalloff; }
+	static void SetLevelFalloff(float falloff) { m_levelFalloff = std::min(std::max(falloff, 0.1f), 1.0f); }
+
+	// viewport and scissor rendering the opening a level is seen through into its cell of the level atlas,
+	// the texture transform maps screen texcoords to that cell
+	static void GetLevelViewport(int slot, int level, D3D11_VIEWPORT& viewport, D3D11_RECT& scissor, dx::XMFLOAT4& textureTransform);
+	static dx::XMFLOAT4 GetLevelTextureTransform(int slot, int level);
+
 	static void AddPortalTraveler(const std::shared_ptr<class PortalTraveler>& traveler) { m_travelers.push_back(traveler); };
 
 private:
-	static std::weak_ptr<Portal> m_bluePortal, m_orangePortal;
-	static std::weak_ptr<RenderTexture> m_renderTexBlue, m_renderTexOrange, m_renderTexBlueTemp, m_renderTexOrangeTemp;
+	static std::vector<std::weak_ptr<Portal>> m_portals;
+	// every portal shares the two level atlases, even levels go into the first and odd levels into the second
+	static std::shared_ptr<RenderTexture> m_levelAtlas[2];
+	static std::vector<std::shared_ptr<RenderTexture>> m_renderTexturesHistory;
 	static int m_recursionNum;
+	static int m_pairNum;
+	static int m_shootPair;
+	static int m_reprojectionLevels;
+	static float m_levelFalloff;
 	static PortalTechnique m_technique;
 
 	static std::vector<std::weak_ptr<class PortalTraveler>> m_travelers;
+
+	// iteration of every slot when the parallel recording started and once the passes of its group were recorded,
+	// and the position of the group of every slot in the run
+	static std::vector<int> m_iterations;
+	static std::vector<std::atomic<int>> m_finalIterations;
+	static std::vector<int> m_groupOrder;
+	static bool m_parallelRecording;
+
+	// uniform grid over the portal triggers so a traveler only tests the portals around it
+	static std::unordered_map<uint64_t, std::vector<int>> m_portalGrid;
+	static bool m_portalGridDirty;
+
+	// where each rendered level of each portal was packed into its atlas this frame
+	struct LevelCell
+	{
+		D3D11_VIEWPORT viewport;
+		D3D11_RECT scissor;
+		dx::XMFLOAT4 textureTransform;
+	};
+
+	// opening of a level on screen in pixels and the cell it is packed into
+	struct LevelOpening
+	{
+		int slot, level;
+		float left, top, width, height;
+		float scale;
+		LONG x, y, cellWidth, cellHeight;
+	};
+
+	static std::vector<std::vector<LevelCell>> m_levelCells;
+	static std::vector<LevelOpening> m_levelOpenings[2];
+
+	static void PackLevelAtlas();
+	static bool PackShelves(std::vector<LevelOpening>& openings);
+	static void PackGrid(std::vector<LevelOpening>& openings);
+	static void RebuildPortalGrid();
+	static int FindEntrancePortal(const std::shared_ptr<class PortalTraveler>& traveler);
+	static void SortStencilPasses();
+	static uint64_t GridKey(int x, int y, int z) { return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF); }
 };
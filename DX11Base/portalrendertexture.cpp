@@ -4,8 +4,14 @@
 #include "manager.h"
 #include "fpscamera.h"
 #include "debug.h"
+#include "portalmanager.h"
 #include "portalbackfaceshader.h"
 
+// how far the camera may move or turn away from the last full render before the deepest levels are rendered again
+#define REPROJECT_MAX_DISTANCE 0.5f
+#define REPROJECT_MIN_FORWARD_DOT 0.995f
+#define REPROJECT_MAX_PORTAL_MOVE 0.001f
+
 
 void PortalRenderTexture::Awake()
 {
@@ -13,6 +19,9 @@ void PortalRenderTexture::Awake()
 
 	// get the shader
 	m_shader = CRenderer::GetShader<PortalRenderTextureShader>();
+
+	// every pass with the own shader resets the depth stencil state for the objects after it
+	SetPassMask(PASS_MASK_ALL, PassBit(Pass::PortalBackface));
 }
 
 void PortalRenderTexture::Uninit()
@@ -24,7 +33,23 @@ void PortalRenderTexture::Update()
 {
 	Portal::Update();
 
-	m_curIteration = m_iterationNum;
+	m_startIteration = m_curIteration = m_iterationNum;
+	SetupNextIteration();
+}
+
+void PortalRenderTexture::SetVisibleDepth(int depth)
+{
+	// the deepest levels come from last frame while nothing moved too far since the last full render
+	m_reproject = depth >= 0 && PortalManager::GetReprojectionLevels() > 0 && CanReproject();
+	if (m_reproject)
+		depth = std::max(depth - PortalManager::GetReprojectionLevels(), 0);
+	else if (depth < 0)
+		m_historyValid = false;
+
+	Portal::SetVisibleDepth(depth);
+
+	// start at the deepest visible level, the passes of the deeper levels are skipped
+	m_startIteration = m_curIteration = std::min(depth, m_iterationNum);
 	SetupNextIteration();
 }
 
@@ -70,7 +95,7 @@ void PortalRenderTexture::Draw(Pass pass)
 		if (Debug::cameraNum == 1 || Debug::cameraNum == 2)
 			active = false;
 
-		m_shader->SetValueBuffer(active);
+		m_shader->SetValueBuffer(active, PortalManager::GetLevelTextureTransform(m_slot, 0));
 		if(active)
 			if (auto texture = m_activeRenderTexture.lock())
 				m_shader->SetTexture(texture->GetRenderTexture());
@@ -89,21 +114,14 @@ void PortalRenderTexture::Draw(Pass pass)
 	}
 
 	// draw the view from portal recursively into render texture
-	else if(m_linkedPortal.lock() && ((pass == Pass::PortalBlue && m_type == PortalType::Blue) || (pass == Pass::PortalOrange && m_type == PortalType::Orange)))
+	else if(m_linkedPortal.lock() && pass == Pass::Portal && PortalManager::GetRenderingPortal() == m_slot)
 	{
-		// skip last iteration to prevent drawing a black portal
-		if (m_curIteration != m_iterationNum)
+		// skip last iteration to prevent drawing a black portal, unless it can be filled from the last frame
+		bool deepest = m_curIteration == m_startIteration;
+		if (!deepest || m_reproject)
 		{
-			if (pass == Pass::PortalBlue && m_type == PortalType::Blue)
-			{
-				m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(PortalType::Blue));
-				m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(PortalType::Blue));
-			}
-			else if (pass == Pass::PortalOrange && m_type == PortalType::Orange)
-			{
-				m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(PortalType::Orange));
-				m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(PortalType::Orange));
-			}
+			m_shader->SetViewMatrix(&GetViewMatrix());
+			m_shader->SetProjectionMatrix(&GetProjectionMatrix());
 
 			// move the portal a little forward to prevent z fighting
 			dx::XMMATRIX world = GetFakeWorldMatrix();
@@ -119,10 +137,23 @@ void PortalRenderTexture::Draw(Pass pass)
 			if (Debug::cameraNum == 1 || Debug::cameraNum == 2)
 				active = false;
 
-			m_shader->SetValueBuffer(active);
-			if (active)
-				if (auto texture = m_activeRenderTexture.lock())
-					m_shader->SetTexture(texture->GetRenderTexture());
+			if (deepest)
+			{
+				// the level behind was not rendered, reproject what the main camera saw through this portal last frame
+				dx::XMMATRIX history = dx::XMLoadFloat4x4(&m_historyViewProjection);
+				m_shader->SetHistoryMatrix(&history);
+				m_shader->SetValueBuffer(active, m_historyTransform, true);
+				if (active)
+					if (auto texture = m_historyRenderTexture.lock())
+						m_shader->SetTexture(texture->GetRenderTexture());
+			}
+			else
+			{
+				m_shader->SetValueBuffer(active, PortalManager::GetLevelTextureTransform(m_slot, m_curIteration + 1));
+				if (active)
+					if (auto texture = m_activeRenderTexture.lock())
+						m_shader->SetTexture(texture->GetRenderTexture());
+			}
 
 			// draw the model
 			CRenderer::DrawModel(m_shader, m_model, false);
@@ -132,68 +163,91 @@ void PortalRenderTexture::Draw(Pass pass)
 		SetupNextIteration();
 		if (m_curIteration == 0)
 			CRenderer::SetDepthStencilState(6, 0);
+
+		// the last level is done, keep the final texture for the next frame
+		if (m_curIteration < 0)
+			CaptureHistory();
 	}
 	else
 		CRenderer::SetDepthStencilState(6, 0);
 }
 
-dx::XMMATRIX PortalRenderTexture::GetViewMatrix(bool firstIteration)
+void PortalRenderTexture::SetupNextIteration()
 {
-	if (auto linkedPortal = m_linkedPortal.lock())
+	// the level behind the current one is read, even levels are in the render texture and odd levels in the temp texture
+	if ((m_curIteration + 1) % 2 == 0)
 	{
-		// player camera world -> in portal local -> rotate locally by y 180 -> out portal world
-		auto mainCam = std::static_pointer_cast<FPSCamera>(CManager::GetActiveScene()->GetMainCamera());
-		int iterationNum = firstIteration ? 0 : m_curIteration;
-
-		// repeat transformation to get the right position for current iteration
-		dx::XMMATRIX out, cam;
-		cam = mainCam->GetLocalToWorldMatrix(false);
-		for (int i = 0; i <= iterationNum; ++i)
-		{
-			out = cam;
-			out *= dx::XMMatrixInverse(nullptr, GetWorldMatrix());
-			out *= dx::XMMatrixRotationY(dx::XMConvertToRadians(180));
-			out *= linkedPortal->GetWorldMatrix();
-			cam = out;
-		}
-
-		dx::XMFLOAT4X4 fout;
-		dx::XMStoreFloat4x4(&fout, cam);
-
-		dx::XMVECTOR forward = dx::XMVectorSet(fout._31, fout._32, fout._33, 0);
-		dx::XMVECTOR up = dx::XMVectorSet(fout._21, fout._22, fout._23, 0);
-		dx::XMVECTOR eye = dx::XMVectorSet(fout._41, fout._42, fout._43, 1);
-
-		return dx::XMMatrixLookToLH(eye, forward, up);
+		if (auto texture = m_renderTexture.lock())
+			m_activeRenderTexture = texture;
+	}
+	else
+	{
+		if (auto texture = m_tempRenderTexture.lock())
+			m_activeRenderTexture = texture;
 	}
 }
 
-void PortalRenderTexture::SetupNextIteration()
+bool PortalRenderTexture::CanReproject() const
 {
-	if (m_iterationNum % 2 == 0)
+	if (!m_historyValid || !m_historyRenderTexture.lock() || !m_linkedPortal.lock())
+		return false;
+
+	auto camera = std::static_pointer_cast<FPSCamera>(CManager::GetActiveScene()->GetMainCamera());
+	dx::XMMATRIX cam = camera->GetLocalToWorldMatrix(false);
+
+	// camera moved or turned too far from the last full render
+	dx::XMVECTOR moved = dx::XMVectorSubtract(cam.r[3], dx::XMLoadFloat3(&m_fullRenderPosition));
+	if (dx::XMVectorGetX(dx::XMVector3LengthSq(moved)) > REPROJECT_MAX_DISTANCE * REPROJECT_MAX_DISTANCE)
+		return false;
+
+	dx::XMVECTOR forward = dx::XMVector3Normalize(cam.r[2]);
+	if (dx::XMVectorGetX(dx::XMVector3Dot(forward, dx::XMLoadFloat3(&m_fullRenderForward))) < REPROJECT_MIN_FORWARD_DOT)
+		return false;
+
+	// one of the two portals moved
+	dx::XMFLOAT4X4 portalToPortal;
+	dx::XMStoreFloat4x4(&portalToPortal, GetPortalToPortalMatrix());
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			if (fabsf(portalToPortal.m[i][j] - m_fullRenderPortalToPortal.m[i][j]) > REPROJECT_MAX_PORTAL_MOVE)
+				return false;
+
+	return true;
+}
+
+void PortalRenderTexture::CaptureHistory()
+{
+	auto history = m_historyRenderTexture.lock();
+	auto texture = m_activeRenderTexture.lock();
+	if (!history || !texture)
+		return;
+
+	// the null backend drops the copy, the history would be whatever was in the texture before
+	if (!CRenderer::IsD3D11Backend())
 	{
-		if (m_curIteration % 2 == 0)
-		{
-			if (auto texture = m_tempRenderTexture.lock())
-				m_activeRenderTexture = texture;
-		}
-		else
-		{
-			if (auto texture = m_renderTexture.lock())
-				m_activeRenderTexture = texture;
-		}
+		m_historyValid = false;
+		return;
 	}
-	else
+
+	// only the cell of the final level is copied, to the same place so the texture transform stays valid
+	D3D11_VIEWPORT viewport;
+	D3D11_RECT scissor;
+	PortalManager::GetLevelViewport(m_slot, 0, viewport, scissor, m_historyTransform);
+
+	// recorded so it runs after the draws of this pass
+	CRenderer::CopyTextureRegion(history->GetTexture(), texture->GetTexture(), scissor);
+
+	// the main camera shows the final texture this frame, remember how it projects
+	auto camera = std::static_pointer_cast<FPSCamera>(CManager::GetActiveScene()->GetMainCamera());
+	dx::XMStoreFloat4x4(&m_historyViewProjection, CManager::GetViewMatrix() * CManager::GetProjectionMatrix());
+	m_historyValid = true;
+
+	// a full render is the new reference for how far the reprojection may drift
+	if (!m_reproject)
 	{
-		if (m_curIteration % 2 == 0)
-		{
-			if (auto texture = m_renderTexture.lock())
-				m_activeRenderTexture = texture;
-		}
-		else
-		{
-			if (auto texture = m_tempRenderTexture.lock())
-				m_activeRenderTexture = texture;
-		}
+		dx::XMMATRIX cam = camera->GetLocalToWorldMatrix(false);
+		dx::XMStoreFloat3(&m_fullRenderPosition, cam.r[3]);
+		dx::XMStoreFloat3(&m_fullRenderForward, dx::XMVector3Normalize(cam.r[2]));
+		dx::XMStoreFloat4x4(&m_fullRenderPortalToPortal, GetPortalToPortalMatrix());
 	}
 }
@@ -17,13 +17,12 @@ public:
 	void Draw(Pass pass) override;
 	void Draw(const std::shared_ptr<class Shader>& shader, Pass pass) override;
 
-	// setters
+	// setters, the textures are the level atlases shared by every portal
 	void SetRenderTexture(const std::shared_ptr<RenderTexture>& renderTexture) override { m_renderTexture = renderTexture; }
 	void SetTempRenderTexture(const std::shared_ptr<RenderTexture>& renderTexture) override { m_tempRenderTexture = renderTexture; }
+	void SetHistoryRenderTexture(const std::shared_ptr<RenderTexture>& renderTexture) override { m_historyRenderTexture = renderTexture; m_historyValid = false; }
 	void SetRecursionNum(uint32_t num) override { m_iterationNum = num; }
-
-	// getters
-	dx::XMMATRIX GetViewMatrix(bool firstIteration) override;
+	void SetVisibleDepth(int depth) override;
 
 private:
 	std::shared_ptr<PortalRenderTextureShader> m_shader;
@@ -33,6 +32,21 @@ private:
 	std::weak_ptr<RenderTexture> m_activeRenderTexture;
 
 	int m_iterationNum;
+	int m_startIteration;
+
+	// final texture of the last frame, reprojected in place of the deepest levels
+	std::weak_ptr<RenderTexture> m_historyRenderTexture;
+	dx::XMFLOAT4X4 m_historyViewProjection;
+	dx::XMFLOAT4 m_historyTransform;
+	bool m_historyValid = false;
+	bool m_reproject = false;
+
+	// camera and portal placement of the last full render, reprojection stops once they moved too far from it
+	dx::XMFLOAT3 m_fullRenderPosition, m_fullRenderForward;
+	dx::XMFLOAT4X4 m_fullRenderPortalToPortal;
 
+	int GetRecursionLevel() const override { return m_curIteration; }
 	void SetupNextIteration();
+	bool CanReproject() const;
+	void CaptureHistory();
 };
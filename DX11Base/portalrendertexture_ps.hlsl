@@ -7,6 +7,8 @@ SamplerState g_SamplerState : register( s0 );
 cbuffer ValueBuffer : register(b0)
 {
     bool EnableTexture;
+    bool Reproject;
+    float4 TextureTransform;
 }
 
 struct MATERIAL
@@ -31,15 +33,22 @@ struct PixelOut
 //=============================================================================
 PixelOut main(in float2 inScreenTexCoord    : TEXCOORD0,
 			  in float4 inPosition          : SV_POSITION,
-              in float2 inTexCoord          : TEXCOORD1)
+              in float2 inTexCoord          : TEXCOORD1,
+              in float4 inHistoryTexCoord   : TEXCOORD2)
 {
     PixelOut pixel = (PixelOut) 0;
     
+    // inside the portal, reprojected from the previous frame
+    if(EnableTexture && Reproject)
+    {
+        inHistoryTexCoord.xy /= inHistoryTexCoord.w;
+        pixel.color = g_Texture.Sample(g_SamplerState, inHistoryTexCoord.xy * TextureTransform.xy + TextureTransform.zw);
+    }
     // inside the portal
-    if(EnableTexture)
+    else if(EnableTexture)
     {
         inScreenTexCoord.xy /= inPosition.w;
-        pixel.color = g_Texture.Sample(g_SamplerState, inScreenTexCoord);
+        pixel.color = g_Texture.Sample(g_SamplerState, inScreenTexCoord * TextureTransform.xy + TextureTransform.zw);
     }
     else
         pixel.color.rgb = float3(0,0,0);
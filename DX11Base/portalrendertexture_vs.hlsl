@@ -20,6 +20,11 @@ cbuffer ProjectionBuffer : register( b2 )
 	matrix Projection;
 }
 
+cbuffer HistoryBuffer : register( b3 )
+{
+	matrix HistoryViewProjection;
+}
+
 
 //=============================================================================
 // _VF[_
@@ -31,7 +36,8 @@ void main(in float4 inPosition           : POSITION0,
 
 			out float2 outScreenTexCoord : TEXCOORD0,
 			out float4 outPosition       : SV_POSITION,
-            out float2 outTexCoord       : TEXCOORD1)
+            out float2 outTexCoord       : TEXCOORD1,
+            out float4 outHistoryTexCoord : TEXCOORD2)
 {
 	matrix wvp;
 	wvp = mul(World, View);
@@ -43,4 +49,9 @@ void main(in float4 inPosition           : POSITION0,
     float4 o = outPosition * 0.5f;
     o.xy = float2(o.x, -o.y) + o.w;
 	outScreenTexCoord = o;
+
+    // where the same point was on screen when the history texture was rendered
+    float4 h = mul(mul(inPosition, World), HistoryViewProjection) * 0.5f;
+    h.xy = float2(h.x, -h.y) + h.w;
+    outHistoryTexCoord = h;
 }
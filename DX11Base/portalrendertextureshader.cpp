@@ -55,6 +55,7 @@ void PortalRenderTextureShader::Init()
 			buffer,
 			fsize,
 			&m_vertexLayout);
+		CreatePackedVertexLayout(buffer, fsize);
 
 		delete[] buffer;
 	}
@@ -85,8 +86,9 @@ void PortalRenderTextureShader::Init()
 	device->CreateBuffer(&hBufferDesc, NULL, &m_worldBuffer);
 	device->CreateBuffer(&hBufferDesc, NULL, &m_viewBuffer);
 	device->CreateBuffer(&hBufferDesc, NULL, &m_projectionBuffer);
+	device->CreateBuffer(&hBufferDesc, NULL, &m_historyBuffer);
 
-	hBufferDesc.ByteWidth = sizeof(dx::XMFLOAT4);
+	hBufferDesc.ByteWidth = sizeof(dx::XMFLOAT4) * 2;
 	device->CreateBuffer(&hBufferDesc, NULL, &m_valueBuffer);
 
 	hBufferDesc.ByteWidth = sizeof(MATERIAL);
@@ -108,4 +110,6 @@ void PortalRenderTextureShader::Init()
 void PortalRenderTextureShader::Uninit()
 {
 	Shader::Uninit();
+
+	if (m_historyBuffer) m_historyBuffer->Release();
 }
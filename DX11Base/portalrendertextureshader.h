@@ -17,58 +17,70 @@ public:
 		deviceContext->IASetInputLayout(m_vertexLayout);
 
 		// set constant buffers
-		deviceContext->VSSetConstantBuffers(0, 1, &m_worldBuffer);
-		deviceContext->VSSetConstantBuffers(1, 1, &m_viewBuffer);
-		deviceContext->VSSetConstantBuffers(2, 1, &m_projectionBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 0, m_worldBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 1, m_viewBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 2, m_projectionBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 3, m_historyBuffer);
 
-		deviceContext->PSSetConstantBuffers(0, 1, &m_valueBuffer);
-		deviceContext->PSSetConstantBuffers(1, 1, &m_materialBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 0, m_valueBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 1, m_materialBuffer);
 
 		deviceContext->PSSetShaderResources(1, 1, &m_maskTexture);
 	}
 
-	void SetValueBuffer(int enableTexture)
+	// the texture transform maps screen texcoords to the part of the texture the level was rendered into
+	void SetValueBuffer(int enableTexture, const dx::XMFLOAT4& textureTransform = { 1, 1, 0, 0 }, int reproject = false)
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_valueBuffer, 0, NULL, &enableTexture, 0, 0);
+		struct { int enableTexture; int reproject; float padding[2]; dx::XMFLOAT4 textureTransform; } value = { enableTexture, reproject, {}, textureTransform };
+		CRenderer::UpdateConstantBuffer(m_valueBuffer, &value, sizeof(value));
+	}
+
+	// view projection the history texture was rendered for, used when reprojecting
+	void SetHistoryMatrix(dx::XMMATRIX* HistoryMatrix)
+	{
+		dx::XMMATRIX history = *HistoryMatrix;
+		history = dx::XMMatrixTranspose(history);
+		CRenderer::UpdateConstantBuffer(m_historyBuffer, &history, sizeof(history));
 	}
 
 	void SetMaterial(MATERIAL material) override
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_materialBuffer, 0, NULL, &material, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_materialBuffer, &material, sizeof(material));
 	}
 
 	void SetWorldMatrix(dx::XMMATRIX *WorldMatrix) override
 	{
 		dx::XMMATRIX world = *WorldMatrix;
 		world = dx::XMMatrixTranspose(world);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_worldBuffer, 0, NULL, &world, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_worldBuffer, &world, sizeof(world));
 	}
 
 	void SetViewMatrix(dx::XMMATRIX *ViewMatrix) override
 	{
 		dx::XMMATRIX view = *ViewMatrix;
 		view = dx::XMMatrixTranspose(view);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_viewBuffer, 0, NULL, &view, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_viewBuffer, &view, sizeof(view));
 	}
 
 	void SetProjectionMatrix(dx::XMMATRIX *ProjectionMatrix) override
 	{
 		dx::XMMATRIX projection = *ProjectionMatrix;
 		projection = dx::XMMatrixTranspose(projection);
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_projectionBuffer, 0, NULL, &projection, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_projectionBuffer, &projection, sizeof(projection));
 	}
 
 	void SetTexture(ID3D11ShaderResourceView* texture) override
 	{
-		CRenderer::GetDeviceContext()->PSSetShaderResources(0, 1, &texture);
+		CRenderer::SetShaderResource(ShaderStage::Pixel, 0, texture);
 	}
 
 	void SetSamplerState(ID3D11SamplerState* sampler) override
 	{
-		CRenderer::GetDeviceContext()->PSSetSamplers(0, 1, &sampler);
+		CRenderer::SetSampler(0, sampler);
 	}
 
 private:
 	ID3D11Buffer* m_valueBuffer;
+	ID3D11Buffer* m_historyBuffer;
 	ID3D11ShaderResourceView* m_maskTexture;
 };
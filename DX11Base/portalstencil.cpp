@@ -2,6 +2,7 @@
 #include "portalstencil.h"
 #include "renderer.h"
 #include "manager.h"
+#include "portalmanager.h"
 #include "fpscamera.h"
 #include "portalbackfaceshader.h"
 #include "debug.h"
@@ -12,6 +13,7 @@ void PortalStencil::Awake()
 	Portal::Awake();
 
 	m_shader = CRenderer::GetShader<PortalStencilShader>();
+	SetPassMask(PassBit(Pass::Portal), PassBit(Pass::Portal) | PassBit(Pass::PortalFrame) | PassBit(Pass::Default) | PassBit(Pass::PortalBackface));
 }
 
 void PortalStencil::Uninit()
@@ -29,8 +31,7 @@ void PortalStencil::Update()
 
 void PortalStencil::Draw(Pass pass)
 {
-	if ((pass == Pass::PortalBlue && m_type == PortalType::Blue) ||
-		(pass == Pass::PortalOrange && m_type == PortalType::Orange))
+	if (pass == Pass::Portal && PortalManager::GetRenderingPortal() == m_slot)
 	{
 		if (!m_linkedPortal.lock())
 			return;
@@ -59,8 +60,7 @@ void PortalStencil::Draw(Pass pass)
 
 void PortalStencil::Draw(const std::shared_ptr<class Shader>& shader, Pass pass)
 {
-	if ((pass == Pass::PortalBlue && m_type == PortalType::Blue) ||
-		(pass == Pass::PortalOrange && m_type == PortalType::Orange))
+	if (pass == Pass::Portal && PortalManager::GetRenderingPortal() == m_slot)
 	{
 		if (!m_linkedPortal.lock())
 			return;
@@ -106,8 +106,7 @@ void PortalStencil::Draw(const std::shared_ptr<class Shader>& shader, Pass pass)
 
 		CRenderer::SetDepthStencilState(6, 0);
 	}
-	else if ((pass == Pass::PortalBlueFrame && m_type == PortalType::Blue) ||
-			(pass == Pass::PortalOrangeFrame && m_type == PortalType::Orange))
+	else if (pass == Pass::PortalFrame && PortalManager::GetRenderingPortal() == m_slot)
 	{
 		if (!m_linkedPortal.lock())
 			return;
@@ -157,34 +156,3 @@ void PortalStencil::Draw(const std::shared_ptr<class Shader>& shader, Pass pass)
 		CRenderer::SetRasterizerState(RasterizerState_CullBack);
 	}
 }
-
-dx::XMMATRIX PortalStencil::GetViewMatrix(bool firstIteration)
-{
-	if (auto linkedPortal = m_linkedPortal.lock())
-	{
-		// player camera world -> in portal local -> rotate locally by y 180 -> out portal world
-		auto mainCam = std::static_pointer_cast<FPSCamera>(CManager::GetActiveScene()->GetMainCamera());
-		int iterationNum = firstIteration ? 0 : m_curIteration - 2;
-
-		// repeat transformation to get the right orientation for current iteration
-		dx::XMMATRIX out, cam;
-		cam = mainCam->GetLocalToWorldMatrix(false);
-		for (int i = 0; i <= iterationNum; ++i)
-		{
-			out = cam;
-			out *= dx::XMMatrixInverse(nullptr, GetWorldMatrix());
-			out *= dx::XMMatrixRotationY(dx::XMConvertToRadians(180));
-			out *= linkedPortal->GetWorldMatrix();
-			cam = out;
-		}
-
-		dx::XMFLOAT4X4 fout;
-		dx::XMStoreFloat4x4(&fout, cam);
-
-		dx::XMVECTOR forward = dx::XMVectorSet(fout._31, fout._32, fout._33, 0);
-		dx::XMVECTOR up = dx::XMVectorSet(fout._21, fout._22, fout._23, 0);
-		dx::XMVECTOR eye = dx::XMVectorSet(fout._41, fout._42, fout._43, 1);
-
-		return dx::XMMatrixLookToLH(eye, forward, up);
-	}
-}
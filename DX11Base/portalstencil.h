@@ -16,9 +16,9 @@ public:
 	void Draw(Pass pass) override;
 	void Draw(const std::shared_ptr<class Shader>& shader, Pass pass) override;
 
-	// getters
-	dx::XMMATRIX GetViewMatrix(bool firstIteration = false) override;
-
 private:
 	std::shared_ptr<PortalStencilShader> m_shader;
+
+	// the stencil write pass starts counting at 2
+	int GetRecursionLevel() const override { return m_curIteration - 2; }
 };
@@ -13,14 +13,15 @@ enum class TravelType
 class PortalTraveler
 {
 public:
-	virtual PortalType GetEntrancePortal() const { return m_entrancePortal; }
-	virtual void SetEntrancePortal(PortalType type) { m_entrancePortal = type; }
+	// slot of the portal the traveler is passing through, PORTAL_NONE if not near any portal
+	virtual int GetEntrancePortal() const { return m_entrancePortal; }
+	virtual void SetEntrancePortal(int slot) { m_entrancePortal = slot; }
 	virtual OBB* GetOBB() { return &m_obb; }
 
 	virtual void Swap() = 0;
 	virtual dx::XMVECTOR GetTravelerPosition() const = 0;
 
 protected:
-	PortalType m_entrancePortal;
+	int m_entrancePortal;
 	OBB m_obb;
 };
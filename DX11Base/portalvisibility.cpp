@@ -0,0 +1,110 @@
+#include "pch.h"
+#include "portalvisibility.h"
+#include "portalmanager.h"
+#include "manager.h"
+#include "fpscamera.h"
+
+
+std::vector<std::vector<ScreenRect>> PortalVisibility::m_rects;
+std::vector<int> PortalVisibility::m_visibleDepth;
+float PortalVisibility::m_coverageThreshold = 0.0005f;
+int PortalVisibility::m_passBudget = 24;
+int PortalVisibility::m_usedPasses = 0;
+float PortalVisibility::m_pixelBudget = 6.0f;
+float PortalVisibility::m_usedPixels = 0.0f;
+
+
+void PortalVisibility::Evaluate(int maxDepth)
+{
+	int slotNum = PortalManager::GetSlotNum();
+	m_rects.assign(slotNum, std::vector<ScreenRect>());
+	m_visibleDepth.assign(slotNum, -1);
+	m_usedPasses = 0;
+	m_usedPixels = 0.0f;
+
+	// every linked portal starts at the camera, the edge of the graph is the link to the other portal of the pair
+	dx::XMFLOAT4X4 camera;
+	dx::XMStoreFloat4x4(&camera, std::static_pointer_cast<FPSCamera>(CManager::GetActiveScene()->GetMainCamera())->GetLocalToWorldMatrix(false));
+
+	std::vector<Walk> frontier;
+	for (int slot = 0; slot < slotNum; ++slot)
+	{
+		auto portal = PortalManager::GetPortal(slot);
+		if (portal && portal->GetLinkedPortal())
+			frontier.push_back({ portal, camera, ScreenRect::FullScreen() });
+	}
+
+	// one level of every portal at a time so the budget goes to what is nearest to the camera
+	std::vector<std::pair<float, size_t>> candidates;
+	std::vector<ScreenRect> rects;
+	std::vector<Walk> next;
+	for (int level = 0; level <= maxDepth && !frontier.empty(); ++level)
+	{
+		candidates.clear();
+		rects.resize(frontier.size());
+		for (size_t i = 0; i < frontier.size(); ++i)
+		{
+			if (Advance(frontier[i], level, rects[i]))
+				candidates.emplace_back(Area(rects[i]), i);
+		}
+
+		// the bigger openings first
+		std::sort(candidates.begin(), candidates.end(), [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) { return a.first > b.first; });
+
+		next.clear();
+		for (const auto& candidate : candidates)
+		{
+			if (m_usedPasses + 1 > m_passBudget || m_usedPixels + candidate.first > m_pixelBudget)
+				continue;
+
+			Walk& walk = frontier[candidate.second];
+			int slot = walk.portal->GetSlot();
+			m_rects[slot].push_back(rects[candidate.second]);
+			m_visibleDepth[slot] = level;
+			m_usedPasses++;
+			m_usedPixels += candidate.first;
+
+			walk.clipRect = rects[candidate.second];
+			next.push_back(walk);
+		}
+
+		frontier.swap(next);
+	}
+}
+
+const ScreenRect& PortalVisibility::GetScreenRect(int slot, int level)
+{
+	static const ScreenRect empty = ScreenRect::Empty();
+	if (slot < 0 || slot >= (int)m_rects.size() || level < 0)
+		return empty;
+
+	const std::vector<ScreenRect>& rects = m_rects[slot];
+	return level < (int)rects.size() ? rects[level] : empty;
+}
+
+bool PortalVisibility::Advance(Walk& walk, int level, ScreenRect& rect)
+{
+	const std::shared_ptr<Portal>& portal = walk.portal;
+	auto linkedPortal = portal->GetLinkedPortal();
+	if (!linkedPortal)
+		return false;
+
+	// the view at this level has to sit behind the linked portal to see through it
+	dx::XMMATRIX cam = dx::XMLoadFloat4x4(&walk.camera) * portal->GetPortalToPortalMatrix();
+	dx::XMStoreFloat4x4(&walk.camera, cam);
+
+	dx::XMFLOAT3 forward = linkedPortal->GetForward();
+	dx::XMVECTOR linkedForward = dx::XMLoadFloat3(&forward);
+	if (dx::XMVectorGetX(dx::XMVector3Dot(linkedForward, dx::XMVectorSubtract(cam.r[3], linkedPortal->GetPosition()))) >= 0.0f)
+		return false;
+
+	// the opening at this level is seen through the opening of the level before it
+	dx::XMFLOAT3 center, extents;
+	linkedPortal->GetLocalBounds(center, extents);
+
+	dx::XMMATRIX projection = CManager::GetActiveScene()->GetMainCamera()->GetProjectionMatrix();
+	rect = FrustumCulling::ProjectBox(center, extents, linkedPortal->GetWorldMatrix() * portal->GetViewMatrixAtLevel(level) * projection);
+	rect.Intersect(walk.clipRect);
+
+	return Area(rect) >= m_coverageThreshold;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "frustumculling.h"
+#include "portal.h"
+
+
+// walks the portal graph breadth first, projecting the openings through the recursion chain to find out how deep each portal is worth rendering
+static class PortalVisibility
+{
+public:
+	// called every frame by the portal manager after the travelers moved
+	static void Evaluate(int maxDepth);
+
+	// deepest recursion level worth rendering, -1 if the portal cant be seen at all
+	static int GetVisibleDepth(int slot) { return slot < 0 || slot >= (int)m_visibleDepth.size() ? -1 : m_visibleDepth[slot]; }
+
+	// opening of the linked portal on screen at the given level, already clipped by the levels before it
+	static const ScreenRect& GetScreenRect(int slot, int level);
+	static float GetCoverage(int slot, int level) { return Area(GetScreenRect(slot, level)); }
+
+	// fraction of the screen below which a recursion level is dropped
+	static void SetCoverageThreshold(float threshold) { m_coverageThreshold = threshold; }
+	static float GetCoverageThreshold() { return m_coverageThreshold; }
+
+	// budget shared by every portal, shallow levels and the bigger openings within a level are served first
+	static void SetPassBudget(int passes) { m_passBudget = passes; }
+	static void SetPixelBudget(float screens) { m_pixelBudget = screens; }
+	static int GetPassBudget() { return m_passBudget; }
+	static float GetPixelBudget() { return m_pixelBudget; }
+	static int GetUsedPasses() { return m_usedPasses; }
+	static float GetUsedPixels() { return m_usedPixels; }
+
+private:
+	// one portal being followed through the recursion
+	struct Walk
+	{
+		std::shared_ptr<Portal> portal;
+		dx::XMFLOAT4X4 camera;
+		ScreenRect clipRect;
+	};
+
+	static std::vector<std::vector<ScreenRect>> m_rects;
+	static std::vector<int> m_visibleDepth;
+	static float m_coverageThreshold;
+	static int m_passBudget, m_usedPasses;
+	static float m_pixelBudget, m_usedPixels;
+
+	static float Area(const ScreenRect& rect) { return rect.IsEmpty() ? 0.0f : (rect.maxX - rect.minX) * (rect.maxY - rect.minY) * 0.25f; }
+	static bool Advance(Walk& walk, int level, ScreenRect& rect);
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+class CommandBuffer;
+
+
+// translates a recorded command buffer into work, the buffer is only read so it can be executed again
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() {}
+
+	virtual void Execute(const CommandBuffer& commandBuffer) = 0;
+	virtual const char* GetName() const = 0;
+};
@@ -1,13 +1,24 @@
 #include "pch.h"
 #include <io.h>
-#include <typeinfo>
 #include "main.h"
 #include "model.h"
 #include "renderer.h"
 #include "gameobject.h"
 #include "shader.h"
 #include "computeshader.h"
+#include "basiclightshader.h"
+#include "instancingshader.h"
+#include "lineshader.h"
+#include "uishader.h"
+#include "portalbackfaceshader.h"
+#include "portalrendertextureshader.h"
+#include "portalstencilshader.h"
+#include "depthfromlightshader.h"
+#include "skinningcs.h"
 #include "rendertexture.h"
+#include "d3d11backend.h"
+#include "statecache.h"
+#include "constantring.h"
 
 // for hlsl debugging
 #ifdef _DEBUG
@@ -40,11 +51,26 @@ ID3D11RasterizerState* CRenderer::m_rasterizerCullNone = nullptr;
 ID3D11RasterizerState* CRenderer::m_rasterizerWireframe = nullptr;
 
 std::map<UINT, std::shared_ptr<RenderTexture>> CRenderer::m_renderTargetViews;
+ID3D11Buffer* CRenderer::m_whiteVertexBuffer = nullptr;
 
 std::vector<std::shared_ptr<Shader>> CRenderer::m_shaders = std::vector<std::shared_ptr<Shader>>();
 std::vector<std::shared_ptr<ComputeShader>> CRenderer::m_computeShaders = std::vector<std::shared_ptr<ComputeShader>>();
+std::vector<std::shared_ptr<Shader>> CRenderer::m_shaderTable;
+std::vector<std::shared_ptr<ComputeShader>> CRenderer::m_computeShaderTable;
 
-std::weak_ptr<Shader> CRenderer::m_activeShader;
+
+CommandBuffer CRenderer::m_commandBuffer;
+thread_local CommandBuffer* CRenderer::m_recordBuffer = &CRenderer::m_commandBuffer;
+std::shared_ptr<RenderBackend> CRenderer::m_d3d11Backend = std::make_shared<D3D11Backend>();
+std::shared_ptr<RenderBackend> CRenderer::m_backend = CRenderer::m_d3d11Backend;
+uint32_t CRenderer::m_frameCommandNum = 0;
+uint32_t CRenderer::m_frameDrawNum = 0;
+uint32_t CRenderer::m_frameSubmitNum = 0;
+size_t CRenderer::m_frameCommandBytes = 0;
+uint32_t CRenderer::m_lastCommandNum = 0;
+uint32_t CRenderer::m_lastDrawNum = 0;
+uint32_t CRenderer::m_lastSubmitNum = 0;
+size_t CRenderer::m_lastCommandBytes = 0;
 
 
 void CRenderer::Init()
@@ -125,6 +151,7 @@ void CRenderer::Init()
 	rd.FillMode = D3D11_FILL_SOLID; 
 	rd.CullMode = D3D11_CULL_BACK; 
 	rd.DepthClipEnable = TRUE; 
+	rd.ScissorEnable = TRUE;
 	rd.MultisampleEnable = FALSE; 
 
 	m_D3DDevice->CreateRasterizerState( &rd, &m_rasterizerCullBack);
@@ -134,6 +161,7 @@ void CRenderer::Init()
 	rd.FillMode = D3D11_FILL_SOLID;
 	rd.CullMode = D3D11_CULL_FRONT;
 	rd.DepthClipEnable = TRUE;
+	rd.ScissorEnable = TRUE;
 	rd.MultisampleEnable = FALSE;
 
 	m_D3DDevice->CreateRasterizerState(&rd, &m_rasterizerCullFront);
@@ -143,6 +171,7 @@ void CRenderer::Init()
 	rd.FillMode = D3D11_FILL_SOLID;
 	rd.CullMode = D3D11_CULL_NONE;
 	rd.DepthClipEnable = TRUE;
+	rd.ScissorEnable = TRUE;
 	rd.MultisampleEnable = FALSE;
 
 	m_D3DDevice->CreateRasterizerState(&rd, &m_rasterizerCullNone);
@@ -152,12 +181,13 @@ void CRenderer::Init()
 	rd.FillMode = D3D11_FILL_WIREFRAME;
 	rd.CullMode = D3D11_CULL_BACK;
 	rd.DepthClipEnable = TRUE;
+	rd.ScissorEnable = TRUE;
 	rd.MultisampleEnable = FALSE;
 
 	m_D3DDevice->CreateRasterizerState(&rd, &m_rasterizerWireframe);
 
 	// set the rasterizer state
-	SetRasterizerState(RasterizerState_CullBack);
+	ApplyRasterizerState(RasterizerState_CullBack);
 
 	// uhXe[gݒ
 	D3D11_BLEND_DESC blendDesc;
@@ -240,6 +270,41 @@ void CRenderer::Init()
 
 	// set the default depthstencil state
 	m_ImmediateContext->OMSetDepthStencilState(m_DepthStateStencilComp, 0);
+
+	ConstantRing::Init();
+
+	// diffuse stream of packed vertices
+	{
+		UINT white = 0xFFFFFFFF;
+
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory(&bd, sizeof(bd));
+		bd.Usage = D3D11_USAGE_IMMUTABLE;
+		bd.ByteWidth = sizeof(white);
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+		D3D11_SUBRESOURCE_DATA sd;
+		ZeroMemory(&sd, sizeof(sd));
+		sd.pSysMem = &white;
+
+		m_D3DDevice->CreateBuffer(&bd, &sd, &m_whiteVertexBuffer);
+	}
+
+	RegisterShaders();
+}
+
+void CRenderer::RegisterShaders()
+{
+	GetShader<BasicLightShader>();
+	GetShader<InstancingShader>();
+	GetShader<LineShader>();
+	GetShader<UIShader>();
+	GetShader<PortalBackfaceShader>();
+	GetShader<PortalRenderTextureShader>();
+	GetShader<PortalStencilShader>();
+	GetShader<DepthFromLightShader>();
+
+	GetComputeShader<SkinningCompute>();
 }
 
 void CRenderer::Uninit()
@@ -252,7 +317,11 @@ void CRenderer::Uninit()
 
 	m_shaders.clear();
 	m_computeShaders.clear();
+	m_shaderTable.clear();
+	m_computeShaderTable.clear();
 	m_renderTargetViews.clear();
+	ConstantRing::Uninit();
+	SAFE_RELEASE(m_whiteVertexBuffer);
 
 	SAFE_DELETE(m_viewPort);
 	m_ImmediateContext->ClearState();
@@ -262,8 +331,12 @@ void CRenderer::Uninit()
 	m_D3DDevice->Release();
 }
 
-void CRenderer::Begin(std::vector<uint8_t> renderTargetViews, bool clearRTV, bool clearDepth, bool clearStencil, ID3D11DepthStencilView* depthStencilView)
+void CRenderer::Begin(std::vector<uint8_t> renderTargetViews, bool clearRTV, bool clearDepth, bool clearStencil, ID3D11DepthStencilView* depthStencilView,
+	const D3D11_VIEWPORT* viewport, const D3D11_RECT* scissor)
 {
+	// whatever was recorded for the previous targets has to run before they are switched
+	Submit();
+
 	// get all the render targets to write to for this pass
 	ID3D11RenderTargetView* renderTarget[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
 	ID3D11DepthStencilView* dsv;
@@ -280,8 +353,19 @@ void CRenderer::Begin(std::vector<uint8_t> renderTargetViews, bool clearRTV, boo
 			renderTarget[i] = m_renderTargetViews[renderTargetViews[i]]->GetRenderTargetView();
 	}
 
+	// set the viewport and scissor, scissor is left open if the pass doesnt need only a part of the target
+	m_ImmediateContext->RSSetViewports(1, viewport ? viewport : m_viewPort);
+	if (scissor)
+	{
+		m_ImmediateContext->RSSetScissorRects(1, scissor);
+	}
+	else
+	{
+		D3D11_RECT unbounded = { 0, 0, D3D11_VIEWPORT_BOUNDS_MAX, D3D11_VIEWPORT_BOUNDS_MAX };
+		m_ImmediateContext->RSSetScissorRects(1, &unbounded);
+	}
+
 	// set the right depth stencil buffer for this pass
-	m_ImmediateContext->RSSetViewports(1, m_viewPort);
 	if (useDefault || depthStencilView == nullptr)
 	{
 		dsv = m_DepthStencilView;
@@ -293,6 +377,7 @@ void CRenderer::Begin(std::vector<uint8_t> renderTargetViews, bool clearRTV, boo
 	
 	// set the render targets
 	m_ImmediateContext->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, &renderTarget[0], dsv);
+	StateCache::InvalidateShaderResources();
 
 	// clear the render target buffer if needed
 	if (clearRTV)
@@ -309,33 +394,56 @@ void CRenderer::Begin(std::vector<uint8_t> renderTargetViews, bool clearRTV, boo
 	UINT clearFlags = 0;
 	if (clearDepth) clearFlags = D3D11_CLEAR_DEPTH;
 	if (clearStencil) clearFlags |= D3D11_CLEAR_STENCIL;
-	m_ImmediateContext->ClearDepthStencilView(dsv, clearFlags, 1.0f, 0);
+	if (clearFlags)
+		m_ImmediateContext->ClearDepthStencilView(dsv, clearFlags, 1.0f, 0);
 }
 
 void CRenderer::End()
 {
+	Submit();
+
+	m_lastCommandNum = m_frameCommandNum;
+	m_lastDrawNum = m_frameDrawNum;
+	m_lastSubmitNum = m_frameSubmitNum;
+	m_lastCommandBytes = m_frameCommandBytes;
+	m_frameCommandNum = m_frameDrawNum = m_frameSubmitNum = 0;
+	m_frameCommandBytes = 0;
+	ConstantRing::EndFrame();
+
 	m_SwapChain->Present( 1, 0 );
 }
 
-void CRenderer::SetShader(const std::shared_ptr<Shader>& shader)
+void CRenderer::Submit(CommandBuffer& commandBuffer)
 {
-	// return if the active shader is the same
-	if (auto activeShader = m_activeShader.lock())
-	{
-		if (typeid(*shader) == typeid(*activeShader))
-			return;
-	}
-	
-	m_activeShader = shader;
+	if (commandBuffer.IsEmpty())
+		return;
+
+	m_frameCommandNum += commandBuffer.GetCommandNum();
+	m_frameDrawNum += commandBuffer.GetDrawNum();
+	m_frameCommandBytes += commandBuffer.GetSize();
+	++m_frameSubmitNum;
 
-	// set shaders and buffers
-	m_ImmediateContext->VSSetShader(shader->m_vertexShader, NULL, 0);
-	m_ImmediateContext->PSSetShader(shader->m_pixelShader, NULL, 0);
+	m_backend->Execute(commandBuffer);
+	commandBuffer.Clear();
+}
 
-	shader->UpdateConstantBuffers();
+void CRenderer::SetShader(const std::shared_ptr<Shader>& shader)
+{
+	// the shaders and their buffers are bound when the backend gets to this command, binding the same shader again is filtered there
+	m_recordBuffer->BindShader(shader.get());
 }
 
 void CRenderer::SetRasterizerState(RasterizerState state)
+{
+	m_recordBuffer->SetRasterizerState((uint8_t)state);
+}
+
+void CRenderer::SetDepthStencilState(uint8_t number, uint8_t ref)
+{
+	m_recordBuffer->SetDepthStencilState(number, ref);
+}
+
+void CRenderer::ApplyRasterizerState(RasterizerState state)
 {
 	switch (state)
 	{
@@ -356,7 +464,7 @@ void CRenderer::SetRasterizerState(RasterizerState state)
 	}
 }
 
-void CRenderer::SetDepthStencilState(uint8_t number, uint8_t ref)
+void CRenderer::ApplyDepthStencilState(uint8_t number, uint8_t ref)
 {
 	if(number == 0)
 		m_ImmediateContext->OMSetDepthStencilState(m_DepthStateStencilComp, ref);
@@ -391,15 +499,13 @@ void CRenderer::DrawLine(const std::shared_ptr<Shader> shader, ID3D11Buffer** ve
 	SetShader(shader);
 
 	// set vertex buffer
-	UINT stride = sizeof(VERTEX_3D);
-	UINT offset = 0;
-	CRenderer::GetDeviceContext()->IASetVertexBuffers(0, 1, vertexBuffer, &stride, &offset);
+	m_recordBuffer->SetVertexBuffer(*vertexBuffer, sizeof(VERTEX_3D));
 
 	//v~eBug|W[ݒ
-	CRenderer::GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
+	m_recordBuffer->SetTopology(PrimitiveTopology::LineList);
 
 	//|S`
-	CRenderer::GetDeviceContext()->Draw(vertexCount, 0);
+	m_recordBuffer->Draw(vertexCount, 0);
 }
 
 void CRenderer::DrawPolygon(const std::shared_ptr<Shader> shader, ID3D11Buffer** vertexBuffer, UINT vertexCount)
@@ -408,15 +514,13 @@ void CRenderer::DrawPolygon(const std::shared_ptr<Shader> shader, ID3D11Buffer**
 	SetShader(shader);
 
 	// set vertex buffer
-	UINT stride = sizeof(VERTEX_3D);
-	UINT offset = 0;
-	CRenderer::GetDeviceContext()->IASetVertexBuffers(0, 1, vertexBuffer, &stride, &offset);
+	m_recordBuffer->SetVertexBuffer(*vertexBuffer, sizeof(VERTEX_3D));
 
 	//v~eBug|W[ݒ
-	CRenderer::GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	m_recordBuffer->SetTopology(PrimitiveTopology::TriangleStrip);
 
 	//|S`
-	CRenderer::GetDeviceContext()->Draw(vertexCount, 0);
+	m_recordBuffer->Draw(vertexCount, 0);
 }
 
 void CRenderer::DrawPolygonIndexed(const std::shared_ptr<Shader> shader, ID3D11Buffer** vertexBuffer, ID3D11Buffer* indexBuffer, UINT indexCount)
@@ -425,84 +529,66 @@ void CRenderer::DrawPolygonIndexed(const std::shared_ptr<Shader> shader, ID3D11B
 	SetShader(shader);
 
 	// set vertex and index buffers
-	UINT stride = sizeof(VERTEX_3D);
-	UINT offset = 0;
-	CRenderer::GetDeviceContext()->IASetVertexBuffers(0, 1, vertexBuffer, &stride, &offset);
-	CRenderer::GetDeviceContext()->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	m_recordBuffer->SetVertexBuffer(*vertexBuffer, sizeof(VERTEX_3D));
+	m_recordBuffer->SetIndexBuffer(indexBuffer, IndexFormat::UInt32);
 
 	//v~eBug|W[ݒ
-	CRenderer::GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	m_recordBuffer->SetTopology(PrimitiveTopology::TriangleStrip);
 
 	//|S`
-	CRenderer::GetDeviceContext()->DrawIndexed(indexCount, 0, 0);
+	m_recordBuffer->DrawIndexed(indexCount, 0, 0);
 }
 
-void CRenderer::DrawModel(const std::shared_ptr<Shader> shader, const std::shared_ptr<Model> model, const bool loadTexture)
+void CRenderer::DrawModel(const std::shared_ptr<Shader> shader, const std::shared_ptr<Model> model, const bool loadTexture, int lod)
 {
 	// set the active shader
 	SetShader(shader);
 
 	//v~eBug|W[ݒ
-	CRenderer::GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_recordBuffer->SetTopology(PrimitiveTopology::TriangleList);
 
 	// loop for every mesh, set the corresponding textures and draw the model
-	for (unsigned int m = 0; m < model->m_scene->mNumMeshes; ++m)
+	for (UINT m = 0; m < (UINT)model->m_lods.size(); ++m)
 	{
-		aiMesh* mesh = model->m_scene->mMeshes[m];
-
 		// set texture
 		if (loadTexture)
-		{
-			aiMaterial* material = model->m_scene->mMaterials[mesh->mMaterialIndex];
-
-			aiString path;
-			material->GetTexture(aiTextureType_DIFFUSE, 0, &path);
-			shader->SetTexture(model->m_texture[path.data]);
-		}
-
-		// set vertex buffer
-		UINT stride = sizeof(VERTEX_3D);
-		UINT offset = 0;
-		CRenderer::GetDeviceContext()->IASetVertexBuffers(0, 1, &model->m_vertexBuffer[m], &stride, &offset);
+			shader->SetTexture(model->m_materials[model->m_meshMaterial[m]].diffuse);
 
-		// set index buffer
-		CRenderer::GetDeviceContext()->IASetIndexBuffer(model->m_indexBuffer[m], DXGI_FORMAT_R32_UINT, 0);
+		// set vertex and index buffer, sub meshes in the geometry pool share them with the one before
+		if (m == 0 || model->m_vertexBuffer[m] != model->m_vertexBuffer[m - 1])
+			m_recordBuffer->SetVertexBuffer(model->m_vertexBuffer[m], model->m_vertexStride, model->m_vertexFormat);
+		if (m == 0 || model->m_indexBuffer[m] != model->m_indexBuffer[m - 1])
+			m_recordBuffer->SetIndexBuffer(model->m_indexBuffer[m], model->m_indexFormat[m]);
 
 		// draw
-		CRenderer::GetDeviceContext()->DrawIndexed(mesh->mNumFaces * 3, 0, 0);
+		const MeshLod& meshLod = model->GetMeshLod(m, lod);
+		m_recordBuffer->DrawIndexed(meshLod.indexCount, meshLod.firstIndex, (int32_t)model->m_baseVertex[m]);
 	}
 }
 
-void CRenderer::DrawModelInstanced(const std::shared_ptr<Shader> shader, const std::shared_ptr<Model> model, int instanceCount)
+void CRenderer::DrawModelInstanced(const std::shared_ptr<Shader> shader, const std::shared_ptr<Model> model, int instanceCount, int lod)
 {
 	// set the active shader
 	SetShader(shader);
 
 	//v~eBug|W[ݒ
-	CRenderer::GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_recordBuffer->SetTopology(PrimitiveTopology::TriangleList);
 
 	// loop for every mesh, set the corresponding textures and draw the model
-	for (unsigned int m = 0; m < model->m_scene->mNumMeshes; ++m)
+	for (UINT m = 0; m < (UINT)model->m_lods.size(); ++m)
 	{
-		aiMesh* mesh = model->m_scene->mMeshes[m];
-
 		// set texture
-		aiMaterial* material = model->m_scene->mMaterials[mesh->mMaterialIndex];
-
-		aiString path;
-		material->GetTexture(aiTextureType_DIFFUSE, 0, &path);
-		shader->SetTexture(model->m_texture[path.data]);
-
-		// set vertex buffer
-		UINT stride = sizeof(VERTEX_3D);
-		UINT offset = 0;
-		CRenderer::GetDeviceContext()->IASetVertexBuffers(0, 1, &model->m_vertexBuffer[m], &stride, &offset);
+		shader->SetTexture(model->m_materials[model->m_meshMaterial[m]].diffuse);
 
-		// set index buffer
-		CRenderer::GetDeviceContext()->IASetIndexBuffer(model->m_indexBuffer[m], DXGI_FORMAT_R32_UINT, 0);
+		// set vertex and index buffer, sub meshes in the geometry pool share them with the one before
+		if (m == 0 || model->m_vertexBuffer[m] != model->m_vertexBuffer[m - 1])
+			m_recordBuffer->SetVertexBuffer(model->m_vertexBuffer[m], model->m_vertexStride, model->m_vertexFormat);
+		if (m == 0 || model->m_indexBuffer[m] != model->m_indexBuffer[m - 1])
+			m_recordBuffer->SetIndexBuffer(model->m_indexBuffer[m], model->m_indexFormat[m]);
 
 		// draw
-		CRenderer::GetDeviceContext()->DrawIndexedInstanced(mesh->mNumFaces * 3, instanceCount, 0, 0, 0);
+		const MeshLod& meshLod = model->GetMeshLod(m, lod);
+		m_recordBuffer->DrawIndexedInstanced(meshLod.indexCount, instanceCount, meshLod.firstIndex, (int32_t)model->m_baseVertex[m], 0);
 	}
 }
 
@@ -511,6 +597,11 @@ void CRenderer::BindRenderTargetView(const std::shared_ptr<RenderTexture>& rende
 	m_renderTargetViews[renderTexture->GetRenderTargetViewID()] = renderTexture;
 }
 
+void CRenderer::UnbindRenderTargetView(uint8_t renderTargetViewID)
+{
+	m_renderTargetViews.erase(renderTargetViewID);
+}
+
 void CRenderer::UnbindRenderTargetViews()
 {
 	m_renderTargetViews.clear();
@@ -1,7 +1,9 @@
 #pragma once
 
-#include <typeinfo>
 #include <map>
+#include <atomic>
+#include <DirectXPackedVector.h>
+#include "commandbuffer.h"
 
 
 // _\
@@ -15,6 +17,15 @@ struct VERTEX_3D
 	dx::XMFLOAT3 Binormal;
 };
 
+// vertex of static meshes, the input assembler expands it to the same shader inputs as VERTEX_3D,
+// the diffuse is always white and comes from a second stream
+struct VERTEX_3D_PACKED
+{
+	dx::XMFLOAT3 Position;
+	dx::PackedVector::XMBYTEN4 Normal;
+	dx::PackedVector::XMHALF2 TexCoord;
+};
+
 // }eA\
 struct MATERIAL
 {
@@ -36,9 +47,32 @@ class ComputeShader;
 class Model;
 class GameObject;
 class RenderTexture;
+class RenderBackend;
+
+// hands out consecutive ids per base type, the id of a type is fixed the first time it is asked for,
+// any thread may ask first so the counter is atomic
+template <typename Base>
+class TypeID
+{
+public:
+	template <typename T>
+	static UINT Get()
+	{
+		static const UINT id = m_next++;
+		return id;
+	}
+
+private:
+	static std::atomic<UINT> m_next;
+};
+
+template <typename Base>
+std::atomic<UINT> TypeID<Base>::m_next(0);
 
 static class CRenderer
 {
+	friend class D3D11Backend;
+
 private:
 	static D3D_FEATURE_LEVEL       m_FeatureLevel;
 
@@ -64,66 +98,107 @@ private:
 
 	static std::map<UINT, std::shared_ptr<RenderTexture>> m_renderTargetViews;
 
+	// one white diffuse read by every packed vertex
+	static ID3D11Buffer* m_whiteVertexBuffer;
+
 	static std::vector<std::shared_ptr<Shader>> m_shaders;
 	static std::vector<std::shared_ptr<ComputeShader>> m_computeShaders;
-	static std::weak_ptr<Shader> m_activeShader;
+
+	// the same shaders indexed by their type id
+	static std::vector<std::shared_ptr<Shader>> m_shaderTable;
+	static std::vector<std::shared_ptr<ComputeShader>> m_computeShaderTable;
+
+	// the game records into this buffer, the backend executes it at the end of every pass
+	static CommandBuffer m_commandBuffer;
+	// where the calling thread records to, the main buffer unless a worker records a pass of its own
+	static thread_local CommandBuffer* m_recordBuffer;
+	static std::shared_ptr<RenderBackend> m_backend;
+	static std::shared_ptr<RenderBackend> m_d3d11Backend;
+	static uint32_t m_frameCommandNum, m_frameDrawNum, m_frameSubmitNum;
+	static size_t m_frameCommandBytes;
+	static uint32_t m_lastCommandNum, m_lastDrawNum, m_lastSubmitNum;
+	static size_t m_lastCommandBytes;
+
+	// what the backend calls when replaying the recorded states
+	static void ApplyRasterizerState(RasterizerState state);
+	static void ApplyDepthStencilState(uint8_t number, uint8_t ref);
+
+	// creates every shader of the game up front so no lookup ever has to create one mid frame
+	static void RegisterShaders();
+
+	template <typename T, typename Base>
+	static std::shared_ptr<T> FindOrCreate(std::vector<std::shared_ptr<Base>>& table, std::vector<std::shared_ptr<Base>>& list)
+	{
+		UINT id = TypeID<Base>::template Get<T>();
+		if (id >= table.size())
+			table.resize(id + 1);
+
+		// not created yet, so init the shader and store the pointer to it
+		if (!table[id])
+		{
+			table[id] = std::shared_ptr<T>(new T());
+			table[id]->Init();
+			list.push_back(table[id]);
+		}
+
+		return std::static_pointer_cast<T>(table[id]);
+	}
 
 public:
 	static void Init();
 	static void Uninit();
-	static void Begin(std::vector<uint8_t> renderPass, bool clearRTV, bool clearDepth, bool clearStencil, ID3D11DepthStencilView* depthStencilView);
+	static void Begin(std::vector<uint8_t> renderPass, bool clearRTV, bool clearDepth, bool clearStencil, ID3D11DepthStencilView* depthStencilView,
+		const D3D11_VIEWPORT* viewport = nullptr, const D3D11_RECT* scissor = nullptr);
 	static void End();
 
 	static void SetShader(const std::shared_ptr<Shader>& shader);
+	static void UpdateConstantBuffer(ID3D11Buffer* buffer, const void* data, UINT size) { m_recordBuffer->UpdateConstantBuffer(buffer, data, size); }
+	static void SetShaderResource(ShaderStage stage, UINT slot, ID3D11ShaderResourceView* view) { m_recordBuffer->SetShaderResource(stage, (uint8_t)slot, view); }
+	static void SetSampler(UINT slot, ID3D11SamplerState* sampler) { m_recordBuffer->SetSampler((uint8_t)slot, sampler); }
+	static void CopyTextureRegion(ID3D11Texture2D* destination, ID3D11Texture2D* source, const D3D11_RECT& rect)
+	{
+		m_recordBuffer->CopyTextureRegion(destination, source, (uint32_t)rect.left, (uint32_t)rect.top, (uint32_t)rect.right, (uint32_t)rect.bottom);
+	}
+	static void CopyResource(ID3D11Texture2D* destination, ID3D11Texture2D* source) { m_recordBuffer->CopyResource(destination, source); }
+	static void WriteInstances(InstancingShader* shader, const dx::XMFLOAT4X4* worlds, UINT count) { m_recordBuffer->WriteInstances(shader, worlds, count); }
+
+	// executes everything recorded so far on the active backend, called at the end of every pass and before present
+	static void Submit() { Submit(m_commandBuffer); }
+	// executes a buffer recorded on another thread, in the order the passes run
+	static void Submit(CommandBuffer& commandBuffer);
+	static void SetRecordBuffer(CommandBuffer* commandBuffer) { m_recordBuffer = commandBuffer ? commandBuffer : &m_commandBuffer; }
+	static void SetBackend(const std::shared_ptr<RenderBackend>& backend) { m_backend = backend ? backend : m_d3d11Backend; }
+	static const std::shared_ptr<RenderBackend>& GetBackend() { return m_backend; }
+	static bool IsD3D11Backend() { return m_backend == m_d3d11Backend; }
+
+	// recorded in the last frame
+	static uint32_t GetCommandNum() { return m_lastCommandNum; }
+	static uint32_t GetDrawNum() { return m_lastDrawNum; }
+	static uint32_t GetSubmitNum() { return m_lastSubmitNum; }
+	static size_t GetCommandBytes() { return m_lastCommandBytes; }
 	static void BindRenderTargetView(const std::shared_ptr<RenderTexture>& renderTexture);
+	static void UnbindRenderTargetView(uint8_t renderTargetViewID);
 	static void UnbindRenderTargetViews();
 
 	template <typename T>
-	static std::shared_ptr<T> GetShader()
-	{
-		// search the shader in the list
-		for (auto shader : m_shaders)
-		{
-			if (typeid(*shader) == typeid(T))
-				return std::static_pointer_cast<T>(shader);
-		}
+	static std::shared_ptr<T> GetShader() { return FindOrCreate<T>(m_shaderTable, m_shaders); }
 
-		// not found, so init the shader and return the pointer to it
-		m_shaders.push_back(std::shared_ptr<T>(new T()));
-		m_shaders.back()->Init();
-
-		return std::static_pointer_cast<T>(m_shaders.back());
-	}
-
-	static std::vector<std::shared_ptr<Shader>> GetShaders() { return m_shaders; }
+	static const std::vector<std::shared_ptr<Shader>>& GetShaders() { return m_shaders; }
 
 	template <typename T>
-	static std::shared_ptr<T> GetComputeShader()
-	{
-		// search the compute shader in the list
-		for (auto shader : m_computeShaders)
-		{
-			if (typeid(*shader) == typeid(T))
-				return std::static_pointer_cast<T>(shader);
-		}
-
-		// not found, so init the compute shader and return the pointer to it
-		m_computeShaders.push_back(std::shared_ptr<T>(new T()));
-		m_computeShaders.back()->Init();
-
-		return std::static_pointer_cast<T>(m_computeShaders.back());
-	}
+	static std::shared_ptr<T> GetComputeShader() { return FindOrCreate<T>(m_computeShaderTable, m_computeShaders); }
 
 	static std::shared_ptr<RenderTexture> GetRenderTexture(int renderTargetViewID);
 
 	static ID3D11Device* GetDevice(){ return m_D3DDevice; }
 	static ID3D11DeviceContext* GetDeviceContext(){ return m_ImmediateContext; }
+	static const D3D11_VIEWPORT* GetViewport(){ return m_viewPort; }
 	static void SetRasterizerState(RasterizerState state);
 	static void SetDepthStencilState(uint8_t number, uint8_t ref);
 
 	static void DrawLine(const std::shared_ptr<Shader> shader, ID3D11Buffer** vertexBuffer, UINT vertexCount);
-	static void DrawModel(const std::shared_ptr<Shader> shader, const std::shared_ptr<Model> model, const bool loadTexture = true);
-	static void DrawModelInstanced(const std::shared_ptr<Shader> shader, const std::shared_ptr<Model> model, int instanceCount);
+	static void DrawModel(const std::shared_ptr<Shader> shader, const std::shared_ptr<Model> model, const bool loadTexture = true, int lod = 0);
+	static void DrawModelInstanced(const std::shared_ptr<Shader> shader, const std::shared_ptr<Model> model, int instanceCount, int lod = 0);
 	static void DrawPolygon(const std::shared_ptr<Shader> shader, ID3D11Buffer** vertexBuffer, UINT vertexCount);
 	static void DrawPolygonIndexed(const std::shared_ptr<Shader> shader, ID3D11Buffer** vertexBuffer, ID3D11Buffer* indexBuffer, UINT indexCount);
 };
@@ -4,10 +4,11 @@
 #include "renderer.h"
 
 
-RenderTexture::RenderTexture(uint8_t renderTargetViewID, UINT width, UINT height, RenderTextureType type)
+RenderTexture::RenderTexture(uint8_t renderTargetViewID, UINT width, UINT height, RenderTextureType type, DXGI_FORMAT format)
+	: m_width(width), m_height(height), m_format(format)
 {
 	if (type == RenderTextureType::Custom)
-		CreateCustom(renderTargetViewID, width, height);
+		CreateCustom(renderTargetViewID, width, height, format);
 	else if (type == RenderTextureType::Shadowmap)
 		CreateShadowmap(renderTargetViewID, width, height);
 }
@@ -21,7 +22,7 @@ RenderTexture::~RenderTexture()
 	SAFE_DELETE(m_viewPort);
 }
 
-void RenderTexture::CreateCustom(uint8_t renderTargetViewID, UINT width, UINT height)
+void RenderTexture::CreateCustom(uint8_t renderTargetViewID, UINT width, UINT height, DXGI_FORMAT format)
 {
 	auto pDevice = CRenderer::GetDevice();
 	m_renderTargetViewID = renderTargetViewID;
@@ -30,7 +31,7 @@ void RenderTexture::CreateCustom(uint8_t renderTargetViewID, UINT width, UINT he
 	D3D11_TEXTURE2D_DESC texDesc;
 	memset(&texDesc, 0, sizeof(texDesc));
 	texDesc.Usage = D3D11_USAGE_DEFAULT;
-	texDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	texDesc.Format = format;
 	//texDesc.Format				 = DXGI_FORMAT_R8G8B8A8_TYPELESS;
 	texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
 	texDesc.Width = width;
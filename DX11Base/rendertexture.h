@@ -10,14 +10,19 @@ class RenderTexture
 {
 public:
 	RenderTexture() = delete;
-	RenderTexture(uint8_t renderTargetViewID, UINT width, UINT height, RenderTextureType type);
+	// custom textures default to the precision of the back buffer they end up in
+	RenderTexture(uint8_t renderTargetViewID, UINT width, UINT height, RenderTextureType type, DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM);
 	~RenderTexture();
 
+	ID3D11Texture2D* GetTexture() const { return m_texture; }
 	ID3D11RenderTargetView* GetRenderTargetView() const { return m_renderTargetView; }
 	ID3D11ShaderResourceView* GetRenderTexture() const { return m_resourceView; }
 	ID3D11DepthStencilView* GetDepthStencilView() const { return m_DepthStencilView; }
 	D3D11_VIEWPORT* GetViewPort() const { return m_viewPort; }
 	uint8_t GetRenderTargetViewID() const { return m_renderTargetViewID; }
+	UINT GetWidth() const { return m_width; }
+	UINT GetHeight() const { return m_height; }
+	DXGI_FORMAT GetFormat() const { return m_format; }
 
 private:
 	ID3D11Texture2D* m_texture = nullptr;
@@ -26,7 +31,9 @@ private:
 	ID3D11DepthStencilView* m_DepthStencilView = nullptr;
 	D3D11_VIEWPORT* m_viewPort = nullptr;
 	UINT m_renderTargetViewID;
+	UINT m_width, m_height;
+	DXGI_FORMAT m_format;
 
-	void CreateCustom(uint8_t renderTargetViewID, UINT width, UINT height);
+	void CreateCustom(uint8_t renderTargetViewID, UINT width, UINT height, DXGI_FORMAT format);
 	void CreateShadowmap(uint8_t renderTargetViewID, UINT width, UINT height);
 };
@@ -0,0 +1,132 @@
+#include "pch.h"
+#include "rendertexturepool.h"
+#include "renderer.h"
+
+// ids below are owned by the renderer and the shadow maps
+#define POOL_FIRST_ID 16
+#define POOL_LAST_ID 255
+
+
+std::vector<RenderTexturePool::Entry> RenderTexturePool::m_entries;
+
+
+std::shared_ptr<RenderTexture> RenderTexturePool::Acquire(UINT width, UINT height, DXGI_FORMAT format)
+{
+	std::shared_ptr<RenderTexture> texture = nullptr;
+	for (auto& entry : m_entries)
+	{
+		if (!entry.leased && entry.texture->GetWidth() == width && entry.texture->GetHeight() == height && entry.texture->GetFormat() == format)
+		{
+			entry.leased = true;
+			texture = entry.texture;
+			break;
+		}
+	}
+
+	if (!texture)
+	{
+		texture = std::make_shared<RenderTexture>(FindFreeID(), width, height, RenderTextureType::Custom, format);
+		m_entries.push_back({ texture, true });
+	}
+
+	// the renderer forgets its targets on scene changes, bind it again on every lease
+	CRenderer::BindRenderTargetView(texture);
+	return texture;
+}
+
+void RenderTexturePool::Release(const std::shared_ptr<RenderTexture>& texture)
+{
+	for (auto& entry : m_entries)
+	{
+		if (entry.texture == texture)
+		{
+			entry.leased = false;
+			return;
+		}
+	}
+}
+
+void RenderTexturePool::Trim()
+{
+	for (auto it = m_entries.begin(); it != m_entries.end();)
+	{
+		if (it->leased)
+		{
+			++it;
+			continue;
+		}
+
+		CRenderer::UnbindRenderTargetView(it->texture->GetRenderTargetViewID());
+		it = m_entries.erase(it);
+	}
+}
+
+
+int RenderTexturePool::GetLeasedNum()
+{
+	int num = 0;
+	for (const auto& entry : m_entries)
+		if (entry.leased)
+			++num;
+
+	return num;
+}
+
+size_t RenderTexturePool::GetMemorySize()
+{
+	size_t size = 0;
+	for (const auto& entry : m_entries)
+		size += (size_t)entry.texture->GetWidth() * entry.texture->GetHeight() * GetBytesPerTexel(entry.texture->GetFormat());
+
+	return size;
+}
+
+uint8_t RenderTexturePool::FindFreeID()
+{
+	for (int id = POOL_FIRST_ID; id <= POOL_LAST_ID; ++id)
+	{
+		bool used = false;
+		for (const auto& entry : m_entries)
+			used |= entry.texture->GetRenderTargetViewID() == id;
+
+		if (!used)
+			return (uint8_t)id;
+	}
+
+	// all ids are taken, the first texture nobody leases makes room for the new one
+	for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		if (!it->leased)
+		{
+			uint8_t id = it->texture->GetRenderTargetViewID();
+			CRenderer::UnbindRenderTargetView(id);
+			m_entries.erase(it);
+			return id;
+		}
+	}
+
+	assert(!"render texture pool ran out of ids");
+	return POOL_LAST_ID;
+}
+
+UINT RenderTexturePool::GetBytesPerTexel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 16;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return 8;
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R8G8_UNORM:
+		return 2;
+	case DXGI_FORMAT_R8_UNORM:
+		return 1;
+	default:
+		// the 8 bit four channel, 16 bit two channel, 10 and 11 bit packed and 32 bit single channel formats
+		return 4;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "rendertexture.h"
+
+
+// render targets leased by size and format, a released texture stays alive and is handed out again by the next matching lease
+// until it is trimmed or its id is needed for a texture of another size
+static class RenderTexturePool
+{
+public:
+	// returns a free texture of that size and format or creates one, the texture is bound to the renderer under its own id
+	static std::shared_ptr<RenderTexture> Acquire(UINT width, UINT height, DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM);
+	static void Release(const std::shared_ptr<RenderTexture>& texture);
+	// frees every texture that is not leased and hands its id back
+	static void Trim();
+
+	static int GetTextureNum() { return (int)m_entries.size(); }
+	static int GetLeasedNum();
+	static size_t GetMemorySize();
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<RenderTexture> texture;
+		bool leased;
+	};
+
+	static std::vector<Entry> m_entries;
+
+	static uint8_t FindFreeID();
+	static UINT GetBytesPerTexel(DXGI_FORMAT format);
+};
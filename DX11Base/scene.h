@@ -6,7 +6,9 @@
 #include "light.h"
 #include "camera.h"
 #include "frustumculling.h"
+#include "visibility.h"
 #include "modelmanager.h"
+#include "instancebatcher.h"
 
 
 class Scene
@@ -15,6 +17,7 @@ protected:
 	unsigned const int m_renderQueue = 3; 							// 0 == opaque, 1 == transparent, 2 == ui
 	std::list<std::shared_ptr<GameObject>>* m_gameObjects;			// list of gameobjects in the scene
 	std::shared_ptr<Camera> m_mainCamera = nullptr;					// the main camera for this scene
+	Visibility m_visibility;										// culled draw list of every render pass, rebuilt each frame
 
 public:
 	Scene() {}
@@ -77,22 +80,50 @@ public:
 
 				if (!go->m_disableUpdate)
 					go->LateUpdate();
+
+				// the position the object is drawn at this frame
+				go->m_oldPosition = go->m_position;
 			}
 
 			// delete gameobjects flagged by destroy
 			m_gameObjects[i].remove_if([](std::shared_ptr<GameObject> go) { return go->Destroy(); });
 		}
+	}
 
-		// optimize for rendering
-		OptimizeListForRendering();
+	// initializes the objects added since the update, called before passes are drawn on worker threads
+	void InitPending()
+	{
+		for (int i = 0; i < m_renderQueue; ++i)
+		{
+			for (auto go : m_gameObjects[i])
+			{
+				if (!go->m_initialized)
+					go->Init();
+			}
+		}
 	}
 
-	virtual void Draw(Pass pass)
+	virtual void Draw(Pass pass, int renderPassIndex = -1)
 	{
-		// update the view and projection matrix
+		// upload the view and projection matrix
 		m_mainCamera->Draw(pass);
 
-		// draw
+		// draw the objects visible in this pass, neighbours drawing the same model are instanced
+		if (m_visibility.IsValid(renderPassIndex))
+		{
+			for (auto go : m_visibility.GetDrawList(renderPassIndex))
+			{
+				if (!go->m_initialized)
+					go->Init();
+
+				InstanceBatcher::Draw(go, pass);
+			}
+			InstanceBatcher::Flush(pass);
+
+			return;
+		}
+
+		// no list for this pass yet, draw everything
 		for (int i = 0; i < m_renderQueue; ++i)
 		{
 			for (auto go : m_gameObjects[i])
@@ -101,18 +132,32 @@ public:
 				if (!go->m_initialized)
 					go->Init();
 
-				if(go->m_draw)
+				if(go->m_draw && go->IsSubscribed(pass, false))
 					go->Draw(pass);
 			}
 		}
 	}
 
-	virtual void Draw(const std::shared_ptr<class Shader>& shader, Pass pass)
+	virtual void Draw(const std::shared_ptr<class Shader>& shader, Pass pass, int renderPassIndex = -1)
 	{
-		// update the view and projection matrix
+		// upload the view and projection matrix
 		m_mainCamera->Draw(pass);
 
-		// draw with the given shader
+		// draw the objects visible in this pass with the given shader
+		if (m_visibility.IsValid(renderPassIndex))
+		{
+			for (auto go : m_visibility.GetDrawList(renderPassIndex))
+			{
+				if (!go->m_initialized)
+					go->Init();
+
+				go->Draw(shader, pass);
+			}
+
+			return;
+		}
+
+		// no list for this pass yet, draw everything with the given shader
 		for (int i = 0; i < m_renderQueue; ++i)
 		{
 			for (auto go : m_gameObjects[i])
@@ -121,7 +166,7 @@ public:
 				if (!go->m_initialized)
 					go->Init();
 
-				if (go->m_draw)
+				if (go->m_draw && go->IsSubscribed(pass, true))
 					go->Draw(shader, pass);
 			}
 		}
@@ -207,6 +252,9 @@ public:
 		return m_mainCamera;
 	}
 
+	void InvalidateVisibility() { m_visibility.Invalidate(); }
+
+	// sorts with the matrices of the main camera, called by the manager once they are built for the frame
 	void OptimizeListForRendering()
 	{
 		// opaque == z sort front to back
@@ -225,14 +273,14 @@ public:
 			return dx::XMVectorGetZ(viewPosA) < dx::XMVectorGetZ(viewPosB);
 		});
 
-		// frustum culling, ignore UI layer
-		for (int i = 0; i < m_renderQueue - 1; ++i)
-		{
-			for (const auto& go : m_gameObjects[i])
-			{
-				if(go->m_enableFrustumCulling)
-					go->m_draw = FrustumCulling::CheckSphere(go->GetPosition(), 2.0f);
-			}
-		}
+		// collect what the render passes are culled from
+		m_visibility.Gather(m_gameObjects, m_renderQueue);
 	}
+
+	// bounds of the objects gathered by OptimizeListForRendering
+	const dx::XMFLOAT3& GetSceneMin() const { return m_visibility.GetSceneMin(); }
+	const dx::XMFLOAT3& GetSceneMax() const { return m_visibility.GetSceneMax(); }
+
+	// cull every render pass against its own view
+	void CullRenderPasses() { m_visibility.Cull(); }
 };
@@ -1,12 +1,14 @@
 #pragma once
 
 #include "renderer.h"
+#include "constantring.h"
 #include "light.h"
 
 
 class Shader
 {
 	friend class CRenderer;
+	friend class D3D11Backend;
 
 public:
 	virtual void Init() = 0;
@@ -19,6 +21,7 @@ public:
 		if (m_materialBuffer) m_materialBuffer->Release();
 
 		if (m_vertexLayout) m_vertexLayout->Release();
+		if (m_packedVertexLayout) m_packedVertexLayout->Release();
 		if (m_vertexShader) m_vertexShader->Release();
 		if (m_pixelShader) m_pixelShader->Release();
 	}
@@ -39,6 +42,7 @@ protected:
 	ID3D11VertexShader* m_vertexShader;
 	ID3D11PixelShader* m_pixelShader;
 	ID3D11InputLayout* m_vertexLayout;
+	ID3D11InputLayout* m_packedVertexLayout = nullptr;	// for static meshes, only created by shaders drawing models
 
 	ID3D11Buffer* m_worldBuffer;
 	ID3D11Buffer* m_viewBuffer;
@@ -46,4 +50,18 @@ protected:
 	ID3D11Buffer* m_materialBuffer;
 	ID3D11Buffer* m_lightBuffer;
 	ID3D11Buffer* m_cameraPosBuffer;
+
+	// reads VERTEX_3D_PACKED into the inputs of the vertex shader, the input assembler converts the formats
+	void CreatePackedVertexLayout(const void* byteCode, SIZE_T size)
+	{
+		D3D11_INPUT_ELEMENT_DESC layout[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "NORMAL",   0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, 4 * 3, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 4 * 4, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "COLOR",    0, DXGI_FORMAT_R8G8B8A8_UNORM, 1, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+		};
+
+		CRenderer::GetDevice()->CreateInputLayout(layout, ARRAYSIZE(layout), byteCode, size, &m_packedVertexLayout);
+	}
 };
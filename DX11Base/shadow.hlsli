@@ -0,0 +1,36 @@
+// shadow of the directional light, shared by the pixel shaders that receive it
+
+Texture2DArray g_ShadowMap : register(t1);
+SamplerComparisonState g_ShadowMapSampler : register(s1);
+
+// how much light is left in the shadow
+static const float SHADOW_DARKNESS = 0.5;
+
+#define CASCADE_NUM 4
+
+cbuffer ShadowBuffer : register(b3)
+{
+    matrix CascadeViewProjection[CASCADE_NUM];
+    float4 ShadowParams;    // x is 1 when there is a shadow map, y the depth bias, z the part of a cascade receivers may use
+}
+
+// 1 where the directional light reaches the pixel, 0 in its shadow
+float ShadowFactor(float4 worldPosition)
+{
+    if (ShadowParams.x == 0)
+        return 1;
+
+    // the first cascade the pixel is inside of has the most detail, nothing outside of all of them is shadowed
+    [unroll]
+    for (int i = 0; i < CASCADE_NUM; ++i)
+    {
+        float3 projected = mul(worldPosition, CascadeViewProjection[i]).xyz;
+        if (all(abs(projected.xy) < ShadowParams.z) && projected.z >= 0 && projected.z <= 1)
+        {
+            float2 uv = projected.xy * float2(0.5, -0.5) + 0.5;
+            return g_ShadowMap.SampleCmpLevelZero(g_ShadowMapSampler, float3(uv, i), projected.z - ShadowParams.y);
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,209 @@
+#include "pch.h"
+#include "shadowcache.h"
+#include "manager.h"
+#include "renderer.h"
+#include "depthfromlightshader.h"
+
+// keeps surfaces from shadowing themselves
+#define SHADOW_DEPTH_BIAS 0.0005f
+// receivers this close to the edge of a cascade use the next one, the filter would read the lit border
+#define CASCADE_EDGE_TEXELS 2.0f
+
+
+ID3D11Texture2D* ShadowCache::m_static = nullptr;
+ID3D11Texture2D* ShadowCache::m_composite = nullptr;
+ID3D11DepthStencilView* ShadowCache::m_staticView[LightManager::CASCADE_NUM] = {};
+ID3D11DepthStencilView* ShadowCache::m_compositeView[LightManager::CASCADE_NUM] = {};
+ID3D11ShaderResourceView* ShadowCache::m_shadowMap = nullptr;
+ID3D11SamplerState* ShadowCache::m_sampler = nullptr;
+ID3D11Buffer* ShadowCache::m_constantBuffer = nullptr;
+bool ShadowCache::m_enabled = true;
+bool ShadowCache::m_active = false;
+bool ShadowCache::m_composited = false;
+bool ShadowCache::m_valid[LightManager::CASCADE_NUM] = {};
+dx::XMFLOAT4X4 ShadowCache::m_cachedViewProjection[LightManager::CASCADE_NUM];
+int ShadowCache::m_staticRenderedNum = 0;
+int ShadowCache::m_staticRenderNum = 0;
+
+
+void ShadowCache::Init()
+{
+	auto device = CRenderer::GetDevice();
+
+	// not registered with the renderer, the passes write a slice through its depth stencil view
+	m_static = CreateCascades(D3D11_BIND_DEPTH_STENCIL, m_staticView);
+	m_composite = CreateCascades(D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE, m_compositeView);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.ArraySize = LightManager::CASCADE_NUM;
+	device->CreateShaderResourceView(m_composite, &srvDesc, &m_shadowMap);
+
+	// hardware pcf
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+	samplerDesc.BorderColor[0] = samplerDesc.BorderColor[1] = samplerDesc.BorderColor[2] = samplerDesc.BorderColor[3] = 1.0f;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	device->CreateSamplerState(&samplerDesc, &m_sampler);
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = sizeof(ShadowBuffer);
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.StructureByteStride = sizeof(float);
+	device->CreateBuffer(&bufferDesc, NULL, &m_constantBuffer);
+
+	Invalidate();
+	m_staticRenderNum = 0;
+}
+
+void ShadowCache::Uninit()
+{
+	for (int c = 0; c < LightManager::CASCADE_NUM; ++c)
+	{
+		SAFE_RELEASE(m_staticView[c]);
+		SAFE_RELEASE(m_compositeView[c]);
+	}
+	SAFE_RELEASE(m_shadowMap);
+	SAFE_RELEASE(m_static);
+	SAFE_RELEASE(m_composite);
+	SAFE_RELEASE(m_sampler);
+	SAFE_RELEASE(m_constantBuffer);
+}
+
+void ShadowCache::AddRenderPasses()
+{
+	Invalidate();
+
+	// before everything that receives shadows
+	RenderPass renderPass = {};
+	renderPass.priority = -1;
+	renderPass.overrideShader = CRenderer::GetShader<DepthFromLightShader>();
+	renderPass.scaledViewport = true;
+	renderPass.viewport = { 0.0f, 0.0f, (float)LightManager::CASCADE_SIZE, (float)LightManager::CASCADE_SIZE, 0.0f, 1.0f };
+	renderPass.scissor = { 0, 0, (LONG)LightManager::CASCADE_SIZE, (LONG)LightManager::CASCADE_SIZE };
+
+	// the static casters into the cached cascades, a cascade is skipped while it is still valid
+	renderPass.pass = Pass::LightmapStatic;
+	renderPass.clearDepth = true;
+	for (int c = 0; c < LightManager::CASCADE_NUM; ++c)
+	{
+		renderPass.cascade = c;
+		renderPass.depthStencilView = m_staticView[c];
+		CManager::AddRenderPass(renderPass);
+	}
+
+	// the dynamic casters on top of a copy of them
+	renderPass.pass = Pass::Lightmap;
+	renderPass.clearDepth = false;
+	for (int c = 0; c < LightManager::CASCADE_NUM; ++c)
+	{
+		renderPass.cascade = c;
+		renderPass.depthStencilView = m_compositeView[c];
+		CManager::AddRenderPass(renderPass);
+	}
+}
+
+void ShadowCache::Update()
+{
+	m_active = false;
+	m_staticRenderedNum = 0;
+
+	// scenes without shadow passes leave the receivers unshadowed
+	for (auto& renderPass : *CManager::GetRenderPasses())
+	{
+		if (renderPass.pass != Pass::LightmapStatic && renderPass.pass != Pass::Lightmap)
+			continue;
+
+		m_active = true;
+		int c = renderPass.cascade;
+		const ShadowCascade& cascade = LightManager::GetCascade(c);
+		if (renderPass.pass == Pass::Lightmap)
+		{
+			renderPass.skip = !cascade.valid;
+			continue;
+		}
+
+		dx::XMFLOAT4X4 viewProjection;
+		dx::XMStoreFloat4x4(&viewProjection, LightManager::GetViewMatrix() * LightManager::GetProjectionMatrix(c));
+
+		// the cached cascade holds for as long as its fitted bounds stay on the same step of the texel grid
+		bool moved = memcmp(&viewProjection, &m_cachedViewProjection[c], sizeof(viewProjection)) != 0;
+		bool render = cascade.valid && (!m_enabled || !m_valid[c] || moved);
+		renderPass.skip = !render;
+		if (render)
+		{
+			m_cachedViewProjection[c] = viewProjection;
+			m_valid[c] = true;
+			m_staticRenderedNum++;
+			m_staticRenderNum++;
+		}
+	}
+}
+
+void ShadowCache::BeginFrame()
+{
+	ShadowBuffer buffer = {};
+	m_composited = false;
+
+	if (m_active)
+	{
+		for (int c = 0; c < LightManager::CASCADE_NUM; ++c)
+			buffer.cascadeViewProjection[c] = dx::XMMatrixTranspose(LightManager::GetViewMatrix() * LightManager::GetProjectionMatrix(c));
+		buffer.params = { 1.0f, SHADOW_DEPTH_BIAS, 1.0f - CASCADE_EDGE_TEXELS * 2.0f / LightManager::CASCADE_SIZE, 0.0f };
+
+		// the shadow passes run first, whatever the ui left set has to go
+		CRenderer::SetDepthStencilState(0, 0);
+		CRenderer::SetRasterizerState(RasterizerState_CullBack);
+	}
+
+	CRenderer::UpdateConstantBuffer(m_constantBuffer, &buffer, sizeof(buffer));
+}
+
+void ShadowCache::Composite()
+{
+	// the static passes already ran when they were needed, one copy replaces the clear of all the dynamic passes
+	if (m_composited)
+		return;
+
+	CRenderer::CopyResource(m_composite, m_static);
+	m_composited = true;
+}
+
+ID3D11Texture2D* ShadowCache::CreateCascades(UINT bindFlags, ID3D11DepthStencilView* views[LightManager::CASCADE_NUM])
+{
+	auto device = CRenderer::GetDevice();
+
+	D3D11_TEXTURE2D_DESC td = {};
+	td.Width = LightManager::CASCADE_SIZE;
+	td.Height = LightManager::CASCADE_SIZE;
+	td.MipLevels = 1;
+	td.ArraySize = LightManager::CASCADE_NUM;
+	td.Format = DXGI_FORMAT_R32_TYPELESS;
+	td.SampleDesc.Count = 1;
+	td.Usage = D3D11_USAGE_DEFAULT;
+	td.BindFlags = bindFlags;
+
+	ID3D11Texture2D* texture = nullptr;
+	device->CreateTexture2D(&td, NULL, &texture);
+	if (!texture)
+		return nullptr;
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC dsvd = {};
+	dsvd.Format = DXGI_FORMAT_D32_FLOAT;
+	dsvd.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+	dsvd.Texture2DArray.ArraySize = 1;
+	for (int c = 0; c < LightManager::CASCADE_NUM; ++c)
+	{
+		dsvd.Texture2DArray.FirstArraySlice = c;
+		device->CreateDepthStencilView(texture, &dsvd, &views[c]);
+	}
+
+	return texture;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include "light.h"
+
+
+// the cascades of the directional light shadow as slices of a texture array, kept twice: the static geometry is rendered into its own
+// array only when a cascade moved and copied under the dynamic casters every frame, so a frame only draws the objects that can move
+static class ShadowCache
+{
+public:
+	static void Init();
+	static void Uninit();
+
+	// adds a static and a dynamic shadow pass for every cascade, called whenever the render passes are set up again
+	static void AddRenderPasses();
+	// decides which of the shadow passes run this frame, called once the cascades were fitted and before the passes are culled
+	static void Update();
+	// uploads the cascade matrices, called by the manager before the passes are drawn
+	static void BeginFrame();
+	// starts the dynamic passes from the cached static cascades, called right before each dynamic pass is begun
+	static void Composite();
+
+	// every static cascade is rendered again on the next frame
+	static void Invalidate() { std::fill(std::begin(m_valid), std::end(m_valid), false); }
+
+	static void Enable(bool enable) { m_enabled = enable; Invalidate(); }
+	static bool IsEnabled() { return m_enabled; }
+
+	// sampled by the lit shaders
+	static ID3D11ShaderResourceView* GetShadowMap() { return m_shadowMap; }
+	static ID3D11SamplerState* GetSampler() { return m_sampler; }
+	static ID3D11Buffer* GetConstantBuffer() { return m_constantBuffer; }
+
+	// static cascades drawn this frame and since the start
+	static int GetStaticRenderedNum() { return m_staticRenderedNum; }
+	static int GetStaticRenderNum() { return m_staticRenderNum; }
+
+private:
+	struct ShadowBuffer
+	{
+		dx::XMMATRIX cascadeViewProjection[LightManager::CASCADE_NUM];
+		dx::XMFLOAT4 params;			// x is 1 when there is a shadow map to sample, y the depth bias, z how far from the center of a cascade a receiver may be
+	};
+
+	static ID3D11Texture2D* m_static;
+	static ID3D11Texture2D* m_composite;
+	static ID3D11DepthStencilView* m_staticView[LightManager::CASCADE_NUM];
+	static ID3D11DepthStencilView* m_compositeView[LightManager::CASCADE_NUM];
+	static ID3D11ShaderResourceView* m_shadowMap;
+	static ID3D11SamplerState* m_sampler;
+	static ID3D11Buffer* m_constantBuffer;
+
+	static bool m_enabled;
+	static bool m_active;
+	static bool m_composited;
+	static bool m_valid[LightManager::CASCADE_NUM];
+	static dx::XMFLOAT4X4 m_cachedViewProjection[LightManager::CASCADE_NUM];
+	static int m_staticRenderedNum;
+	static int m_staticRenderNum;
+
+	// depth array with a view for every cascade
+	static ID3D11Texture2D* CreateCascades(UINT bindFlags, ID3D11DepthStencilView* views[LightManager::CASCADE_NUM]);
+};
@@ -9,6 +9,7 @@ void Sprite::Awake()
 	GameObject::Awake();
 
 	m_shader = CRenderer::GetShader<UIShader>();
+	SetPassMask(PassBit(Pass::UI), PASS_MASK_NONE);
 }
 
 void Sprite::Uninit()
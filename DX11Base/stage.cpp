@@ -7,6 +7,7 @@
 #include "manager.h"
 #include "light.h"
 #include "rendertexture.h"
+#include "lodselector.h"
 
 
 void Stage::Init()
@@ -15,16 +16,17 @@ void Stage::Init()
 
 	// get the shader
 	m_shader = CRenderer::GetShader<BasicLightShader>();
+	// the stage never moves, it only casts into the cached static shadow map
+	SetPassMask(PassBit(Pass::Default) | PassBit(Pass::Portal), PassBit(Pass::LightmapStatic));
 
 	ModelManager::GetModel(MODEL_STAGE, m_model);
+	SetLocalBounds(m_model->GetBoundsCenter(), m_model->GetBoundsExtents());
 
 	// init values
 	SetPosition(0.0F, 0.0F, 0.0F);
 	SetRotation(0.0F, 0.0F, 0.0F);
 	SetScale(1.0F, 1.0F, 1.0F);
 
-	m_enableFrustumCulling = false;
-
 	// colliders for portal
 	// finish room
 	m_colliders.push_back(new PolygonCollider());
@@ -103,7 +105,7 @@ void Stage::Update()
 
 void Stage::Draw(Pass pass)
 {
-	if (!(pass == Pass::Default || pass == Pass::PortalBlue || pass == Pass::PortalOrange))
+	if (!(pass == Pass::Default || pass == Pass::Portal))
 		return;
 
 	GameObject::Draw(pass);
@@ -117,19 +119,15 @@ void Stage::Draw(Pass pass)
 	material.Diffuse = dx::XMFLOAT4(1.0F, 1.0F, 1.0F, 1.0F);
 	m_shader->SetMaterial(material);
 
-	if (pass == Pass::PortalBlue)
-	{
-		m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(PortalType::Blue));
-		m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(PortalType::Blue));
-	}
-	else if (pass == Pass::PortalOrange)
+	if (pass == Pass::Portal)
 	{
-		m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(PortalType::Orange));
-		m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(PortalType::Orange));
+		int portal = PortalManager::GetRenderingPortal();
+		m_shader->SetViewMatrix(&PortalManager::GetViewMatrix(portal));
+		m_shader->SetProjectionMatrix(&PortalManager::GetProjectionMatrix(portal));
 	}
 
 	// draw the model
-	CRenderer::DrawModel(m_shader, m_model);
+	CRenderer::DrawModel(m_shader, m_model, true, LodSelector::Select(*m_model, world));
 
 	// draw the collider
 	for (auto collider : m_colliders)
@@ -138,7 +136,7 @@ void Stage::Draw(Pass pass)
 
 void Stage::Draw(const std::shared_ptr<Shader>& shader, Pass pass)
 {
-	if (!(pass == Pass::Lightmap))
+	if (!(pass == Pass::LightmapStatic))
 		return;
 
 	GameObject::Draw(shader, pass);
@@ -0,0 +1,164 @@
+#include "pch.h"
+#include "statecache.h"
+
+
+const void* StateCache::m_shader = nullptr;
+int StateCache::m_depthStencilState = -1;
+int StateCache::m_rasterizerState = -1;
+ID3D11ShaderResourceView* StateCache::m_shaderResources[2][SLOT_NUM];
+ID3D11SamplerState* StateCache::m_samplers[SLOT_NUM];
+bool StateCache::m_shaderResourcesValid = false;
+bool StateCache::m_samplersValid = false;
+std::unordered_map<ID3D11Buffer*, std::vector<uint8_t>> StateCache::m_constants;
+ID3D11Buffer* StateCache::m_vertexBuffer = nullptr;
+uint32_t StateCache::m_vertexStride = 0;
+int StateCache::m_vertexFormat = -1;
+ID3D11Buffer* StateCache::m_indexBuffer = nullptr;
+int StateCache::m_indexFormat = -1;
+
+int StateCache::m_renderPass = -1;
+StateStats StateCache::m_frameStats[(int)StateType::Num];
+std::vector<StateStats> StateCache::m_passStats;
+
+
+void StateCache::BeginFrame(int renderPassNum)
+{
+	Invalidate();
+
+	m_renderPass = -1;
+	for (StateStats& stats : m_frameStats)
+		stats = StateStats();
+	m_passStats.assign(renderPassNum, StateStats());
+}
+
+void StateCache::Invalidate()
+{
+	m_shader = nullptr;
+	m_depthStencilState = -1;
+	m_rasterizerState = -1;
+	m_shaderResourcesValid = false;
+	m_samplersValid = false;
+	InvalidateConstantBuffers();
+	m_vertexFormat = -1;
+	m_indexFormat = -1;
+}
+
+void StateCache::InvalidateShaderResources()
+{
+	m_shaderResourcesValid = false;
+}
+
+void StateCache::InvalidateConstantBuffers()
+{
+	// the copies keep their memory, the same buffers are updated again every frame
+	for (auto& constants : m_constants)
+		constants.second.clear();
+}
+
+bool StateCache::BindShader(const void* shader)
+{
+	bool redundant = m_shader == shader;
+	m_shader = shader;
+	return Count(StateType::Shader, redundant);
+}
+
+bool StateCache::SetDepthStencilState(uint8_t number, uint8_t ref)
+{
+	int state = (number << 8) | ref;
+	bool redundant = m_depthStencilState == state;
+	m_depthStencilState = state;
+	return Count(StateType::DepthStencil, redundant);
+}
+
+bool StateCache::SetRasterizerState(uint8_t state)
+{
+	bool redundant = m_rasterizerState == state;
+	m_rasterizerState = state;
+	return Count(StateType::Rasterizer, redundant);
+}
+
+bool StateCache::SetShaderResource(ShaderStage stage, uint8_t slot, ID3D11ShaderResourceView* view)
+{
+	if (slot >= SLOT_NUM)
+		return Count(StateType::ShaderResource, false);
+
+	// unknown slots are cleared to a value no view has, so the first set of each slot goes through
+	if (!m_shaderResourcesValid)
+	{
+		memset(m_shaderResources, 0xFF, sizeof(m_shaderResources));
+		m_shaderResourcesValid = true;
+	}
+
+	ID3D11ShaderResourceView*& bound = m_shaderResources[(int)stage][slot];
+	bool redundant = bound == view;
+	bound = view;
+	return Count(StateType::ShaderResource, redundant);
+}
+
+bool StateCache::SetSampler(uint8_t slot, ID3D11SamplerState* sampler)
+{
+	if (slot >= SLOT_NUM)
+		return Count(StateType::Sampler, false);
+
+	if (!m_samplersValid)
+	{
+		memset(m_samplers, 0xFF, sizeof(m_samplers));
+		m_samplersValid = true;
+	}
+
+	bool redundant = m_samplers[slot] == sampler;
+	m_samplers[slot] = sampler;
+	return Count(StateType::Sampler, redundant);
+}
+
+bool StateCache::UpdateConstantBuffer(ID3D11Buffer* buffer, const void* data, uint32_t size)
+{
+	// compared byte for byte, the matrices and materials are small enough that keeping a copy is cheaper than the upload
+	std::vector<uint8_t>& constants = m_constants[buffer];
+	const uint8_t* bytes = (const uint8_t*)data;
+	bool redundant = constants.size() == size && memcmp(constants.data(), bytes, size) == 0;
+	if (!redundant)
+		constants.assign(bytes, bytes + size);
+
+	return Count(StateType::ConstantBuffer, redundant);
+}
+
+bool StateCache::SetVertexBuffer(ID3D11Buffer* buffer, uint32_t stride, VertexFormat format)
+{
+	bool redundant = m_vertexBuffer == buffer && m_vertexStride == stride && m_vertexFormat == (int)format;
+	m_vertexBuffer = buffer;
+	m_vertexStride = stride;
+	m_vertexFormat = (int)format;
+	return Count(StateType::VertexBuffer, redundant);
+}
+
+bool StateCache::SetIndexBuffer(ID3D11Buffer* buffer, IndexFormat format)
+{
+	bool redundant = m_indexBuffer == buffer && m_indexFormat == (int)format;
+	m_indexBuffer = buffer;
+	m_indexFormat = (int)format;
+	return Count(StateType::IndexBuffer, redundant);
+}
+
+StateStats StateCache::GetFrameStats()
+{
+	StateStats total;
+	for (const StateStats& stats : m_frameStats)
+	{
+		total.issued += stats.issued;
+		total.filtered += stats.filtered;
+	}
+
+	return total;
+}
+
+bool StateCache::Count(StateType type, bool redundant)
+{
+	StateStats& frame = m_frameStats[(int)type];
+	(redundant ? frame.filtered : frame.issued)++;
+
+	if (m_renderPass >= 0 && m_renderPass < (int)m_passStats.size())
+		(redundant ? m_passStats[m_renderPass].filtered : m_passStats[m_renderPass].issued)++;
+
+	return !redundant;
+}
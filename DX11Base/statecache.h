@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include "commandbuffer.h"
+
+
+enum class StateType { Shader, DepthStencil, Rasterizer, ShaderResource, Sampler, ConstantBuffer, VertexBuffer, IndexBuffer, Num };
+
+// issued and filtered state changes of one render pass
+struct StateStats
+{
+	uint32_t issued = 0;
+	uint32_t filtered = 0;
+};
+
+// remembers what is bound on the device so the backend can drop changes that would set the same state again,
+// constant buffers are compared with a copy of their last contents
+static class StateCache
+{
+public:
+	// called by the manager, the state left by the last frame is not trusted
+	static void BeginFrame(int renderPassNum);
+	static void BeginPass(int renderPass) { m_renderPass = renderPass; }
+
+	// forget everything, for when the device state was changed behind the cache
+	static void Invalidate();
+	// binding render targets unbinds them as shader resources, and shaders bind their own textures on bind
+	static void InvalidateShaderResources();
+	// the constant buffers were updated behind the cache
+	static void InvalidateConstantBuffers();
+
+	// return true if the change has to be sent to the device
+	static bool BindShader(const void* shader);
+	static bool SetDepthStencilState(uint8_t number, uint8_t ref);
+	static bool SetRasterizerState(uint8_t state);
+	static bool SetShaderResource(ShaderStage stage, uint8_t slot, ID3D11ShaderResourceView* view);
+	static bool SetSampler(uint8_t slot, ID3D11SamplerState* sampler);
+	static bool UpdateConstantBuffer(ID3D11Buffer* buffer, const void* data, uint32_t size);
+	static bool SetVertexBuffer(ID3D11Buffer* buffer, uint32_t stride, VertexFormat format);
+	static bool SetIndexBuffer(ID3D11Buffer* buffer, IndexFormat format);
+
+	// counters of the current frame
+	static uint32_t GetIssuedNum(StateType type) { return m_frameStats[(int)type].issued; }
+	static uint32_t GetFilteredNum(StateType type) { return m_frameStats[(int)type].filtered; }
+	static StateStats GetFrameStats();
+	static const std::vector<StateStats>& GetPassStats() { return m_passStats; }
+
+private:
+	static const int SLOT_NUM = 16;			// slots above this are not cached and always set
+
+	static const void* m_shader;
+	static int m_depthStencilState;			// number and ref packed, -1 when unknown
+	static int m_rasterizerState;
+	static ID3D11ShaderResourceView* m_shaderResources[2][SLOT_NUM];
+	static ID3D11SamplerState* m_samplers[SLOT_NUM];
+	static bool m_shaderResourcesValid;
+	static bool m_samplersValid;
+	static std::unordered_map<ID3D11Buffer*, std::vector<uint8_t>> m_constants;	// last contents uploaded to each buffer, empty when unknown
+	static ID3D11Buffer* m_vertexBuffer;
+	static uint32_t m_vertexStride;
+	static int m_vertexFormat;				// -1 when unknown
+	static ID3D11Buffer* m_indexBuffer;
+	static int m_indexFormat;
+
+	static int m_renderPass;
+	static StateStats m_frameStats[(int)StateType::Num];
+	static std::vector<StateStats> m_passStats;
+
+	static bool Count(StateType type, bool redundant);
+};
@@ -0,0 +1,143 @@
+// records commands and checks what the null backend receives, needs no device so it builds anywhere:
+// g++ -std=c++17 -I.. commandbuffer_test.cpp ../commandbuffer.cpp ../nullbackend.cpp -o commandbuffer_test && ./commandbuffer_test
+#include <stdio.h>
+#include <string.h>
+#include "commandbuffer.h"
+#include "nullbackend.h"
+
+static int g_failedNum = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { printf("%s(%d): %s\n", __FILE__, __LINE__, #condition); ++g_failedNum; }
+
+
+static void TestRecordAndWalk()
+{
+	CommandBuffer buffer;
+	CHECK(buffer.IsEmpty());
+	CHECK(buffer.First() == nullptr);
+
+	buffer.SetRasterizerState(2);
+	buffer.SetDepthStencilState(4, 1);
+	buffer.DrawIndexed(36, 6, -2);
+
+	CHECK(buffer.GetCommandNum() == 3);
+	CHECK(buffer.GetDrawNum() == 1);
+
+	// the commands come back in the order they were recorded with their payloads intact
+	const CommandHeader* header = buffer.First();
+	CHECK(header && header->type == CommandType::SetRasterizerState);
+	CHECK(header && CommandBuffer::GetPayload<SetRasterizerStateCommand>(header).state == 2);
+
+	header = header ? buffer.Next(header) : nullptr;
+	CHECK(header && header->type == CommandType::SetDepthStencilState);
+	CHECK(header && CommandBuffer::GetPayload<SetDepthStencilStateCommand>(header).number == 4);
+	CHECK(header && CommandBuffer::GetPayload<SetDepthStencilStateCommand>(header).ref == 1);
+
+	header = header ? buffer.Next(header) : nullptr;
+	CHECK(header && header->type == CommandType::DrawIndexed);
+	if (header)
+	{
+		const DrawIndexedCommand& draw = CommandBuffer::GetPayload<DrawIndexedCommand>(header);
+		CHECK(draw.indexCount == 36 && draw.startIndex == 6 && draw.baseVertex == -2);
+		CHECK(buffer.Next(header) == nullptr);
+	}
+
+	// every command starts pointer aligned
+	for (const CommandHeader* h = buffer.First(); h; h = buffer.Next(h))
+		CHECK(h->size % 8 == 0);
+
+	buffer.Clear();
+	CHECK(buffer.IsEmpty());
+	CHECK(buffer.GetCommandNum() == 0 && buffer.GetDrawNum() == 0);
+}
+
+static void TestConstantData()
+{
+	CommandBuffer buffer;
+	float values[3] = { 1.0f, 2.0f, 3.0f };
+	buffer.UpdateConstantBuffer(nullptr, values, sizeof(values));
+
+	// the data is copied into the buffer, the source can change after recording
+	values[0] = 9.0f;
+	const CommandHeader* header = buffer.First();
+	CHECK(header && CommandBuffer::GetPayload<UpdateConstantBufferCommand>(header).size == sizeof(values));
+	if (header)
+	{
+		const float* recorded = static_cast<const float*>(CommandBuffer::GetConstantData(header));
+		CHECK(recorded[0] == 1.0f && recorded[1] == 2.0f && recorded[2] == 3.0f);
+	}
+}
+
+static void TestInstanceData()
+{
+	CommandBuffer buffer;
+	float worlds[2][16] = {};
+	worlds[0][0] = 1.0f;
+	worlds[1][15] = 2.0f;
+	buffer.WriteInstances(nullptr, worlds, 2);
+
+	// the matrices travel with the pass, the batcher reuses its array right after recording
+	worlds[0][0] = 9.0f;
+	const CommandHeader* header = buffer.First();
+	CHECK(header && header->type == CommandType::WriteInstances);
+	CHECK(header && CommandBuffer::GetPayload<WriteInstancesCommand>(header).count == 2);
+	if (header)
+	{
+		const float* recorded = static_cast<const float*>(CommandBuffer::GetInstanceData(header));
+		CHECK(recorded[0] == 1.0f && recorded[16 + 15] == 2.0f);
+		CHECK(header->size >= sizeof(CommandHeader) + sizeof(WriteInstancesCommand) + sizeof(worlds));
+	}
+}
+
+static void TestNullBackend()
+{
+	CommandBuffer buffer;
+	buffer.BindShader(nullptr);
+	buffer.UpdateConstantBuffer(nullptr, "0123456789abcdef0123", 20);
+	buffer.SetTopology(PrimitiveTopology::TriangleList);
+	buffer.Draw(3, 0);
+	buffer.DrawIndexed(6, 0, 0);
+	buffer.DrawIndexedInstanced(12, 4, 0, 0, 0);
+	buffer.CopyTextureRegion(nullptr, nullptr, 0, 0, 16, 16);
+	buffer.CopyResource(nullptr, nullptr);
+
+	NullBackend backend;
+	backend.Execute(buffer);
+
+	CHECK(backend.GetExecuteNum() == 1);
+	CHECK(backend.GetDrawNum() == 3);
+	CHECK(backend.GetVertexNum() == 3 + 6 + 12 * 4);
+	CHECK(backend.GetConstantBytes() == 20);
+	CHECK(backend.GetCommandNum(CommandType::BindShader) == 1);
+	CHECK(backend.GetCommandNum(CommandType::SetTopology) == 1);
+	CHECK(backend.GetCommandNum(CommandType::CopyTextureRegion) == 1);
+	CHECK(backend.GetCommandNum(CommandType::CopyResource) == 1);
+	CHECK(backend.GetCommandNum(CommandType::SetSampler) == 0);
+
+	// a buffer can be executed again until it is cleared
+	backend.Execute(buffer);
+	CHECK(backend.GetExecuteNum() == 2);
+	CHECK(backend.GetDrawNum() == 6);
+
+	backend.ResetStats();
+	CHECK(backend.GetExecuteNum() == 0 && backend.GetDrawNum() == 0 && backend.GetVertexNum() == 0);
+}
+
+
+int main()
+{
+	TestRecordAndWalk();
+	TestConstantData();
+	TestInstanceData();
+	TestNullBackend();
+
+	if (g_failedNum > 0)
+	{
+		printf("%d checks failed\n", g_failedNum);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
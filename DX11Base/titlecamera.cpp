@@ -32,15 +32,9 @@ void TitleCamera::SetViewMatrix()
 	dx::XMVECTOR eye = GetPosition();
 	dx::XMVECTOR target = {0, 1, 0};
 
-	// calculate and set the view matrix for each shader
+	// calculate the view matrix
 	view = dx::XMMatrixLookAtLH(eye, target, up);
 
-	auto shaders = CRenderer::GetShaders();
-	for (auto shader : shaders)
-	{
-		shader->SetViewMatrix(&view);
-	}
-
 	// load the view matrix back to member variable
 	dx::XMStoreFloat4x4(&m_mView, view);
 }
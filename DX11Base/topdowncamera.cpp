@@ -42,13 +42,9 @@ void TopDownCamera::SetViewMatrix()
 	dx::XMVECTOR up = dx::XMVectorSet(0, 1, 0, 1);
 	dx::XMVECTOR direction = dx::XMVectorSet(0, -0.7F, 0.9F, 1);
 
-	// calculate and set the view matrix for each shader
+	// calculate the view matrix
 	view = dx::XMMatrixLookToLH(eye, direction, up);
 
-	auto shaders = CRenderer::GetShaders();
-	for (auto shader : shaders)
-		shader->SetViewMatrix(&view);
-
 	// load the view matrix back to member variable
 	dx::XMStoreFloat4x4(&m_mView, view);
 }
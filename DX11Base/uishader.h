@@ -17,27 +17,27 @@ public:
 		deviceContext->IASetInputLayout(m_vertexLayout);
 
 		// set constant buffers
-		deviceContext->VSSetConstantBuffers(0, 1, &m_projectionBuffer);
+		ConstantRing::Bind(ShaderStage::Vertex, 0, m_projectionBuffer);
 
-		deviceContext->PSSetConstantBuffers(0, 1, &m_materialBuffer);
-		deviceContext->PSSetConstantBuffers(1, 1, &m_valueBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 0, m_materialBuffer);
+		ConstantRing::Bind(ShaderStage::Pixel, 1, m_valueBuffer);
 
-		deviceContext->UpdateSubresource(m_projectionBuffer, 0, NULL, &projection, 0, 0);
+		ConstantRing::Update(m_projectionBuffer, &projection, sizeof(projection));
 	}
 
 	void SetValueBuffer(int enableTexture)
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_valueBuffer, 0, NULL, &enableTexture, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_valueBuffer, &enableTexture, sizeof(enableTexture));
 	}
 
 	void SetMaterial(MATERIAL Material) override
 	{
-		CRenderer::GetDeviceContext()->UpdateSubresource(m_materialBuffer, 0, NULL, &Material, 0, 0);
+		CRenderer::UpdateConstantBuffer(m_materialBuffer, &Material, sizeof(Material));
 	}
 
 	void SetTexture(ID3D11ShaderResourceView* texture) override
 	{
-		CRenderer::GetDeviceContext()->PSSetShaderResources(0, 1, &texture);
+		CRenderer::SetShaderResource(ShaderStage::Pixel, 0, texture);
 	}
 
 private:
@@ -0,0 +1,175 @@
+#include "pch.h"
+#include <float.h>
+#include "visibility.h"
+#include "manager.h"
+#include "portalmanager.h"
+#include "portalvisibility.h"
+#include "light.h"
+#include "debug.h"
+#include "workerpool.h"
+
+// below this many box tests per frame the culling is done on the main thread, the simd tests are done faster than the workers wake up
+#define PARALLEL_CULL_THRESHOLD 8192
+
+
+void Visibility::Gather(const std::list<std::shared_ptr<GameObject>>* gameObjects, int renderQueue)
+{
+	// gather every object and the world bounds of the cullable ones, ignore UI layer
+	m_objects.clear();
+	m_boxIndex.clear();
+	m_boxes.Clear();
+	dx::XMFLOAT3 sceneMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+	dx::XMFLOAT3 sceneMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int i = 0; i < renderQueue; ++i)
+	{
+		for (const auto& go : gameObjects[i])
+		{
+			int index = -1;
+			if (i < renderQueue - 1 && go->IsCullable())
+			{
+				dx::XMFLOAT3 center, extents;
+				go->GetWorldBounds(center, extents);
+				index = (int)m_boxes.count;
+				m_boxes.Add(center, extents);
+
+				sceneMin = { std::min(sceneMin.x, center.x - extents.x), std::min(sceneMin.y, center.y - extents.y), std::min(sceneMin.z, center.z - extents.z) };
+				sceneMax = { std::max(sceneMax.x, center.x + extents.x), std::max(sceneMax.y, center.y + extents.y), std::max(sceneMax.z, center.z + extents.z) };
+			}
+
+			m_objects.push_back(go.get());
+			m_boxIndex.push_back(index);
+		}
+	}
+	m_sceneMin = sceneMin;
+	m_sceneMax = sceneMax;
+
+	// objects subscribed to each kind of pass, the render queues are sorted every frame so the lists are rebuilt with them
+	for (auto& subscribers : m_subscribers)
+		subscribers.clear();
+	for (uint32_t i = 0; i < (uint32_t)m_objects.size(); ++i)
+	{
+		for (int pass = 0; pass < PASS_NUM; ++pass)
+		{
+			if (m_objects[i]->IsSubscribed((Pass)pass, false))
+				m_subscribers[pass * 2].push_back(i);
+			if (m_objects[i]->IsSubscribed((Pass)pass, true))
+				m_subscribers[pass * 2 + 1].push_back(i);
+		}
+	}
+}
+
+void Visibility::Cull()
+{
+	// build the frustum of every pass, the views read the scene so this stays on the main thread
+	auto renderPasses = CManager::GetRenderPasses();
+	m_passCount = (int)renderPasses->size();
+	m_views.resize(m_passCount);
+	m_visibleMasks.resize(m_passCount);
+	m_drawLists.resize(m_passCount);
+	for (int i = 0; i < m_passCount; ++i)
+		SetupView((*renderPasses)[i], m_views[i]);
+
+	// split the passes across the worker pool when there is enough work to pay for waking it
+	size_t passCount = m_views.size();
+	size_t threadCount = std::min((size_t)WorkerPool::GetWorkerNum() + 1, passCount);
+	if (threadCount > 1 && passCount * m_boxes.count >= PARALLEL_CULL_THRESHOLD)
+	{
+		size_t passesPerThread = (passCount + threadCount - 1) / threadCount;
+		size_t jobCount = (passCount + passesPerThread - 1) / passesPerThread;
+		WorkerPool::Run(jobCount, [this, passesPerThread, passCount](size_t job)
+		{
+			size_t first = job * passesPerThread;
+			CullPasses(first, std::min(first + passesPerThread, passCount));
+		});
+	}
+	else
+		CullPasses(0, passCount);
+}
+
+void Visibility::SetupView(const RenderPass& renderPass, PassView& view) const
+{
+	view.skipCulling = false;
+	view.hideCullable = false;
+	view.subscribers = (int)renderPass.pass * 2 + (renderPass.overrideShader ? 1 : 0);
+
+	// nothing is drawn in skipped passes
+	if (renderPass.skip)
+	{
+		view.hideCullable = true;
+		return;
+	}
+
+	// the debug cameras swap the view of every pass
+	if (Debug::cameraNum != 0)
+	{
+		view.skipCulling = true;
+		return;
+	}
+
+	switch (renderPass.pass)
+	{
+	case Pass::Portal:
+	{
+		auto portal = PortalManager::GetPortal(renderPass.portal);
+		if (!portal || !portal->GetLinkedPortal())
+		{
+			view.hideCullable = true;
+			return;
+		}
+
+		// only what is seen through the opening of the linked portal can be drawn at this level
+		const ScreenRect& rect = PortalVisibility::GetScreenRect(renderPass.portal, renderPass.recursionLevel);
+		if (rect.IsEmpty())
+		{
+			view.hideCullable = true;
+			return;
+		}
+
+		// side planes through the opening and the oblique near plane on the linked portal
+		int level = renderPass.recursionLevel;
+		dx::XMMATRIX viewProjection = portal->GetViewMatrixAtLevel(level) * portal->GetProjectionMatrixAtLevel(level);
+		FrustumCulling::ConstructFrustum(view.frustum, viewProjection, rect);
+		break;
+	}
+	case Pass::Lightmap:
+	case Pass::LightmapStatic:
+	{
+		// only the casters of the cascade, its depth reaches back to the edge of the scene towards the light
+		dx::XMMATRIX viewProjection = LightManager::GetViewMatrix() * LightManager::GetProjectionMatrix(renderPass.cascade);
+		FrustumCulling::ConstructFrustum(view.frustum, viewProjection, ScreenRect::FullScreen());
+		break;
+	}
+	default:
+		view.frustum = FrustumCulling::GetFrustum();
+		break;
+	}
+}
+
+void Visibility::CullPasses(size_t first, size_t last)
+{
+	for (size_t p = first; p < last; ++p)
+	{
+		const PassView& view = m_views[p];
+		std::vector<GameObject*>& drawList = m_drawLists[p];
+		drawList.clear();
+
+		bool testBoxes = !view.skipCulling && !view.hideCullable;
+		if (testBoxes)
+			FrustumCulling::CullBoxes(view.frustum, m_boxes, m_visibleMasks[p]);
+
+		for (uint32_t i : m_subscribers[view.subscribers])
+		{
+			if (!m_objects[i]->m_draw)
+				continue;
+
+			int box = m_boxIndex[i];
+			if (box >= 0 && !view.skipCulling)
+			{
+				if (view.hideCullable || !FrustumCulling::IsVisible(m_visibleMasks[p], box))
+					continue;
+			}
+
+			drawList.push_back(m_objects[i]);
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "frustumculling.h"
+#include "pass.h"
+
+
+class GameObject;
+
+// culls the scene once for every render pass with the frustum that pass is looking through
+class Visibility
+{
+public:
+	// collect the objects of the sorted render queues and the bounds of the cullable ones
+	void Gather(const std::list<std::shared_ptr<GameObject>>* gameObjects, int renderQueue);
+	// rebuild the draw lists of every render pass, the views of the shadow passes have to be fitted to the gathered bounds first
+	void Cull();
+
+	// bounds of every cullable object, min is above max when there is none
+	const dx::XMFLOAT3& GetSceneMin() const { return m_sceneMin; }
+	const dx::XMFLOAT3& GetSceneMax() const { return m_sceneMax; }
+
+	// the lists are indexed by render pass, throw them away when the passes change
+	void Invalidate() { m_passCount = 0; }
+	bool IsValid(int renderPassIndex) const { return renderPassIndex >= 0 && renderPassIndex < m_passCount; }
+
+	// objects to draw in the given pass, in render queue order
+	const std::vector<GameObject*>& GetDrawList(int renderPassIndex) const { return m_drawLists[renderPassIndex]; }
+
+private:
+	struct PassView
+	{
+		Frustum frustum;
+		bool skipCulling;		// view is unknown, draw everything
+		bool hideCullable;		// portal without destination, only draw objects that are never culled
+		int subscribers;		// index into m_subscribers
+	};
+
+	std::vector<GameObject*> m_objects;					// every object in render queue order
+	std::vector<int> m_boxIndex;						// index into m_boxes, -1 if the object is never culled
+	std::vector<uint32_t> m_subscribers[PASS_NUM * 2];	// objects drawing in a pass, with and without the override shader
+	BoundingBoxList m_boxes;
+	dx::XMFLOAT3 m_sceneMin;
+	dx::XMFLOAT3 m_sceneMax;
+	std::vector<PassView> m_views;
+	std::vector<std::vector<uint32_t>> m_visibleMasks;
+	std::vector<std::vector<GameObject*>> m_drawLists;
+	int m_passCount = 0;
+
+	void SetupView(const RenderPass& renderPass, PassView& view) const;
+	void CullPasses(size_t first, size_t last);
+};
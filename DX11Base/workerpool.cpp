@@ -0,0 +1,101 @@
+#include "pch.h"
+#include <algorithm>
+#include "workerpool.h"
+
+
+std::vector<std::thread> WorkerPool::m_workers;
+std::mutex WorkerPool::m_mutex;
+std::condition_variable WorkerPool::m_wake;
+std::condition_variable WorkerPool::m_done;
+const std::function<void(size_t)>* WorkerPool::m_job = nullptr;
+size_t WorkerPool::m_count = 0;
+std::atomic<size_t> WorkerPool::m_next(0);
+int WorkerPool::m_busyNum = 0;
+uint32_t WorkerPool::m_generation = 0;
+bool WorkerPool::m_quit = false;
+
+
+void WorkerPool::Init()
+{
+	// the main thread takes part in every run
+	int workerNum = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+	m_quit = false;
+	for (int i = 0; i < workerNum; ++i)
+		m_workers.emplace_back(WorkerMain);
+}
+
+void WorkerPool::Uninit()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+}
+
+void WorkerPool::Run(size_t count, const std::function<void(size_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	// not worth waking anyone
+	if (count == 1 || m_workers.empty())
+	{
+		for (size_t i = 0; i < count; ++i)
+			job(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &job;
+		m_count = count;
+		m_next = 0;
+		m_busyNum = (int)m_workers.size();
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	RunJobs();
+
+	// the job has to outlive every worker still looking at it
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, []() { return m_busyNum == 0; });
+	m_job = nullptr;
+}
+
+void WorkerPool::WorkerMain()
+{
+	uint32_t generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&generation]() { return m_quit || m_generation != generation; });
+			if (m_quit)
+				return;
+			generation = m_generation;
+		}
+
+		RunJobs();
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			last = --m_busyNum == 0;
+		}
+		if (last)
+			m_done.notify_one();
+	}
+}
+
+void WorkerPool::RunJobs()
+{
+	// indices are taken one by one so a slow job doesnt hold back the ones after it
+	for (size_t i = m_next++; i < m_count; i = m_next++)
+		(*m_job)(i);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+// threads started once and kept for the whole run, work handed to them every frame doesnt pay for starting threads
+static class WorkerPool
+{
+public:
+	static void Init();
+	static void Uninit();
+
+	// threads besides the main thread
+	static int GetWorkerNum() { return (int)m_workers.size(); }
+
+	// calls job with every index below count on the workers and the calling thread, returns once all calls returned,
+	// only called from the main thread
+	static void Run(size_t count, const std::function<void(size_t)>& job);
+
+private:
+	static std::vector<std::thread> m_workers;
+	static std::mutex m_mutex;
+	static std::condition_variable m_wake, m_done;
+	static const std::function<void(size_t)>* m_job;
+	static size_t m_count;
+	static std::atomic<size_t> m_next;
+	static int m_busyNum;
+	static uint32_t m_generation;
+	static bool m_quit;
+
+	static void WorkerMain();
+	static void RunJobs();
+};